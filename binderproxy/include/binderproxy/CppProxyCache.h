@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_SECURITY_BINDERPROXY_CPP_PROXY_CACHE_H_
+#define SYSTEM_SECURITY_BINDERPROXY_CPP_PROXY_CACHE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <binder/IBinder.h>
+#include <binder/IServiceManager.h>
+#include <utils/String16.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+namespace binderproxy {
+
+/**
+ * CppProxyCache is the libbinder-backend counterpart of NdkProxyCache: it
+ * caches the proxy for one service instance, drops it via a death recipient
+ * when the service dies, and backs off exponentially after failed
+ * resolutions so restarting services don't get stormed.
+ *
+ * Unlike the NDK variant, resolution goes through IServiceManager::getService
+ * and therefore waits briefly for a service that is still starting up, which
+ * matches how the early-boot clients of this backend already behaved.
+ *
+ * Instances are expected to have static storage duration: the death recipient
+ * and the preResolve() worker both hold a raw pointer to the cache.
+ */
+template <typename Interface> class CppProxyCache {
+  public:
+    explicit CppProxyCache(const char* instance)
+        : instance_(String16(instance)), death_recipient_(new DeathRecipient(this)) {}
+
+    CppProxyCache(const CppProxyCache&) = delete;
+    CppProxyCache& operator=(const CppProxyCache&) = delete;
+
+    /* peek returns the cached proxy without attempting a resolution. */
+    sp<Interface> peek() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return service_;
+    }
+
+    /* get returns the cached proxy, resolving it first if necessary. Returns
+     * nullptr if the service could not be resolved or a previous failure's
+     * backoff window has not elapsed yet. */
+    sp<Interface> get() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (service_ != nullptr) {
+            return service_;
+        }
+        if (std::chrono::steady_clock::now() < next_attempt_) {
+            return nullptr;
+        }
+
+        sp<IServiceManager> sm = defaultServiceManager();
+        if (sm == nullptr) {
+            recordFailureLocked();
+            return nullptr;
+        }
+        sp<IBinder> binder = sm->getService(instance_);
+        sp<Interface> service = interface_cast<Interface>(binder);
+        if (service == nullptr) {
+            recordFailureLocked();
+            return nullptr;
+        }
+        failures_ = 0;
+        next_attempt_ = {};
+
+        if (binder->linkToDeath(death_recipient_) != OK) {
+            /* Without the death notification the proxy could go stale across
+             * a service restart, so hand it out for this call only. */
+            return service;
+        }
+        service_ = service;
+        return service_;
+    }
+
+    /* preResolve starts resolving the service on a worker thread, so the
+     * first caller that actually needs it finds a warm proxy. A no-op if the
+     * proxy is already cached or a backoff window is pending. */
+    void preResolve() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (service_ != nullptr || std::chrono::steady_clock::now() < next_attempt_) {
+                return;
+            }
+        }
+        std::thread([this] { get(); }).detach();
+    }
+
+  private:
+    class DeathRecipient : public IBinder::DeathRecipient {
+      public:
+        explicit DeathRecipient(CppProxyCache* cache) : cache_(cache) {}
+        void binderDied(const wp<IBinder>& /* who */) override {
+            std::lock_guard<std::mutex> lock(cache_->mutex_);
+            cache_->service_.clear();
+        }
+
+      private:
+        CppProxyCache* const cache_;
+    };
+
+    void recordFailureLocked() {
+        std::chrono::milliseconds delay =
+            kBackoffBase * (int64_t(1) << std::min(failures_, kMaxDoublings));
+        if (delay > kBackoffMax) {
+            delay = kBackoffMax;
+        }
+        next_attempt_ = std::chrono::steady_clock::now() + delay;
+        ++failures_;
+    }
+
+    static constexpr uint32_t kMaxDoublings = 9;
+    static constexpr std::chrono::milliseconds kBackoffBase{10};
+    static constexpr std::chrono::milliseconds kBackoffMax{5000};
+
+    const String16 instance_;
+    const sp<DeathRecipient> death_recipient_;
+    std::mutex mutex_;
+    sp<Interface> service_;
+    uint32_t failures_ = 0;
+    std::chrono::steady_clock::time_point next_attempt_{};
+};
+
+}  // namespace binderproxy
+}  // namespace android
+
+#endif  // SYSTEM_SECURITY_BINDERPROXY_CPP_PROXY_CACHE_H_
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_SECURITY_BINDERPROXY_NDK_PROXY_CACHE_H_
+#define SYSTEM_SECURITY_BINDERPROXY_NDK_PROXY_CACHE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <android/binder_auto_utils.h>
+#include <android/binder_ibinder.h>
+#include <android/binder_manager.h>
+
+namespace android {
+namespace binderproxy {
+
+/**
+ * NdkProxyCache caches the NDK-backend binder proxy for one service instance.
+ *
+ * The service manager lookup runs once and the resulting proxy is reused by
+ * every caller in the process. A death recipient drops the cached proxy when
+ * the service dies, so the next get() resolves the new service instance.
+ * Failed resolutions back off exponentially: within the backoff window get()
+ * returns nullptr immediately instead of hammering the service manager, which
+ * keeps a fleet of clients from storming it while the service restarts.
+ *
+ * Instances are expected to have static storage duration: the death recipient
+ * and the preResolve() worker both hold a raw pointer to the cache.
+ */
+template <typename Interface> class NdkProxyCache {
+  public:
+    explicit NdkProxyCache(std::string instance)
+        : instance_(std::move(instance)),
+          death_recipient_(AIBinder_DeathRecipient_new(&NdkProxyCache::onBinderDied)) {}
+
+    NdkProxyCache(const NdkProxyCache&) = delete;
+    NdkProxyCache& operator=(const NdkProxyCache&) = delete;
+
+    /* peek returns the cached proxy without attempting a resolution. */
+    std::shared_ptr<Interface> peek() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return service_;
+    }
+
+    /* get returns the cached proxy, resolving it first if necessary. Returns
+     * nullptr if the service is not up or a previous failure's backoff window
+     * has not elapsed yet. */
+    std::shared_ptr<Interface> get() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (service_) {
+            return service_;
+        }
+        if (std::chrono::steady_clock::now() < next_attempt_) {
+            return nullptr;
+        }
+
+        ::ndk::SpAIBinder binder(AServiceManager_checkService(instance_.c_str()));
+        auto service = Interface::fromBinder(binder);
+        if (!service) {
+            recordFailureLocked();
+            return nullptr;
+        }
+        failures_ = 0;
+        next_attempt_ = {};
+
+        if (AIBinder_linkToDeath(binder.get(), death_recipient_.get(), this) != STATUS_OK) {
+            /* Without the death notification the proxy could go stale across
+             * a service restart, so hand it out for this call only. */
+            return service;
+        }
+        service_ = service;
+        return service_;
+    }
+
+    /* preResolve starts resolving the service on a worker thread, so the
+     * first caller that actually needs it finds a warm proxy. A no-op if the
+     * proxy is already cached or a backoff window is pending. */
+    void preResolve() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (service_ || std::chrono::steady_clock::now() < next_attempt_) {
+                return;
+            }
+        }
+        std::thread([this] { get(); }).detach();
+    }
+
+  private:
+    static void onBinderDied(void* cookie) {
+        auto* self = static_cast<NdkProxyCache*>(cookie);
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        self->service_.reset();
+    }
+
+    void recordFailureLocked() {
+        std::chrono::milliseconds delay =
+            kBackoffBase * (int64_t(1) << std::min(failures_, kMaxDoublings));
+        if (delay > kBackoffMax) {
+            delay = kBackoffMax;
+        }
+        next_attempt_ = std::chrono::steady_clock::now() + delay;
+        ++failures_;
+    }
+
+    static constexpr uint32_t kMaxDoublings = 9;
+    static constexpr std::chrono::milliseconds kBackoffBase{10};
+    static constexpr std::chrono::milliseconds kBackoffMax{5000};
+
+    const std::string instance_;
+    ::ndk::ScopedAIBinder_DeathRecipient death_recipient_;
+    std::mutex mutex_;
+    std::shared_ptr<Interface> service_;
+    uint32_t failures_ = 0;
+    std::chrono::steady_clock::time_point next_attempt_{};
+};
+
+}  // namespace binderproxy
+}  // namespace android
+
+#endif  // SYSTEM_SECURITY_BINDERPROXY_NDK_PROXY_CACHE_H_
@@ -18,8 +18,12 @@
 
 #include <sys/types.h>
 
+#include <atomic>
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -48,28 +52,103 @@ void LoadKeyFromStdin(key_serial_t keyring_id, const char* keyname) {
     }
 }
 
-void LoadKeyFromFile(key_serial_t keyring_id, const char* keyname, const std::string& path) {
-    LOG(INFO) << "LoadKeyFromFile path=" << path << " keyname=" << keyname;
-    std::string content;
-    if (!android::base::ReadFileToString(path, &content)) {
-        LOG(ERROR) << "Failed to read key from " << path;
-        return;
-    }
-    if (!LoadKeyToKeyring(keyring_id, keyname, content.c_str(), content.size())) {
-        LOG(ERROR) << "Failed to load key from " << path;
+// A .ders file holds several DER certificates back to back - the precompiled
+// form of a directory of individual .der files, turning many small reads into
+// one sequential read. Each certificate is a DER SEQUENCE with a definite
+// length, so the boundaries can be recovered from the headers without a full
+// parser. Returns an empty list (and logs) if the bundle is malformed.
+std::vector<std::string_view> SplitConcatenatedCerts(const std::string& content) {
+    std::vector<std::string_view> certs;
+    size_t pos = 0;
+    while (pos < content.size()) {
+        if (content.size() - pos < 2 || static_cast<uint8_t>(content[pos]) != 0x30) {
+            LOG(ERROR) << "Malformed certificate bundle at offset " << pos;
+            return {};
+        }
+        size_t header = 2;
+        size_t len = static_cast<uint8_t>(content[pos + 1]);
+        if (len & 0x80) {
+            size_t num_bytes = len & 0x7f;
+            if (num_bytes == 0 || num_bytes > sizeof(size_t) ||
+                content.size() - pos < 2 + num_bytes) {
+                LOG(ERROR) << "Malformed certificate bundle at offset " << pos;
+                return {};
+            }
+            len = 0;
+            for (size_t i = 0; i < num_bytes; i++) {
+                len = (len << 8) | static_cast<uint8_t>(content[pos + 2 + i]);
+            }
+            header += num_bytes;
+        }
+        if (content.size() - pos < header + len) {
+            LOG(ERROR) << "Truncated certificate bundle at offset " << pos;
+            return {};
+        }
+        certs.push_back(std::string_view(content).substr(pos, header + len));
+        pos += header + len;
     }
+    return certs;
 }
 
 void LoadKeyFromDirectory(key_serial_t keyring_id, const char* keyname_prefix, const char* dir) {
     if (!std::filesystem::exists(dir)) {
         return;
     }
-    int counter = 0;
+
+    std::vector<std::string> paths;
     for (const auto& entry : std::filesystem::directory_iterator(dir)) {
-        if (!android::base::EndsWithIgnoreCase(entry.path().c_str(), ".der")) continue;
+        if (android::base::EndsWithIgnoreCase(entry.path().c_str(), ".der") ||
+            android::base::EndsWithIgnoreCase(entry.path().c_str(), ".ders")) {
+            paths.emplace_back(entry.path());
+        }
+    }
+
+    // This runs in the early-boot window before apexd proceeds, so read the
+    // certificate files concurrently and then issue the add_key calls back to
+    // back instead of alternating between I/O and syscalls per file. Plain
+    // char instead of bool for the flags: vector<bool> is bit-packed and not
+    // safe to write from multiple threads.
+    std::vector<std::string> contents(paths.size());
+    std::vector<char> read_ok(paths.size(), 0);
+    std::atomic<size_t> next_index(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next_index.fetch_add(1)) < paths.size()) {
+            read_ok[i] = android::base::ReadFileToString(paths[i], &contents[i]);
+        }
+    };
+    size_t num_threads =
+        std::min(paths.size(), size_t(std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::thread> threads;
+    for (size_t n = 1; n < num_threads; n++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    int counter = 0;
+    auto add_key = [&](const std::string& path, const char* data, size_t size) {
         std::string keyname = keyname_prefix + std::to_string(counter);
         counter++;
-        LoadKeyFromFile(keyring_id, keyname.c_str(), entry.path());
+        LOG(INFO) << "LoadKeyFromFile path=" << path << " keyname=" << keyname;
+        if (!LoadKeyToKeyring(keyring_id, keyname.c_str(), data, size)) {
+            LOG(ERROR) << "Failed to load key from " << path;
+        }
+    };
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!read_ok[i]) {
+            LOG(ERROR) << "Failed to read key from " << paths[i];
+            continue;
+        }
+        if (android::base::EndsWithIgnoreCase(paths[i], ".ders")) {
+            for (const auto& cert : SplitConcatenatedCerts(contents[i])) {
+                add_key(paths[i], cert.data(), cert.size());
+            }
+        } else {
+            add_key(paths[i], contents[i].data(), contents[i].size());
+        }
     }
 }
 
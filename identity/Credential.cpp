@@ -17,8 +17,8 @@
 #define LOG_TAG "credstore"
 
 #include <android-base/logging.h>
-#include <android/binder_manager.h>
 #include <android/hardware/identity/support/IdentityCredentialSupport.h>
+#include <binderproxy/NdkProxyCache.h>
 
 #include <android/security/identity/ICredentialStore.h>
 
@@ -67,17 +67,33 @@ using ::aidl::android::hardware::security::secureclock::TimeStampToken;
 using ::aidl::android::security::authorization::AuthorizationTokens;
 using ::aidl::android::security::authorization::IKeystoreAuthorization;
 
+// Shared cache for the keystore2 authorization service proxy. Every
+// presentation needs auth tokens, so resolving the service per call made
+// cold-service discovery part of every retrieval; the cache resolves it once
+// and re-resolves with backoff after a keystore2 restart.
+static binderproxy::NdkProxyCache<IKeystoreAuthorization>& authzServiceCache() {
+    static binderproxy::NdkProxyCache<IKeystoreAuthorization> cache(
+        "android.security.authorization");
+    return cache;
+}
+
 Credential::Credential(CipherSuite cipherSuite, const std::string& dataPath,
                        const std::string& credentialName, uid_t callingUid,
                        HardwareInformation hwInfo, sp<IIdentityCredentialStore> halStoreBinder,
                        int halApiVersion)
     : cipherSuite_(cipherSuite), dataPath_(dataPath), credentialName_(credentialName),
       callingUid_(callingUid), hwInfo_(std::move(hwInfo)), halStoreBinder_(halStoreBinder),
-      halApiVersion_(halApiVersion) {}
+      halApiVersion_(halApiVersion) {
+    // A credential is opened before the presentation that needs auth tokens,
+    // so start resolving the authorization service now; by the time
+    // getEntries() runs the proxy is warm. No-op once the proxy is cached.
+    authzServiceCache().preResolve();
+}
 
 Credential::~Credential() {}
 
 Status Credential::ensureOrReplaceHalBinder() {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
     if (!data->loadFromDisk()) {
         LOG(ERROR) << "Error loading data for credential";
@@ -104,19 +120,29 @@ Status Credential::ensureOrReplaceHalBinder() {
 }
 
 Status Credential::getCredentialKeyCertificateChain(std::vector<uint8_t>* _aidl_return) {
+    // Deliberately not under |halSessionMutex_|: this is one of the short
+    // calls that should be served while a retrieval is in flight.
+    std::lock_guard<std::mutex> lock(certificateChainMutex_);
+    if (!credentialKeyCertificateChain_.empty()) {
+        *_aidl_return = credentialKeyCertificateChain_;
+        return Status::ok();
+    }
+
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
     if (!data->loadFromDisk()) {
         LOG(ERROR) << "Error loading data for credential";
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_GENERIC,
                                                 "Error loading data for credential");
     }
-    *_aidl_return = data->getAttestationCertificate();
+    credentialKeyCertificateChain_ = data->getAttestationCertificate();
+    *_aidl_return = credentialKeyCertificateChain_;
     return Status::ok();
 }
 
 // Returns operation handle
 Status Credential::selectAuthKey(bool allowUsingExhaustedKeys, bool allowUsingExpiredKeys,
                                  int64_t* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
     if (!data->loadFromDisk()) {
         LOG(ERROR) << "Error loading data for credential";
@@ -169,9 +195,7 @@ bool getTokensFromKeystore2(uint64_t challenge, uint64_t secureUserId,
                             AidlHardwareAuthToken& aidlAuthToken,
                             AidlVerificationToken& aidlVerificationToken) {
     // try to connect to IKeystoreAuthorization AIDL service first.
-    AIBinder* authzAIBinder = AServiceManager_checkService("android.security.authorization");
-    ::ndk::SpAIBinder authzBinder(authzAIBinder);
-    auto authzService = IKeystoreAuthorization::fromBinder(authzBinder);
+    auto authzService = authzServiceCache().get();
     if (authzService) {
         AuthorizationTokens authzTokens;
         auto result = authzService->getAuthTokensForCredStore(challenge, secureUserId,
@@ -219,6 +243,7 @@ Status Credential::getEntries(const vector<uint8_t>& requestMessage,
                               const vector<uint8_t>& sessionTranscript,
                               const vector<uint8_t>& readerSignature, bool allowUsingExhaustedKeys,
                               bool allowUsingExpiredKeys, GetEntriesResultParcel* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     GetEntriesResultParcel ret;
 
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
@@ -437,6 +462,32 @@ Status Credential::getEntries(const vector<uint8_t>& requestMessage,
         return halStatusToGenericError(status);
     }
 
+    // Flatten the requested entries so the retrieval loop below can keep the
+    // decode of the next entry's data in flight while the HAL round trips for
+    // the current entry are outstanding. The retrieval session in the HAL is
+    // stateful and strictly ordered, so the binder calls themselves cannot be
+    // overlapped - but the (potentially large) materialization of deferred
+    // entry data can be taken off the critical path. The worker is the only
+    // user of |data| while it runs; the loop joins it before touching |data|
+    // again.
+    vector<std::pair<const RequestNamespaceParcel*, const RequestEntryParcel*>> flatEntries;
+    for (const RequestNamespaceParcel& rns : requestNamespaces) {
+        for (const RequestEntryParcel& rep : rns.entries) {
+            flatEntries.push_back({&rns, &rep});
+        }
+    }
+    auto prefetchEntryData = [&data](const RequestNamespaceParcel* rns,
+                                     const RequestEntryParcel* rep) {
+        return std::async(std::launch::async, [&data, rns, rep] {
+            return data->getEntryData(rns->namespaceName, rep->name);
+        });
+    };
+    size_t flatIndex = 0;
+    std::future<optional<EntryData>> prefetchedEntryData;
+    if (!flatEntries.empty()) {
+        prefetchedEntryData = prefetchEntryData(flatEntries[0].first, flatEntries[0].second);
+    }
+
     for (const RequestNamespaceParcel& rns : requestNamespaces) {
         ResultNamespaceParcel resultNamespaceParcel;
         resultNamespaceParcel.namespaceName = rns.namespaceName;
@@ -445,7 +496,12 @@ Status Credential::getEntries(const vector<uint8_t>& requestMessage,
             ResultEntryParcel resultEntryParcel;
             resultEntryParcel.name = rep.name;
 
-            optional<EntryData> eData = data->getEntryData(rns.namespaceName, rep.name);
+            optional<EntryData> eData = prefetchedEntryData.get();
+            flatIndex++;
+            if (flatIndex < flatEntries.size()) {
+                prefetchedEntryData =
+                    prefetchEntryData(flatEntries[flatIndex].first, flatEntries[flatIndex].second);
+            }
             if (!eData) {
                 resultEntryParcel.status = STATUS_NO_SUCH_ENTRY;
                 resultNamespaceParcel.entries.push_back(resultEntryParcel);
@@ -504,9 +560,11 @@ Status Credential::getEntries(const vector<uint8_t>& requestMessage,
         ret.staticAuthenticationData = authKey->staticAuthenticationData;
     }
 
-    // Ensure useCount is updated on disk.
+    // Ensure useCount is updated on disk. Only the auth key state changed,
+    // so the small journal write suffices; rewriting the whole credential
+    // (including all entry data) here would cost both latency and flash wear.
     if (authKey != nullptr) {
-        if (!data->saveToDisk()) {
+        if (!data->saveAuthKeyJournalToDisk()) {
             return Status::fromServiceSpecificError(ICredentialStore::ERROR_GENERIC,
                                                     "Error saving data");
         }
@@ -517,6 +575,7 @@ Status Credential::getEntries(const vector<uint8_t>& requestMessage,
 }
 
 Status Credential::deleteCredential(vector<uint8_t>* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     vector<uint8_t> proofOfDeletionSignature;
 
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
@@ -540,6 +599,7 @@ Status Credential::deleteCredential(vector<uint8_t>* _aidl_return) {
 
 Status Credential::deleteWithChallenge(const vector<uint8_t>& challenge,
                                        vector<uint8_t>* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     if (halApiVersion_ < 3) {
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_NOT_SUPPORTED,
                                                 "Not implemented by HAL");
@@ -566,6 +626,7 @@ Status Credential::deleteWithChallenge(const vector<uint8_t>& challenge,
 }
 
 Status Credential::proveOwnership(const vector<uint8_t>& challenge, vector<uint8_t>* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     if (halApiVersion_ < 3) {
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_NOT_SUPPORTED,
                                                 "Not implemented by HAL");
@@ -580,6 +641,7 @@ Status Credential::proveOwnership(const vector<uint8_t>& challenge, vector<uint8
 }
 
 Status Credential::createEphemeralKeyPair(vector<uint8_t>* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     vector<uint8_t> keyPair;
     Status status = halBinder_->createEphemeralKeyPair(&keyPair);
     if (!status.isOk()) {
@@ -602,6 +664,7 @@ Status Credential::createEphemeralKeyPair(vector<uint8_t>* _aidl_return) {
 }
 
 Status Credential::setReaderEphemeralPublicKey(const vector<uint8_t>& publicKey) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     Status status = halBinder_->setReaderEphemeralPublicKey(publicKey);
     if (!status.isOk()) {
         return halStatusToGenericError(status);
@@ -610,6 +673,7 @@ Status Credential::setReaderEphemeralPublicKey(const vector<uint8_t>& publicKey)
 }
 
 Status Credential::setAvailableAuthenticationKeys(int32_t keyCount, int32_t maxUsesPerKey) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
     if (!data->loadFromDisk()) {
         LOG(ERROR) << "Error loading data for credential";
@@ -625,6 +689,7 @@ Status Credential::setAvailableAuthenticationKeys(int32_t keyCount, int32_t maxU
 }
 
 Status Credential::getAuthKeysNeedingCertification(vector<AuthKeyParcel>* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
     if (!data->loadFromDisk()) {
         LOG(ERROR) << "Error loading data for credential";
@@ -643,7 +708,8 @@ Status Credential::getAuthKeysNeedingCertification(vector<AuthKeyParcel>* _aidl_
         authKeyParcel.x509cert = key;
         authKeyParcels.push_back(authKeyParcel);
     }
-    if (!data->saveToDisk()) {
+    // Only auth key state (pending certificates/key blobs) changed.
+    if (!data->saveAuthKeyJournalToDisk()) {
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_GENERIC,
                                                 "Error saving data");
     }
@@ -653,6 +719,7 @@ Status Credential::getAuthKeysNeedingCertification(vector<AuthKeyParcel>* _aidl_
 
 Status Credential::storeStaticAuthenticationData(const AuthKeyParcel& authenticationKey,
                                                  const vector<uint8_t>& staticAuthData) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     sp<CredentialData> data = new CredentialData(dataPath_, callingUid_, credentialName_);
     if (!data->loadFromDisk()) {
         LOG(ERROR) << "Error loading data for credential";
@@ -666,7 +733,7 @@ Status Credential::storeStaticAuthenticationData(const AuthKeyParcel& authentica
             "Error finding authentication key to store static "
             "authentication data for");
     }
-    if (!data->saveToDisk()) {
+    if (!data->saveAuthKeyJournalToDisk()) {
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_GENERIC,
                                                 "Error saving data");
     }
@@ -677,6 +744,7 @@ Status
 Credential::storeStaticAuthenticationDataWithExpiration(const AuthKeyParcel& authenticationKey,
                                                         int64_t expirationDateMillisSinceEpoch,
                                                         const vector<uint8_t>& staticAuthData) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     if (halApiVersion_ < 3) {
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_NOT_SUPPORTED,
                                                 "Not implemented by HAL");
@@ -694,7 +762,7 @@ Credential::storeStaticAuthenticationDataWithExpiration(const AuthKeyParcel& aut
             "Error finding authentication key to store static "
             "authentication data for");
     }
-    if (!data->saveToDisk()) {
+    if (!data->saveAuthKeyJournalToDisk()) {
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_GENERIC,
                                                 "Error saving data");
     }
@@ -737,6 +805,7 @@ optional<string> extractDocType(const vector<uint8_t>& credentialData) {
 }
 
 Status Credential::update(sp<IWritableCredential>* _aidl_return) {
+    std::lock_guard<std::mutex> lock(halSessionMutex_);
     if (halApiVersion_ < 3) {
         return Status::fromServiceSpecificError(ICredentialStore::ERROR_NOT_SUPPORTED,
                                                 "Not implemented by HAL");
@@ -790,6 +859,13 @@ Status Credential::update(sp<IWritableCredential>* _aidl_return) {
 }
 
 void Credential::writableCredentialPersonalized() {
+    // Re-personalization replaced the data on disk, including the credential
+    // key certificate chain, so the cached copy must go.
+    {
+        std::lock_guard<std::mutex> lock(certificateChainMutex_);
+        credentialKeyCertificateChain_.clear();
+    }
+
     Status status = ensureOrReplaceHalBinder();
     if (!status.isOk()) {
         LOG(ERROR) << "Error reloading credential";
@@ -17,6 +17,7 @@
 #ifndef SYSTEM_SECURITY_CREDENTIAL_H_
 #define SYSTEM_SECURITY_CREDENTIAL_H_
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -100,6 +101,22 @@ class Credential : public BnCredential {
     sp<IIdentityCredential> halBinder_;
     int halApiVersion_;
 
+    // Serializes the calls that use the stateful, strictly ordered HAL
+    // session or that modify the credential's on-disk state. Credstore runs a
+    // binder thread pool, so two threads must not interleave e.g. a retrieval
+    // session on the same credential. Short read-only calls deliberately do
+    // not take this mutex so they aren't queued behind a multi-second
+    // getEntries() on the same credential.
+    std::mutex halSessionMutex_;
+
+    // The chain is immutable for the lifetime of the credential (it is only
+    // replaced when the credential is updated and re-personalized), so it is
+    // cached here after the first load to avoid re-reading the credential
+    // file on every getCredentialKeyCertificateChain call. Guarded by its own
+    // mutex so reads don't contend with |halSessionMutex_|.
+    std::mutex certificateChainMutex_;
+    vector<uint8_t> credentialKeyCertificateChain_;
+
     bool ensureChallenge();
 
     ssize_t
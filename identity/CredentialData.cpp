@@ -20,6 +20,7 @@
 
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -51,6 +52,7 @@ string CredentialData::calculateCredentialFileName(const string& dataPath, uid_t
 CredentialData::CredentialData(const string& dataPath, uid_t ownerUid, const string& name)
     : dataPath_(dataPath), ownerUid_(ownerUid), name_(name), secureUserId_(0) {
     fileName_ = calculateCredentialFileName(dataPath_, ownerUid_, name_);
+    journalFileName_ = fileName_ + ".update";
 }
 
 void CredentialData::setSecureUserId(int64_t secureUserId) {
@@ -75,68 +77,269 @@ void CredentialData::addEntryData(const string& namespaceName, const string& ent
     idToEncryptedChunks_[namespaceName + ":" + entryName] = data;
 }
 
+cppbor::Array encodeAuthKeyDatas(const vector<AuthKeyData>& authKeyDatas) {
+    cppbor::Array authKeyDatasArray;
+    for (const AuthKeyData& data : authKeyDatas) {
+        cppbor::Array array;
+        // Fields 0-6 was in the original version in Android 11
+        array.add(data.certificate);
+        array.add(data.keyBlob);
+        array.add(data.staticAuthenticationData);
+        array.add(data.pendingCertificate);
+        array.add(data.pendingKeyBlob);
+        array.add(data.useCount);
+        // Field 7 was added in Android 12
+        array.add(data.expirationDateMillisSinceEpoch);
+        authKeyDatasArray.add(std::move(array));
+    }
+    return authKeyDatasArray;
+}
+
+// CBOR emit helpers, the writing counterparts of readCborHeader() below. They
+// produce the same minimal-length headers cppbor emits, so the on-disk format
+// is byte-for-byte what a cppbor tree would have produced. Streaming through
+// these instead of building a cppbor::Map avoids copying every entry chunk
+// into Bstr nodes, which roughly tripled transient memory while saving large
+// credentials (the chunks, the tree, and the encoded output all live at once).
+
+// CBOR major types, from RFC 8949.
+constexpr int kCborMajorUnsigned = 0;
+constexpr int kCborMajorNegative = 1;
+constexpr int kCborMajorBstr = 2;
+constexpr int kCborMajorTstr = 3;
+constexpr int kCborMajorArray = 4;
+constexpr int kCborMajorMap = 5;
+
+// The largest possible header (initial byte plus an 8-byte argument), used
+// when upper-bounding the encoded size.
+constexpr size_t kCborMaxHeaderSize = 9;
+
+void appendCborHeader(int majorType, uint64_t value, vector<uint8_t>* out) {
+    uint8_t type = majorType << 5;
+    if (value < 24) {
+        out->push_back(type | value);
+    } else if (value <= 0xff) {
+        out->push_back(type | 24);
+        out->push_back(value);
+    } else if (value <= 0xffff) {
+        out->push_back(type | 25);
+        out->push_back(value >> 8);
+        out->push_back(value & 0xff);
+    } else if (value <= 0xffffffff) {
+        out->push_back(type | 26);
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out->push_back((value >> shift) & 0xff);
+        }
+    } else {
+        out->push_back(type | 27);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out->push_back((value >> shift) & 0xff);
+        }
+    }
+}
+
+void appendCborInt(int64_t value, vector<uint8_t>* out) {
+    if (value < 0) {
+        appendCborHeader(kCborMajorNegative, uint64_t(-(value + 1)), out);
+    } else {
+        appendCborHeader(kCborMajorUnsigned, uint64_t(value), out);
+    }
+}
+
+void appendCborBool(bool value, vector<uint8_t>* out) {
+    out->push_back(value ? 0xf5 : 0xf4);
+}
+
+void appendCborTstr(const string& value, vector<uint8_t>* out) {
+    appendCborHeader(kCborMajorTstr, value.size(), out);
+    out->insert(out->end(), value.begin(), value.end());
+}
+
+// Streams the CBOR for saveToDisk() into a scatter/gather list for the
+// writev-based fileSetContents() overload. Headers, integers and short text
+// strings accumulate in one pre-reserved arena while byte string payloads are
+// borrowed from their source vectors, so the bulk of the credential - the
+// encrypted entry chunks and certificates - is never copied on its way to
+// disk. The arena must never outgrow the capacity reserved at construction
+// because the emitted iovecs point into it; flushOwnedRun() checks this.
+class CborSegmentBuilder {
+  public:
+    explicit CborSegmentBuilder(size_t ownedUpperBound) {
+        owned_.reserve(ownedUpperBound);
+        ownedCapacity_ = owned_.capacity();
+    }
+
+    void appendHeader(int majorType, uint64_t value) {
+        appendCborHeader(majorType, value, &owned_);
+    }
+
+    void appendInt(int64_t value) { appendCborInt(value, &owned_); }
+
+    void appendBool(bool value) { appendCborBool(value, &owned_); }
+
+    void appendTstr(const string& value) { appendCborTstr(value, &owned_); }
+
+    // Emits the bstr header into the arena and borrows the payload from
+    // |data|, which must stay unchanged until the segments are written out.
+    void appendBstr(const vector<uint8_t>& data) {
+        appendCborHeader(kCborMajorBstr, data.size(), &owned_);
+        flushOwnedRun();
+        if (!data.empty()) {
+            segments_.push_back({const_cast<uint8_t*>(data.data()), data.size()});
+        }
+    }
+
+    const vector<iovec>& finish() {
+        flushOwnedRun();
+        return segments_;
+    }
+
+  private:
+    void flushOwnedRun() {
+        // A reallocation here would have invalidated the iovecs already
+        // pointing into the arena.
+        CHECK(owned_.capacity() == ownedCapacity_);
+        if (owned_.size() > ownedRunStart_) {
+            segments_.push_back({owned_.data() + ownedRunStart_, owned_.size() - ownedRunStart_});
+            ownedRunStart_ = owned_.size();
+        }
+    }
+
+    vector<uint8_t> owned_;
+    size_t ownedCapacity_;
+    size_t ownedRunStart_ = 0;
+    vector<iovec> segments_;
+};
+
 bool CredentialData::saveToDisk() const {
-    cppbor::Map map;
+    // Entries still deferred from loadFromDisk() have to be decoded before
+    // the whole credential can be re-serialized.
+    while (!idToLazyEntryData_.empty()) {
+        if (!materializeEntryData(idToLazyEntryData_.begin()->first)) {
+            LOG(ERROR) << "Error materializing deferred entry data";
+            return false;
+        }
+    }
 
-    map.add("secureUserId", secureUserId_);
+    updateGeneration_ += 1;
+
+    // Upper-bound the owned part of the encoding - headers at their nine byte
+    // maximum plus the short text strings - so the builder's arena is a
+    // single allocation. Byte string payloads are borrowed, not counted.
+    size_t ownedBound = kCborMaxHeaderSize;  // top-level map header
+    for (const char* key : {"updateGeneration", "secureUserId", "credentialData",
+                            "attestationCertificate", "secureAccessControlProfiles", "entryData",
+                            "authKeyCount", "maxUsesPerAuthKey", "authKeyData"}) {
+        // Key tstr plus, for the scalar-valued keys, the value itself.
+        ownedBound += strlen(key) + 2 * kCborMaxHeaderSize;
+    }
+    ownedBound += secureAccessControlProfiles_.size() * 7 * kCborMaxHeaderSize;
+    for (auto const& [nsAndName, entryData] : idToEncryptedChunks_) {
+        ownedBound += nsAndName.size() + 5 * kCborMaxHeaderSize;
+        ownedBound += entryData.accessControlProfileIds.size() * kCborMaxHeaderSize;
+        ownedBound += entryData.encryptedChunks.size() * kCborMaxHeaderSize;
+    }
+    ownedBound += authKeyDatas_.size() * 8 * kCborMaxHeaderSize;
+
+    CborSegmentBuilder builder(ownedBound);
+
+    builder.appendHeader(kCborMajorMap, 9);
 
-    map.add("credentialData", credentialData_);
+    builder.appendTstr("updateGeneration");
+    builder.appendInt(updateGeneration_);
 
-    map.add("attestationCertificate", attestationCertificate_);
+    builder.appendTstr("secureUserId");
+    builder.appendInt(secureUserId_);
 
-    cppbor::Array sacpArray;
+    builder.appendTstr("credentialData");
+    builder.appendBstr(credentialData_);
+
+    builder.appendTstr("attestationCertificate");
+    builder.appendBstr(attestationCertificate_);
+
+    builder.appendTstr("secureAccessControlProfiles");
+    builder.appendHeader(kCborMajorArray, secureAccessControlProfiles_.size());
     for (const SecureAccessControlProfile& sacp : secureAccessControlProfiles_) {
-        cppbor::Array array;
-        array.add(sacp.id);
-        array.add(sacp.readerCertificate.encodedCertificate);
-        array.add(sacp.userAuthenticationRequired);
-        array.add(sacp.timeoutMillis);
-        array.add(sacp.secureUserId);
-        vector<uint8_t> mac = sacp.mac;
-        array.add(mac);
-        sacpArray.add(std::move(array));
-    }
-    map.add("secureAccessControlProfiles", std::move(sacpArray));
-
-    cppbor::Map encryptedBlobsMap;
+        builder.appendHeader(kCborMajorArray, 6);
+        builder.appendInt(sacp.id);
+        builder.appendBstr(sacp.readerCertificate.encodedCertificate);
+        builder.appendBool(sacp.userAuthenticationRequired);
+        builder.appendInt(sacp.timeoutMillis);
+        builder.appendInt(sacp.secureUserId);
+        builder.appendBstr(sacp.mac);
+    }
+
+    builder.appendTstr("entryData");
+    builder.appendHeader(kCborMajorMap, idToEncryptedChunks_.size());
     for (auto const& [nsAndName, entryData] : idToEncryptedChunks_) {
-        cppbor::Array encryptedChunkArray;
-        for (const vector<uint8_t>& encryptedChunk : entryData.encryptedChunks) {
-            encryptedChunkArray.add(encryptedChunk);
-        }
-        cppbor::Array entryDataArray;
-        entryDataArray.add(entryData.size);
-        cppbor::Array idsArray;
+        builder.appendTstr(nsAndName);
+        builder.appendHeader(kCborMajorArray, 3);
+        builder.appendInt(int64_t(entryData.size));
+        builder.appendHeader(kCborMajorArray, entryData.accessControlProfileIds.size());
         for (int32_t id : entryData.accessControlProfileIds) {
-            idsArray.add(id);
+            builder.appendInt(id);
+        }
+        builder.appendHeader(kCborMajorArray, entryData.encryptedChunks.size());
+        for (const vector<uint8_t>& encryptedChunk : entryData.encryptedChunks) {
+            builder.appendBstr(encryptedChunk);
         }
-        entryDataArray.add(std::move(idsArray));
-        entryDataArray.add(std::move(encryptedChunkArray));
-        encryptedBlobsMap.add(nsAndName, std::move(entryDataArray));
     }
-    map.add("entryData", std::move(encryptedBlobsMap));
-    map.add("authKeyCount", keyCount_);
-    map.add("maxUsesPerAuthKey", maxUsesPerKey_);
 
-    cppbor::Array authKeyDatasArray;
+    builder.appendTstr("authKeyCount");
+    builder.appendInt(keyCount_);
+
+    builder.appendTstr("maxUsesPerAuthKey");
+    builder.appendInt(maxUsesPerKey_);
+
+    builder.appendTstr("authKeyData");
+    builder.appendHeader(kCborMajorArray, authKeyDatas_.size());
     for (const AuthKeyData& data : authKeyDatas_) {
-        cppbor::Array array;
+        builder.appendHeader(kCborMajorArray, 7);
         // Fields 0-6 was in the original version in Android 11
-        array.add(data.certificate);
-        array.add(data.keyBlob);
-        array.add(data.staticAuthenticationData);
-        array.add(data.pendingCertificate);
-        array.add(data.pendingKeyBlob);
-        array.add(data.useCount);
+        builder.appendBstr(data.certificate);
+        builder.appendBstr(data.keyBlob);
+        builder.appendBstr(data.staticAuthenticationData);
+        builder.appendBstr(data.pendingCertificate);
+        builder.appendBstr(data.pendingKeyBlob);
+        builder.appendInt(data.useCount);
         // Field 7 was added in Android 12
-        array.add(data.expirationDateMillisSinceEpoch);
-        authKeyDatasArray.add(std::move(array));
+        builder.appendInt(data.expirationDateMillisSinceEpoch);
     }
-    map.add("authKeyData", std::move(authKeyDatasArray));
 
-    vector<uint8_t> credentialData = map.encode();
+    if (!fileSetContents(fileName_, builder.finish())) {
+        return false;
+    }
 
-    return fileSetContents(fileName_, credentialData);
+    // The main file now holds everything the journal did (and possibly more),
+    // so the journal can go away. If unlinking fails or we crash before it,
+    // the generation check in loadAuthKeyJournal_() keeps the stale journal
+    // from being applied.
+    if (unlink(journalFileName_.c_str()) != 0 && errno != ENOENT) {
+        PLOG(WARNING) << "Error deleting " << journalFileName_;
+    }
+    return true;
+}
+
+bool CredentialData::saveAuthKeyJournalToDisk() const {
+    updateGeneration_ += 1;
+
+    cppbor::Map map;
+    map.add("updateGeneration", updateGeneration_);
+    map.add("secureUserId", secureUserId_);
+    map.add("authKeyCount", keyCount_);
+    map.add("maxUsesPerAuthKey", maxUsesPerKey_);
+    map.add("authKeyData", encodeAuthKeyDatas(authKeyDatas_));
+
+    // Certification flows rewrite the journal once per auth key in quick
+    // succession; write without a per-call fsync and let the coalescer issue
+    // one flush for the whole burst. Losing the tail of a burst on power loss
+    // is acceptable for the journal - loadAuthKeyJournal_() falls back to the
+    // main file - the main file itself is always written fully synced.
+    if (!fileSetContents(journalFileName_, map.encode(), /* sync= */ false)) {
+        return false;
+    }
+    scheduleCoalescedSync(journalFileName_);
+    return true;
 }
 
 optional<SecureAccessControlProfile> parseSacp(const cppbor::Item& item) {
@@ -244,36 +447,163 @@ optional<vector<vector<uint8_t>>> parseEncryptedChunks(const cppbor::Item& item)
     return encryptedChunks;
 }
 
+optional<EntryData> parseEntryDataValue(const cppbor::Item& item) {
+    const cppbor::Array* ecEntryArrayItem = item.asArray();
+    if (ecEntryArrayItem == nullptr || ecEntryArrayItem->size() < 3) {
+        LOG(ERROR) << "Value item in encryptedChunks map is an array with at least two "
+                      "elements";
+        return {};
+    }
+    const cppbor::Int* ecEntrySizeItem = (*ecEntryArrayItem)[0]->asInt();
+    if (ecEntrySizeItem == nullptr) {
+        LOG(ERROR) << "Entry size not a number";
+        return {};
+    }
+    uint64_t entrySize = ecEntrySizeItem->value();
+
+    optional<vector<int32_t>> accessControlProfileIds =
+        parseAccessControlProfileIds(*(*ecEntryArrayItem)[1]);
+    if (!accessControlProfileIds) {
+        LOG(ERROR) << "Error parsing access control profile ids";
+        return {};
+    }
+
+    optional<vector<vector<uint8_t>>> encryptedChunks =
+        parseEncryptedChunks(*(*ecEntryArrayItem)[2]);
+    if (!encryptedChunks) {
+        LOG(ERROR) << "Error parsing encrypted chunks";
+        return {};
+    }
+
+    EntryData data;
+    data.size = entrySize;
+    data.accessControlProfileIds = accessControlProfileIds.value();
+    data.encryptedChunks = encryptedChunks.value();
+    return data;
+}
+
+// Decodes the header of the CBOR item at |*pos|, advancing |*pos| past the
+// header and storing the major type and the argument value. Returns false on
+// truncated input and on indefinite lengths, which cppbor never produces.
+bool readCborHeader(const uint8_t** pos, const uint8_t* end, int* majorType, uint64_t* value) {
+    if (*pos >= end) {
+        return false;
+    }
+    uint8_t first = *(*pos)++;
+    *majorType = first >> 5;
+    uint8_t info = first & 0x1f;
+    if (info < 24) {
+        *value = info;
+        return true;
+    }
+    size_t numBytes;
+    switch (info) {
+    case 24:
+        numBytes = 1;
+        break;
+    case 25:
+        numBytes = 2;
+        break;
+    case 26:
+        numBytes = 4;
+        break;
+    case 27:
+        numBytes = 8;
+        break;
+    default:
+        // 28-30 are reserved, 31 is indefinite length.
+        return false;
+    }
+    if (size_t(end - *pos) < numBytes) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (size_t n = 0; n < numBytes; n++) {
+        v = (v << 8) | (*pos)[n];
+    }
+    *pos += numBytes;
+    *value = v;
+    return true;
+}
+
+// Advances |*pos| past one complete definite-length CBOR item without
+// materializing it. Returns false on malformed or truncated input.
+bool skipCborItem(const uint8_t** pos, const uint8_t* end) {
+    int majorType;
+    uint64_t value;
+    if (!readCborHeader(pos, end, &majorType, &value)) {
+        return false;
+    }
+    switch (majorType) {
+    case 0:  // unsigned int, the argument is the value
+    case 1:  // negative int, the argument is the value
+    case 7:  // simple value / float, the argument is the value
+        return true;
+    case 2:  // bstr
+    case 3:  // tstr
+        if (uint64_t(end - *pos) < value) {
+            return false;
+        }
+        *pos += value;
+        return true;
+    case 4:  // array
+        for (uint64_t n = 0; n < value; n++) {
+            if (!skipCborItem(pos, end)) {
+                return false;
+            }
+        }
+        return true;
+    case 5:  // map
+        for (uint64_t n = 0; n < 2 * value; n++) {
+            if (!skipCborItem(pos, end)) {
+                return false;
+            }
+        }
+        return true;
+    case 6:  // tag, followed by one tagged item
+        return skipCborItem(pos, end);
+    }
+    return false;
+}
+
 bool CredentialData::loadFromDisk() {
     // Reset all data.
     credentialData_.clear();
     attestationCertificate_.clear();
     secureAccessControlProfiles_.clear();
     idToEncryptedChunks_.clear();
+    idToLazyEntryData_.clear();
     authKeyDatas_.clear();
     keyCount_ = 0;
     maxUsesPerKey_ = 1;
+    updateGeneration_ = 0;
 
-    optional<vector<uint8_t>> data = fileGetContents(fileName_);
-    if (!data) {
+    // The file is mapped rather than read so entry payloads - which dominate
+    // the file size for credentials with e.g. portrait images - can be left
+    // as ranges into the mapping and decoded only if the entry is requested.
+    std::shared_ptr<MappedFile> mapping = MappedFile::open(fileName_);
+    if (!mapping) {
         LOG(ERROR) << "Error loading data";
         return false;
     }
-
-    auto [item, _ /* newPos */, message] = cppbor::parse(data.value());
-    if (item == nullptr) {
-        LOG(ERROR) << "Data loaded from " << fileName_ << " is not valid CBOR: " << message;
+    const uint8_t* begin = mapping->data();
+    const uint8_t* end = begin + mapping->size();
+    const uint8_t* pos = begin;
+
+    int majorType;
+    uint64_t numPairs;
+    if (!readCborHeader(&pos, end, &majorType, &numPairs) || majorType != 5) {
+        LOG(ERROR) << "Top-level item in " << fileName_ << " is not a map";
         return false;
     }
 
-    const cppbor::Map* map = item->asMap();
-    if (map == nullptr) {
-        LOG(ERROR) << "Top-level item is not a map";
-        return false;
-    }
-
-    for (size_t n = 0; n < map->size(); n++) {
-        auto& [keyItem, valueItem] = (*map)[n];
+    for (uint64_t n = 0; n < numPairs; n++) {
+        auto [keyItem, keyEnd, keyMessage] = cppbor::parse(pos, end);
+        if (keyItem == nullptr) {
+            LOG(ERROR) << "Data loaded from " << fileName_ << " is not valid CBOR: " << keyMessage;
+            return false;
+        }
+        pos = keyEnd;
         const cppbor::Tstr* tstr = keyItem->asTstr();
         if (tstr == nullptr) {
             LOG(ERROR) << "Key item in top-level map is not a tstr";
@@ -281,6 +611,49 @@ bool CredentialData::loadFromDisk() {
         }
         const string& key = tstr->value();
 
+        if (key == "entryData") {
+            // Walk the entryData map without materializing the values; each
+            // value is recorded as a range into the mapping instead.
+            int ecMajorType;
+            uint64_t numEntries;
+            if (!readCborHeader(&pos, end, &ecMajorType, &numEntries) || ecMajorType != 5) {
+                LOG(ERROR) << "Value for encryptedChunks is not an map";
+                return false;
+            }
+            for (uint64_t m = 0; m < numEntries; m++) {
+                auto [ecKeyItem, ecKeyEnd, ecKeyMessage] = cppbor::parse(pos, end);
+                if (ecKeyItem == nullptr) {
+                    LOG(ERROR) << "Data loaded from " << fileName_
+                               << " is not valid CBOR: " << ecKeyMessage;
+                    return false;
+                }
+                pos = ecKeyEnd;
+                const cppbor::Tstr* ecTstr = ecKeyItem->asTstr();
+                if (ecTstr == nullptr) {
+                    LOG(ERROR) << "Key item in encryptedChunks map is not a tstr";
+                    return false;
+                }
+                const uint8_t* valueBegin = pos;
+                if (!skipCborItem(&pos, end)) {
+                    LOG(ERROR) << "Malformed entry value in encryptedChunks map";
+                    return false;
+                }
+                LazyEntryData lazyData;
+                lazyData.mapping = mapping;
+                lazyData.offset = size_t(valueBegin - begin);
+                lazyData.length = size_t(pos - valueBegin);
+                idToLazyEntryData_[ecTstr->value()] = lazyData;
+            }
+            continue;
+        }
+
+        auto [valueItem, valueEnd, message] = cppbor::parse(pos, end);
+        if (valueItem == nullptr) {
+            LOG(ERROR) << "Data loaded from " << fileName_ << " is not valid CBOR: " << message;
+            return false;
+        }
+        pos = valueEnd;
+
         if (key == "secureUserId") {
             const cppbor::Int* number = valueItem->asInt();
             if (number == nullptr) {
@@ -318,55 +691,6 @@ bool CredentialData::loadFromDisk() {
                 secureAccessControlProfiles_.push_back(sacp.value());
             }
 
-        } else if (key == "entryData") {
-            const cppbor::Map* map = valueItem->asMap();
-            if (map == nullptr) {
-                LOG(ERROR) << "Value for encryptedChunks is not an map";
-                return false;
-            }
-            for (size_t m = 0; m < map->size(); m++) {
-                auto& [ecKeyItem, ecValueItem] = (*map)[m];
-                const cppbor::Tstr* ecTstr = ecKeyItem->asTstr();
-                if (ecTstr == nullptr) {
-                    LOG(ERROR) << "Key item in encryptedChunks map is not a tstr";
-                    return false;
-                }
-                const string& ecId = ecTstr->value();
-
-                const cppbor::Array* ecEntryArrayItem = ecValueItem->asArray();
-                if (ecEntryArrayItem == nullptr || ecEntryArrayItem->size() < 3) {
-                    LOG(ERROR) << "Value item in encryptedChunks map is an array with at least two "
-                                  "elements";
-                    return false;
-                }
-                const cppbor::Int* ecEntrySizeItem = (*ecEntryArrayItem)[0]->asInt();
-                if (ecEntrySizeItem == nullptr) {
-                    LOG(ERROR) << "Entry size not a number";
-                    return false;
-                }
-                uint64_t entrySize = ecEntrySizeItem->value();
-
-                optional<vector<int32_t>> accessControlProfileIds =
-                    parseAccessControlProfileIds(*(*ecEntryArrayItem)[1]);
-                if (!accessControlProfileIds) {
-                    LOG(ERROR) << "Error parsing access control profile ids";
-                    return false;
-                }
-
-                optional<vector<vector<uint8_t>>> encryptedChunks =
-                    parseEncryptedChunks(*(*ecEntryArrayItem)[2]);
-                if (!encryptedChunks) {
-                    LOG(ERROR) << "Error parsing encrypted chunks";
-                    return false;
-                }
-
-                EntryData data;
-                data.size = entrySize;
-                data.accessControlProfileIds = accessControlProfileIds.value();
-                data.encryptedChunks = encryptedChunks.value();
-                idToEncryptedChunks_[ecId] = data;
-            }
-
         } else if (key == "authKeyData") {
             const cppbor::Array* array = valueItem->asArray();
             if (array == nullptr) {
@@ -398,6 +722,14 @@ bool CredentialData::loadFromDisk() {
                 return false;
             }
             maxUsesPerKey_ = number->value();
+
+        } else if (key == "updateGeneration") {
+            const cppbor::Int* number = valueItem->asInt();
+            if (number == nullptr) {
+                LOG(ERROR) << "Value for updateGeneration is not a number";
+                return false;
+            }
+            updateGeneration_ = number->value();
         }
     }
 
@@ -417,9 +749,107 @@ bool CredentialData::loadFromDisk() {
         return false;
     }
 
+    loadAuthKeyJournal_();
+
     return true;
 }
 
+void CredentialData::loadAuthKeyJournal_() {
+    struct stat statbuf;
+    if (stat(journalFileName_.c_str(), &statbuf) != 0) {
+        // No journal is the common case; the main file is authoritative.
+        return;
+    }
+
+    optional<vector<uint8_t>> data = fileGetContents(journalFileName_);
+    if (!data) {
+        LOG(WARNING) << "Error loading auth key journal, ignoring it";
+        return;
+    }
+
+    auto [item, _ /* newPos */, message] = cppbor::parse(data.value());
+    if (item == nullptr) {
+        LOG(WARNING) << "Auth key journal is not valid CBOR (" << message << "), ignoring it";
+        return;
+    }
+    const cppbor::Map* map = item->asMap();
+    if (map == nullptr) {
+        LOG(WARNING) << "Top-level item in auth key journal is not a map, ignoring it";
+        return;
+    }
+
+    int64_t journalGeneration = 0;
+    int64_t journalSecureUserId = 0;
+    int journalKeyCount = 0;
+    int journalMaxUsesPerKey = 1;
+    vector<AuthKeyData> journalAuthKeyDatas;
+
+    for (size_t n = 0; n < map->size(); n++) {
+        auto& [keyItem, valueItem] = (*map)[n];
+        const cppbor::Tstr* tstr = keyItem->asTstr();
+        if (tstr == nullptr) {
+            LOG(WARNING) << "Key item in auth key journal is not a tstr, ignoring journal";
+            return;
+        }
+        const string& key = tstr->value();
+
+        if (key == "authKeyData") {
+            const cppbor::Array* array = valueItem->asArray();
+            if (array == nullptr) {
+                LOG(WARNING) << "Value for authKeyData in journal is not an array, "
+                                "ignoring journal";
+                return;
+            }
+            for (size_t m = 0; m < array->size(); m++) {
+                optional<AuthKeyData> authKeyData = parseAuthKeyData(*(*array)[m]);
+                if (!authKeyData) {
+                    LOG(WARNING) << "Error parsing AuthKeyData in journal, ignoring journal";
+                    return;
+                }
+                journalAuthKeyDatas.push_back(authKeyData.value());
+            }
+        } else {
+            const cppbor::Int* number = valueItem->asInt();
+            if (number == nullptr) {
+                LOG(WARNING) << "Value for " << key << " in journal is not a number, "
+                             << "ignoring journal";
+                return;
+            }
+            if (key == "updateGeneration") {
+                journalGeneration = number->value();
+            } else if (key == "secureUserId") {
+                journalSecureUserId = number->value();
+            } else if (key == "authKeyCount") {
+                journalKeyCount = number->value();
+            } else if (key == "maxUsesPerAuthKey") {
+                journalMaxUsesPerKey = number->value();
+            }
+        }
+    }
+
+    // A journal that predates the main file (e.g. left behind when a crash
+    // interrupted saveToDisk() between the rename and the unlink) must not
+    // clobber the newer state.
+    if (journalGeneration < updateGeneration_) {
+        LOG(INFO) << "Auth key journal generation " << journalGeneration
+                  << " older than credential generation " << updateGeneration_ << ", ignoring it";
+        return;
+    }
+
+    if (size_t(journalKeyCount) != journalAuthKeyDatas.size()) {
+        LOG(WARNING) << "journal keyCount=" << journalKeyCount
+                     << " != journal authKeyDatas.size()=" << journalAuthKeyDatas.size()
+                     << ", ignoring journal";
+        return;
+    }
+
+    updateGeneration_ = journalGeneration;
+    secureUserId_ = journalSecureUserId;
+    keyCount_ = journalKeyCount;
+    maxUsesPerKey_ = journalMaxUsesPerKey;
+    authKeyDatas_ = std::move(journalAuthKeyDatas);
+}
+
 const vector<uint8_t>& CredentialData::getCredentialData() const {
     return credentialData_;
 }
@@ -438,21 +868,44 @@ const vector<SecureAccessControlProfile>& CredentialData::getSecureAccessControl
 
 bool CredentialData::hasEntryData(const string& namespaceName, const string& entryName) const {
     string id = namespaceName + ":" + entryName;
-    auto iter = idToEncryptedChunks_.find(id);
-    if (iter == idToEncryptedChunks_.end()) {
-        return false;
+    if (idToEncryptedChunks_.find(id) != idToEncryptedChunks_.end()) {
+        return true;
     }
-    return true;
+    return idToLazyEntryData_.find(id) != idToLazyEntryData_.end();
 }
 
 optional<EntryData> CredentialData::getEntryData(const string& namespaceName,
                                                  const string& entryName) const {
     string id = namespaceName + ":" + entryName;
     auto iter = idToEncryptedChunks_.find(id);
-    if (iter == idToEncryptedChunks_.end()) {
+    if (iter != idToEncryptedChunks_.end()) {
+        return iter->second;
+    }
+    return materializeEntryData(id);
+}
+
+optional<EntryData> CredentialData::materializeEntryData(const string& id) const {
+    auto lazyIter = idToLazyEntryData_.find(id);
+    if (lazyIter == idToLazyEntryData_.end()) {
+        return {};
+    }
+    const LazyEntryData& lazyData = lazyIter->second;
+
+    const uint8_t* valueBegin = lazyData.mapping->data() + lazyData.offset;
+    auto [valueItem, _ /* newPos */, message] =
+        cppbor::parse(valueBegin, valueBegin + lazyData.length);
+    if (valueItem == nullptr) {
+        LOG(ERROR) << "Deferred entry data for " << id << " is not valid CBOR: " << message;
+        return {};
+    }
+
+    optional<EntryData> data = parseEntryDataValue(*valueItem);
+    if (!data) {
         return {};
     }
-    return iter->second;
+    idToEncryptedChunks_[id] = data.value();
+    idToLazyEntryData_.erase(lazyIter);
+    return data;
 }
 
 bool CredentialData::deleteCredential() {
@@ -460,6 +913,9 @@ bool CredentialData::deleteCredential() {
         PLOG(ERROR) << "Error deleting " << fileName_;
         return false;
     }
+    if (unlink(journalFileName_.c_str()) != 0 && errno != ENOENT) {
+        PLOG(WARNING) << "Error deleting " << journalFileName_;
+    }
     return true;
 }
 
@@ -503,46 +959,37 @@ pair<int /* keyCount */, int /*maxUsersPerKey */> CredentialData::getAvailableAu
     return std::make_pair(keyCount_, maxUsesPerKey_);
 }
 
-AuthKeyData* CredentialData::findAuthKey_(bool allowUsingExhaustedKeys,
-                                          bool allowUsingExpiredKeys) {
-    AuthKeyData* candidate = nullptr;
+const AuthKeyData* CredentialData::selectAuthKey(bool allowUsingExhaustedKeys,
+                                                 bool allowUsingExpiredKeys) {
+    // A single pass tracks the least-used certified key among the un-expired
+    // keys and among all keys, so the expired-key fallback below doesn't have
+    // to re-walk the list (and re-compare every expiration) a second time.
+    AuthKeyData* bestUnexpired = nullptr;
+    AuthKeyData* bestOverall = nullptr;
 
     int64_t nowMilliSeconds =
         std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()) * 1000;
 
-    int n = 0;
     for (AuthKeyData& data : authKeyDatas_) {
-        if (nowMilliSeconds > data.expirationDateMillisSinceEpoch) {
-            if (!allowUsingExpiredKeys) {
-                continue;
-            }
+        if (data.certificate.size() == 0) {
+            continue;
         }
-        if (data.certificate.size() != 0) {
-            // Not expired, include in normal check
-            if (candidate == nullptr || data.useCount < candidate->useCount) {
-                candidate = &data;
+        if (bestOverall == nullptr || data.useCount < bestOverall->useCount) {
+            bestOverall = &data;
+        }
+        if (nowMilliSeconds <= data.expirationDateMillisSinceEpoch) {
+            if (bestUnexpired == nullptr || data.useCount < bestUnexpired->useCount) {
+                bestUnexpired = &data;
             }
         }
-        n++;
-    }
-
-    if (candidate == nullptr) {
-        return nullptr;
     }
 
-    if (candidate->useCount >= maxUsesPerKey_ && !allowUsingExhaustedKeys) {
-        return nullptr;
+    // First try to find a un-expired key..
+    AuthKeyData* candidate = bestUnexpired;
+    if (candidate != nullptr && candidate->useCount >= maxUsesPerKey_ && !allowUsingExhaustedKeys) {
+        candidate = nullptr;
     }
 
-    return candidate;
-}
-
-const AuthKeyData* CredentialData::selectAuthKey(bool allowUsingExhaustedKeys,
-                                                 bool allowUsingExpiredKeys) {
-    AuthKeyData* candidate;
-
-    // First try to find a un-expired key..
-    candidate = findAuthKey_(allowUsingExhaustedKeys, false);
     if (candidate == nullptr) {
         // That didn't work, there are no un-expired keys and we don't allow using expired keys.
         if (!allowUsingExpiredKeys) {
@@ -550,10 +997,13 @@ const AuthKeyData* CredentialData::selectAuthKey(bool allowUsingExhaustedKeys,
         }
 
         // See if there's an expired key then...
-        candidate = findAuthKey_(allowUsingExhaustedKeys, true);
+        candidate = bestOverall;
         if (candidate == nullptr) {
             return nullptr;
         }
+        if (candidate->useCount >= maxUsesPerKey_ && !allowUsingExhaustedKeys) {
+            return nullptr;
+        }
     }
 
     candidate->useCount += 1;
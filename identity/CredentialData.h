@@ -21,6 +21,7 @@
 #include <unistd.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -42,6 +43,8 @@ using ::std::string;
 using ::std::tuple;
 using ::std::vector;
 
+class MappedFile;
+
 struct EntryData {
     EntryData() {}
 
@@ -85,6 +88,14 @@ class CredentialData : public RefBase {
 
     bool saveToDisk() const;
 
+    // Persists only the mutable authentication key state (use counts, pending
+    // and certified key material) plus the secure user id into a small
+    // sidecar journal next to the credential file, leaving the entry data
+    // untouched. This is what presentations use for their bookkeeping writes;
+    // the journal is folded back into the main file by the next full
+    // saveToDisk().
+    bool saveAuthKeyJournalToDisk() const;
+
     bool loadFromDisk();
 
     bool deleteCredential();
@@ -121,7 +132,23 @@ class CredentialData : public RefBase {
                                        const vector<uint8_t>& staticAuthData);
 
   private:
-    AuthKeyData* findAuthKey_(bool allowUsingExhaustedKeys, bool allowUsingExpiredKeys);
+    // An entry whose parse was deferred at load time: a CBOR range into the
+    // mapped credential file, decoded only when the entry is first requested.
+    struct LazyEntryData {
+        std::shared_ptr<MappedFile> mapping;
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    // Decodes the entry with the given id from |idToLazyEntryData_| and moves
+    // it to |idToEncryptedChunks_|. Returns nothing if the id is unknown or
+    // the stored CBOR doesn't parse.
+    optional<EntryData> materializeEntryData(const string& id) const;
+
+    // Best-effort application of the auth key journal on top of the state
+    // just loaded from the main file. A missing, stale, or malformed journal
+    // leaves the main file's state in place.
+    void loadAuthKeyJournal_();
 
     // Set by constructor.
     //
@@ -131,6 +158,7 @@ class CredentialData : public RefBase {
 
     // Calculated at construction time, from |dataPath_|, |ownerUid_|, |name_|.
     string fileName_;
+    string journalFileName_;
 
     // Data serialized in CBOR from here:
     //
@@ -138,11 +166,19 @@ class CredentialData : public RefBase {
     vector<uint8_t> credentialData_;
     vector<uint8_t> attestationCertificate_;
     vector<SecureAccessControlProfile> secureAccessControlProfiles_;
-    map<string, EntryData> idToEncryptedChunks_;
+    // Entries are materialized on demand from |idToLazyEntryData_| into
+    // |idToEncryptedChunks_|, hence both maps are mutable.
+    mutable map<string, EntryData> idToEncryptedChunks_;
+    mutable map<string, LazyEntryData> idToLazyEntryData_;
 
     int keyCount_ = 0;
     int maxUsesPerKey_ = 1;
     vector<AuthKeyData> authKeyDatas_;  // Always |keyCount_| long.
+
+    // Bumped on every write (full file or journal) so a journal left behind
+    // by a crash is never applied on top of a newer main file. Mutable
+    // because saveToDisk()/saveAuthKeyJournalToDisk() are const.
+    mutable int64_t updateGeneration_ = 0;
 };
 
 }  // namespace identity
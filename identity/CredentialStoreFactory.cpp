@@ -16,6 +16,8 @@
 
 #define LOG_TAG "credstore"
 
+#include <thread>
+
 #include <android-base/logging.h>
 
 #include <binder/IPCThreadState.h>
@@ -57,6 +59,7 @@ CredentialStore* CredentialStoreFactory::createCredentialStore(const string& ins
 
 Status CredentialStoreFactory::getCredentialStore(int32_t credentialStoreType,
                                                   sp<ICredentialStore>* _aidl_return) {
+    std::lock_guard<std::mutex> lock(storesMutex_);
     switch (credentialStoreType) {
     case CREDENTIAL_STORE_TYPE_DEFAULT:
         if (defaultStore_.get() == nullptr) {
@@ -86,6 +89,35 @@ Status CredentialStoreFactory::getCredentialStore(int32_t credentialStoreType,
                                             "Unknown credential store type");
 }
 
+void CredentialStoreFactory::warmUpStoresInBackground() {
+    // Hold a strong reference so the factory outlives the thread.
+    sp<CredentialStoreFactory> factory(this);
+    std::thread([factory] {
+        struct {
+            int32_t type;
+            const char* instanceName;
+        } stores[] = {
+            {CREDENTIAL_STORE_TYPE_DEFAULT, "default"},
+            {CREDENTIAL_STORE_TYPE_DIRECT_ACCESS, "directAccess"},
+        };
+        sp<IServiceManager> sm = defaultServiceManager();
+        for (const auto& entry : stores) {
+            String16 serviceName = IIdentityCredentialStore::descriptor + String16("/") +
+                                   String16(entry.instanceName);
+            // Only warm up HALs the device actually declares; e.g. most
+            // devices have no direct access store and that's not an error.
+            if (!sm->isDeclared(serviceName)) {
+                continue;
+            }
+            sp<ICredentialStore> store;
+            Status status = factory->getCredentialStore(entry.type, &store);
+            if (!status.isOk()) {
+                LOG(WARNING) << "Error warming up credential store '" << entry.instanceName << "'";
+            }
+        }
+    }).detach();
+}
+
 }  // namespace identity
 }  // namespace security
 }  // namespace android
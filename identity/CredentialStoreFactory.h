@@ -17,6 +17,8 @@
 #ifndef SYSTEM_SECURITY_CREDENTIAL_STORE_FACTORY_H_
 #define SYSTEM_SECURITY_CREDENTIAL_STORE_FACTORY_H_
 
+#include <mutex>
+
 #include <android/security/identity/BnCredentialStoreFactory.h>
 
 #include "CredentialStore.h"
@@ -37,11 +39,20 @@ class CredentialStoreFactory : public BnCredentialStoreFactory {
     Status getCredentialStore(int32_t credentialStoreType,
                               sp<ICredentialStore>* _aidl_return) override;
 
+    // Resolves and initializes the declared store HALs on a background
+    // thread so the first presentation after process start doesn't pay for
+    // HAL discovery and getHardwareInformation(). Called once at service
+    // start, after the factory has been registered.
+    void warmUpStoresInBackground();
+
   private:
     CredentialStore* createCredentialStore(const string& instanceName);
 
     string dataPath_;
 
+    // Guards the two members below; stores are created lazily from binder
+    // threads and eagerly from the warm-up thread.
+    std::mutex storesMutex_;
     sp<CredentialStore> defaultStore_;
     sp<CredentialStore> directAccessStore_;
 };
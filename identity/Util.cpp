@@ -17,11 +17,20 @@
 #define LOG_TAG "credstore"
 
 #include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
@@ -80,52 +89,213 @@ optional<vector<uint8_t>> fileGetContents(const string& path) {
     return data;
 }
 
-bool fileSetContents(const string& path, const vector<uint8_t>& data) {
-    char tempName[4096];
-    int fd;
+// Writes all of |iov| to |fd|, resuming after short writes. |iov| is taken by
+// value since resuming has to adjust the entries in place.
+static bool writeAllSegments(int fd, const string& path, vector<iovec> iov) {
+    size_t index = 0;
+    while (index < iov.size()) {
+        if (iov[index].iov_len == 0) {
+            index += 1;
+            continue;
+        }
+        size_t count = std::min(iov.size() - index, size_t(IOV_MAX));
+        ssize_t numWritten = TEMP_FAILURE_RETRY(writev(fd, &iov[index], count));
+        if (numWritten <= 0) {
+            PLOG(ERROR) << "Failed writing into temp file for '" << path << "'";
+            return false;
+        }
+        size_t remaining = size_t(numWritten);
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            index += 1;
+        }
+        if (remaining > 0) {
+            iov[index].iov_base = static_cast<uint8_t*>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
+        }
+    }
+    return true;
+}
 
-    string tempNameStr = path + ".XXXXXX";
-    if (tempNameStr.size() >= sizeof tempName - 1) {
-        LOG(ERROR) << "Path name too long";
+bool fileSetContents(const string& path, const vector<iovec>& segments, bool sync) {
+    // Prefer an anonymous O_TMPFILE temp file: the data has no name until it
+    // is complete, so a crash mid-write cannot leave a stray temp file in the
+    // data directory. Not every filesystem supports O_TMPFILE; fall back to
+    // the classic mkstemp() temp file if the open fails.
+    size_t lastSlash = path.find_last_of('/');
+    string dir = (lastSlash == string::npos) ? "." : path.substr(0, lastSlash);
+    string tempName;
+    int fd = TEMP_FAILURE_RETRY(
+        open(dir.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, S_IRUSR | S_IWUSR));
+    if (fd == -1) {
+        tempName = path + ".XXXXXX";
+        fd = mkstemp(tempName.data());
+        if (fd == -1) {
+            PLOG(ERROR) << "Error creating temp file for '" << path << "'";
+            return false;
+        }
+    }
+
+    if (!writeAllSegments(fd, path, segments)) {
+        close(fd);
+        if (!tempName.empty()) {
+            unlink(tempName.c_str());
+        }
         return false;
     }
-    strncpy(tempName, tempNameStr.c_str(), sizeof tempName);
 
-    fd = mkstemp(tempName);
-    if (fd == -1) {
-        PLOG(ERROR) << "Error creating temp file for '" << path << "'";
+    if (sync && TEMP_FAILURE_RETRY(fsync(fd))) {
+        PLOG(ERROR) << "Failed fsyncing temp file for '" << path << "'";
+        close(fd);
+        if (!tempName.empty()) {
+            unlink(tempName.c_str());
+        }
         return false;
     }
 
-    const uint8_t* p = data.data();
-    size_t remaining = data.size();
-    while (remaining > 0) {
-        ssize_t numWritten = TEMP_FAILURE_RETRY(write(fd, p, remaining));
-        if (numWritten <= 0) {
-            PLOG(ERROR) << "Failed writing into temp file for '" << path << "'";
-            close(fd);
+    if (!tempName.empty()) {
+        close(fd);
+        if (rename(tempName.c_str(), path.c_str()) != 0) {
+            PLOG(ERROR) << "Error renaming temp file for '" << path << "'";
+            unlink(tempName.c_str());
             return false;
         }
-        p += numWritten;
-        remaining -= numWritten;
+        return true;
     }
 
-    if (TEMP_FAILURE_RETRY(fsync(fd))) {
-        PLOG(ERROR) << "Failed fsyncing temp file for '" << path << "'";
+    // Give the anonymous file its name. linkat() refuses to replace an
+    // existing path, so the common overwrite case goes through a linked temp
+    // name plus an atomic rename; a first-time write links directly.
+    string procPath = StringPrintf("/proc/self/fd/%d", fd);
+    if (linkat(AT_FDCWD, procPath.c_str(), AT_FDCWD, path.c_str(), AT_SYMLINK_FOLLOW) == 0) {
+        close(fd);
+        return true;
+    }
+    if (errno != EEXIST) {
+        PLOG(ERROR) << "Error linking temp file for '" << path << "'";
+        close(fd);
+        return false;
+    }
+    // The fd makes the name unique within the process; unlink first in case a
+    // previous run crashed between the link and the rename.
+    string linkName = StringPrintf("%s.%d.tmp", path.c_str(), fd);
+    unlink(linkName.c_str());
+    if (linkat(AT_FDCWD, procPath.c_str(), AT_FDCWD, linkName.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+        PLOG(ERROR) << "Error linking temp file for '" << path << "'";
         close(fd);
         return false;
     }
     close(fd);
-
-    if (rename(tempName, path.c_str()) != 0) {
+    if (rename(linkName.c_str(), path.c_str()) != 0) {
         PLOG(ERROR) << "Error renaming temp file for '" << path << "'";
-        close(fd);
+        unlink(linkName.c_str());
         return false;
     }
-
     return true;
 }
 
+bool fileSetContents(const string& path, const vector<uint8_t>& data, bool sync) {
+    vector<iovec> segments = {{const_cast<uint8_t*>(data.data()), data.size()}};
+    return fileSetContents(path, segments, sync);
+}
+
+namespace {
+
+// Batches the flushes for files written with fileSetContents(..., sync=false).
+// Certifying a full set of auth keys rewrites the journal once per key in
+// quick succession and each write previously paid its own fsync; with this,
+// all writes landing within the window share a single flush per path. Skipping
+// the flush entirely is not an option since the data should still reach disk
+// promptly, but a file opting in to coalescing must tolerate losing its last
+// writes on power loss (the auth key journal does: loadAuthKeyJournal_() falls
+// back to the main credential file if the journal is missing or malformed).
+class SyncCoalescer {
+  public:
+    static SyncCoalescer& getInstance() {
+        static SyncCoalescer instance;
+        return instance;
+    }
+
+    void schedule(const string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingPaths_.insert(path);
+        if (!flushScheduled_) {
+            flushScheduled_ = true;
+            std::thread([this] { flushAfterWindow(); }).detach();
+        }
+    }
+
+  private:
+    void flushAfterWindow() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kWindowMillis));
+        std::set<string> paths;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            paths.swap(pendingPaths_);
+            flushScheduled_ = false;
+        }
+        for (const string& path : paths) {
+            // The file may legitimately be gone by now, e.g. a full
+            // saveToDisk() unlinked the journal after folding it in.
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd == -1) {
+                continue;
+            }
+            if (TEMP_FAILURE_RETRY(fsync(fd)) != 0) {
+                PLOG(WARNING) << "Failed fsyncing '" << path << "'";
+            }
+            close(fd);
+        }
+    }
+
+    static constexpr int kWindowMillis = 100;
+
+    std::mutex mutex_;
+    std::set<string> pendingPaths_;
+    bool flushScheduled_ = false;
+};
+
+}  // namespace
+
+void scheduleCoalescedSync(const string& path) {
+    SyncCoalescer::getInstance().schedule(path);
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        PLOG(ERROR) << "Error opening " << path;
+        return nullptr;
+    }
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0) {
+        PLOG(ERROR) << "Error statting " << path;
+        close(fd);
+        return nullptr;
+    }
+
+    void* addr = nullptr;
+    size_t size = statbuf.st_size;
+    if (size > 0) {
+        addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            PLOG(ERROR) << "Error mapping " << path;
+            close(fd);
+            return nullptr;
+        }
+    }
+    close(fd);
+
+    return std::shared_ptr<MappedFile>(new MappedFile(addr, size));
+}
+
+MappedFile::~MappedFile() {
+    if (addr_ != nullptr) {
+        munmap(addr_, size_);
+    }
+}
+
 }  // namespace identity
 }  // namespace security
 }  // namespace android
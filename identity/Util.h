@@ -17,6 +17,10 @@
 #ifndef SYSTEM_SECURITY_IDENTITY_UTIL_H_
 #define SYSTEM_SECURITY_IDENTITY_UTIL_H_
 
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -41,9 +45,28 @@ Status halStatusToError(const Status& halStatus, int credStoreError);
 
 // Helper function to atomically write |data| into file at |path|.
 //
+// If |sync| is false the fsync before the rename is skipped; the caller is
+// expected to arrange a flush, e.g. via scheduleCoalescedSync() below. Only
+// use this for files that are best-effort by design, such as the auth key
+// journal.
+//
 // Returns true on success, false on error.
 //
-bool fileSetContents(const string& path, const vector<uint8_t>& data);
+bool fileSetContents(const string& path, const vector<uint8_t>& data, bool sync = true);
+
+// Scatter/gather variant of fileSetContents(): writes the |segments| in order
+// as if they had been one contiguous buffer, without the caller having to
+// concatenate them first. The segments only need to stay valid for the
+// duration of the call. Same atomicity and |sync| semantics as above.
+//
+bool fileSetContents(const string& path, const vector<iovec>& segments, bool sync = true);
+
+// Schedules an fsync of the file at |path| on a background thread after a
+// short window. Multiple calls within the window - e.g. the journal write per
+// storeStaticAuthenticationData() call when every auth key is certified in
+// one go - are coalesced into a single flush per path.
+//
+void scheduleCoalescedSync(const string& path);
 
 // Helper function which reads contents offile at |path| into |data|.
 //
@@ -51,6 +74,29 @@ bool fileSetContents(const string& path, const vector<uint8_t>& data);
 //
 optional<vector<uint8_t>> fileGetContents(const string& path);
 
+// A read-only memory mapping of a file. The mapping stays valid for as long
+// as some user of the file holds a reference to the object.
+//
+class MappedFile {
+  public:
+    // Maps the file at |path| read-only. Returns nullptr on error. A zero
+    // length file yields an empty mapping.
+    static std::shared_ptr<MappedFile> open(const string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const uint8_t* data() const { return static_cast<const uint8_t*>(addr_); }
+    size_t size() const { return size_; }
+
+  private:
+    MappedFile(void* addr, size_t size) : addr_(addr), size_(size) {}
+
+    void* addr_;
+    size_t size_;
+};
+
 }  // namespace identity
 }  // namespace security
 }  // namespace android
@@ -36,8 +36,6 @@ using ::std::pair;
 
 using ::android::hardware::identity::SecureAccessControlProfile;
 
-using ::android::hardware::identity::support::chunkVector;
-
 WritableCredential::WritableCredential(const string& dataPath, const string& credentialName,
                                        const string& docType, bool isUpdate,
                                        HardwareInformation hwInfo,
@@ -223,8 +221,6 @@ WritableCredential::personalize(const vector<AccessControlProfileParcel>& access
 
     for (const EntryNamespaceParcel& ensParcel : entryNamespaces) {
         for (const EntryParcel& eParcel : ensParcel.entries) {
-            vector<vector<uint8_t>> chunks = chunkVector(eParcel.value, hwInfo_.dataChunkSize);
-
             vector<int32_t> ids;
             std::copy(eParcel.accessControlProfileIds.begin(),
                       eParcel.accessControlProfileIds.end(), std::back_inserter(ids));
@@ -235,15 +231,27 @@ WritableCredential::personalize(const vector<AccessControlProfileParcel>& access
                 return halStatusToGenericError(status);
             }
 
+            // Stream the value to the HAL in dataChunkSize segments, slicing
+            // each chunk off the source value just before it is sent instead
+            // of materializing all chunks up front, which briefly held a
+            // second full copy of large-media entries. As with chunkVector(),
+            // an empty value is sent as a single empty chunk.
             vector<vector<uint8_t>> encryptedChunks;
-            for (const auto& chunk : chunks) {
+            size_t offset = 0;
+            do {
+                size_t thisSize = std::min(size_t(hwInfo_.dataChunkSize),
+                                           eParcel.value.size() - offset);
+                vector<uint8_t> chunk(eParcel.value.begin() + offset,
+                                      eParcel.value.begin() + offset + thisSize);
                 vector<uint8_t> encryptedChunk;
                 status = halBinder_->addEntryValue(chunk, &encryptedChunk);
                 if (!status.isOk()) {
                     return halStatusToGenericError(status);
                 }
-                encryptedChunks.push_back(encryptedChunk);
-            }
+                encryptedChunks.push_back(std::move(encryptedChunk));
+                offset += thisSize;
+            } while (offset < eParcel.value.size());
+
             EntryData eData;
             eData.size = eParcel.value.size();
             eData.accessControlProfileIds = std::move(ids);
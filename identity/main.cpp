@@ -23,6 +23,7 @@
 #include <android-base/logging.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
 
 #include "CredentialStoreFactory.h"
 
@@ -53,8 +54,19 @@ int main(int argc, char* argv[]) {
     CHECK(ret == ::android::OK) << "Couldn't register binder service";
     LOG(INFO) << "Registered binder service";
 
-    // Credstore is a single-threaded process. So devote the main thread
-    // to handling binder messages.
+    // Start resolving the store HALs right away so the first presentation
+    // (e.g. an NFC tap shortly after boot) doesn't pay for HAL discovery.
+    factory->warmUpStoresInBackground();
+
+    // Presentation calls like getEntries() can block on the HAL for seconds,
+    // and with a single binder thread every short call (e.g.
+    // getCredentialKeyCertificateChain) queues behind them. Run a small
+    // explicit thread pool - three spawned threads plus the main thread -
+    // sized to the handful of concurrent presentation/provisioning flows a
+    // device sees; per-credential HAL session state is serialized inside
+    // Credential itself.
+    android::ProcessState::self()->setThreadPoolMaxThreadCount(3);
+    android::ProcessState::self()->startThreadPool();
     IPCThreadState::self()->joinThreadPool();
 
     return 0;
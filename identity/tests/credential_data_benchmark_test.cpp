@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for the local (non-HAL) phases of a credential presentation:
+// loadFromDisk, the deferred entry decode, selectAuthKey and saveToDisk,
+// across a matrix of entry counts and sizes. Per-phase latency is printed so
+// regressions in the mdoc presentation budget can be tracked; each case also
+// asserts a full round trip so the suite doubles as a functional test of the
+// on-disk format. The HAL-facing phases (startRetrieval etc.) need a running
+// IIdentityCredentialStore and are covered by CTS instead.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cppbor.h>
+
+#include "../CredentialData.h"
+#include "../Util.h"
+
+namespace android {
+namespace security {
+namespace identity {
+namespace test {
+namespace {
+
+using ::std::optional;
+using ::std::string;
+using ::std::vector;
+
+constexpr uid_t kOwnerUid = 10042;
+constexpr size_t kChunkSize = 16 * 1024;
+constexpr int kNumAuthKeys = 10;
+constexpr int kMaxUsesPerAuthKey = 3;
+
+vector<uint8_t> pseudoRandomBytes(size_t size, uint8_t seed) {
+    vector<uint8_t> data(size);
+    uint8_t v = seed;
+    for (size_t n = 0; n < size; n++) {
+        v = v * 31 + 7;
+        data[n] = v;
+    }
+    return data;
+}
+
+// Builds a credential file with the same CBOR schema CredentialData uses,
+// encoded independently with cppbor so the load path is exercised against
+// bytes the production encoder didn't produce.
+vector<uint8_t> buildCredentialFile(size_t numEntries, size_t entrySize) {
+    cppbor::Map map;
+    map.add("secureUserId", 42);
+    map.add("credentialData", pseudoRandomBytes(256, 1));
+    map.add("attestationCertificate", pseudoRandomBytes(512, 2));
+    map.add("secureAccessControlProfiles", cppbor::Array());
+
+    cppbor::Map entryDataMap;
+    for (size_t n = 0; n < numEntries; n++) {
+        cppbor::Array chunksArray;
+        size_t remaining = entrySize;
+        uint8_t seed = uint8_t(n);
+        do {
+            size_t thisSize = std::min(kChunkSize, remaining);
+            chunksArray.add(pseudoRandomBytes(thisSize, seed++));
+            remaining -= thisSize;
+        } while (remaining > 0);
+        cppbor::Array entryArray;
+        entryArray.add(entrySize);
+        entryArray.add(cppbor::Array());  // accessControlProfileIds
+        entryArray.add(std::move(chunksArray));
+        entryDataMap.add("ns:entry" + std::to_string(n), std::move(entryArray));
+    }
+    map.add("entryData", std::move(entryDataMap));
+
+    map.add("authKeyCount", kNumAuthKeys);
+    map.add("maxUsesPerAuthKey", kMaxUsesPerAuthKey);
+    cppbor::Array authKeyDatasArray;
+    for (int n = 0; n < kNumAuthKeys; n++) {
+        cppbor::Array array;
+        array.add(pseudoRandomBytes(64, n));      // certificate
+        array.add(pseudoRandomBytes(64, n + 1));  // keyBlob
+        array.add(pseudoRandomBytes(64, n + 2));  // staticAuthenticationData
+        array.add(vector<uint8_t>());             // pendingCertificate
+        array.add(vector<uint8_t>());             // pendingKeyBlob
+        array.add(n % kMaxUsesPerAuthKey);        // useCount
+        array.add(INT64_MAX);                     // expirationDateMillisSinceEpoch
+        authKeyDatasArray.add(std::move(array));
+    }
+    map.add("authKeyData", std::move(authKeyDatasArray));
+
+    return map.encode();
+}
+
+void runMatrixCase(size_t numEntries, size_t entrySize) {
+    string dataPath = ::testing::TempDir();
+    string name = "bench-" + std::to_string(numEntries) + "-" + std::to_string(entrySize);
+    string fileName = CredentialData::calculateCredentialFileName(dataPath, kOwnerUid, name);
+    ASSERT_TRUE(fileSetContents(fileName, buildCredentialFile(numEntries, entrySize)));
+
+    sp<CredentialData> data = new CredentialData(dataPath, kOwnerUid, name);
+
+    auto t0 = std::chrono::steady_clock::now();
+    ASSERT_TRUE(data->loadFromDisk());
+    auto t1 = std::chrono::steady_clock::now();
+
+    // The first entry access pays the deferred decode for that entry.
+    ASSERT_TRUE(data->getEntryData("ns", "entry0"));
+    auto t2 = std::chrono::steady_clock::now();
+
+    for (size_t n = 0; n < numEntries; n++) {
+        optional<EntryData> eData = data->getEntryData("ns", "entry" + std::to_string(n));
+        ASSERT_TRUE(eData);
+        EXPECT_EQ(eData->size, entrySize);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    const AuthKeyData* authKey = data->selectAuthKey(false /* allowUsingExhaustedKeys */,
+                                                     false /* allowUsingExpiredKeys */);
+    ASSERT_NE(authKey, nullptr);
+    auto t4 = std::chrono::steady_clock::now();
+
+    ASSERT_TRUE(data->saveToDisk());
+    auto t5 = std::chrono::steady_clock::now();
+
+    // Reload what saveToDisk wrote so the streaming encoder and the loader
+    // are checked against each other.
+    sp<CredentialData> reloaded = new CredentialData(dataPath, kOwnerUid, name);
+    ASSERT_TRUE(reloaded->loadFromDisk());
+    optional<EntryData> entry = reloaded->getEntryData("ns", "entry0");
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->size, entrySize);
+    EXPECT_EQ(entry->encryptedChunks, data->getEntryData("ns", "entry0")->encryptedChunks);
+
+    auto micros = [](auto begin, auto end) {
+        return (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+            .count();
+    };
+    printf("entries=%3zu entrySize=%7zu load=%6lldus firstEntry=%6lldus allEntries=%7lldus "
+           "selectAuthKey=%4lldus save=%7lldus\n",
+           numEntries, entrySize, micros(t0, t1), micros(t1, t2), micros(t2, t3), micros(t3, t4),
+           micros(t4, t5));
+
+    ASSERT_TRUE(data->deleteCredential());
+}
+
+TEST(CredentialDataBenchmark, LoadDecodeSelectSave) {
+    for (size_t numEntries : vector<size_t>{4, 16, 64}) {
+        for (size_t entrySize : vector<size_t>{1024, 64 * 1024}) {
+            runMatrixCase(numEntries, entrySize);
+        }
+    }
+    // Portrait-image sized entries.
+    runMatrixCase(4, 512 * 1024);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace identity
+}  // namespace security
+}  // namespace android
@@ -33,7 +33,14 @@ EVP_PKEY* EVP_PKEY_from_keystore(const char* key_id) __attribute__((visibility("
 /* EVP_PKEY_from_keystore returns an |EVP_PKEY| that contains either an RSA or
  * ECDSA key where the public part of the key reflects the value of the key
  * named |key_id| in Keystore and the private operations are forwarded onto
- * KeyStore. */
+ * KeyStore.
+ *
+ * This is only a compatibility entry point: the legacy keymaster1 HIDL engine
+ * behind it is gone and everything is served by the Keystore 2.0 backend in
+ * keystore2_engine.cpp. That backend keeps a process-lifetime cached service
+ * proxy (re-resolved with backoff when keystore2 dies) and takes no
+ * process-wide lock around key operations, so concurrent handshakes from
+ * different threads issue their binder calls independently. */
 EVP_PKEY* EVP_PKEY_from_keystore(const char* key_id) {
     ALOGV("EVP_PKEY_from_keystore(\"%s\")", key_id);
 
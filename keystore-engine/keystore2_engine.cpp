@@ -20,6 +20,10 @@
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <android/binder_manager.h>
+#include <binderproxy/NdkProxyCache.h>
+
+#include <inttypes.h>
+#include <stdio.h>
 
 #include <private/android_filesystem_config.h>
 
@@ -31,8 +35,18 @@
 #include <openssl/engine.h>
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #define AT __func__ << ":" << __LINE__ << " "
 
 constexpr const char keystore2_service_name[] = "android.system.keystore2.IKeystoreService/default";
@@ -66,6 +80,87 @@ struct Keystore2KeyBackend {
     std::shared_ptr<ks2::IKeystoreSecurityLevel> i_keystore_security_level_;
 };
 
+/* LatencyHistogram is a log2-bucketed microsecond histogram with lock-free
+ * increments, cheap enough to leave enabled in production. One histogram per
+ * phase of the sign path (service lookup, createOperation, finish) lets a
+ * fleet dashboard attribute handshake tail latency to the right layer. */
+class LatencyHistogram {
+  public:
+    void record(int64_t micros) {
+        if (micros < 0) {
+            micros = 0;
+        }
+        size_t bucket = 63 - __builtin_clzll(static_cast<uint64_t>(micros) | 1);
+        if (bucket >= kBuckets) {
+            bucket = kBuckets - 1;
+        }
+        counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+        total_micros_.fetch_add(micros, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void dump(int fd, const char* name) const {
+        uint64_t count = count_.load(std::memory_order_relaxed);
+        uint64_t total = total_micros_.load(std::memory_order_relaxed);
+        dprintf(fd, "%s: count=%" PRIu64 " total_us=%" PRIu64 " avg_us=%" PRIu64 "\n", name, count,
+                total, count ? total / count : 0);
+        for (size_t i = 0; i < kBuckets; ++i) {
+            uint64_t bucket_count = counts_[i].load(std::memory_order_relaxed);
+            if (bucket_count == 0) {
+                continue;
+            }
+            dprintf(fd, "  <%" PRIu64 "us: %" PRIu64 "\n", uint64_t(1) << (i + 1), bucket_count);
+        }
+    }
+
+  private:
+    static constexpr size_t kBuckets = 21;
+
+    std::atomic<uint64_t> counts_[kBuckets]{};
+    std::atomic<uint64_t> total_micros_{0};
+    std::atomic<uint64_t> count_{0};
+};
+
+/* PhaseTimer records the lifetime of its scope into a LatencyHistogram. */
+class PhaseTimer {
+  public:
+    explicit PhaseTimer(LatencyHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start_)
+                              .count());
+    }
+
+  private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+LatencyHistogram gServiceLookupLatency;
+LatencyHistogram gCreateOperationLatency;
+LatencyHistogram gFinishLatency;
+
+/* getKeystoreService returns a persistent proxy for the keystore2 service,
+ * backed by the shared NdkProxyCache: the service manager lookup is performed
+ * once, a death recipient drops the proxy if keystore2 dies, and reconnects
+ * after a restart back off exponentially. The per-key IKeystoreSecurityLevel
+ * proxies returned by getKeyEntry are kept in Keystore2KeyBackend for the
+ * life of the wrapped key, so the steady state sign path performs no service
+ * manager lookups at all. */
+std::shared_ptr<ks2::IKeystoreService> getKeystoreService() {
+    static android::binderproxy::NdkProxyCache<ks2::IKeystoreService> cache(
+        keystore2_service_name);
+
+    /* Only actual resolutions count towards the lookup histogram; cache hits
+     * would drown the signal in near-zero samples. */
+    if (auto service = cache.peek()) {
+        return service;
+    }
+    PhaseTimer timer(gServiceLookupLatency);
+    return cache.get();
+}
+
 /* key_backend_dup is called when one of the RSA or EC_KEY objects is duplicated. */
 extern "C" int key_backend_dup(CRYPTO_EX_DATA* /* to */, const CRYPTO_EX_DATA* /* from */,
                                void** from_d, int /* index */, long /* argl */, void* /* argp */) {
@@ -215,8 +310,12 @@ std::optional<std::vector<uint8_t>> keystore2_sign(const Keystore2KeyBackend& ke
                            .value = KMV1::KeyParameterValue::make<KMV1::KeyParameterValue::digest>(
                                KMV1::Digest::NONE)};
 
-    auto rc = sec_level->createOperation(key_backend.descriptor_, op_params, false /* forced */,
-                                         &response);
+    ::ndk::ScopedAStatus rc;
+    {
+        PhaseTimer timer(gCreateOperationLatency);
+        rc = sec_level->createOperation(key_backend.descriptor_, op_params, false /* forced */,
+                                        &response);
+    }
     if (!rc.isOk()) {
         auto exception_code = rc.getExceptionCode();
         if (exception_code == EX_SERVICE_SPECIFIC) {
@@ -232,7 +331,10 @@ std::optional<std::vector<uint8_t>> keystore2_sign(const Keystore2KeyBackend& ke
     auto op = response.iOperation;
 
     std::optional<std::vector<uint8_t>> output = std::nullopt;
-    rc = op->finish(std::move(input), {}, &output);
+    {
+        PhaseTimer timer(gFinishLatency);
+        rc = op->finish(std::move(input), {}, &output);
+    }
     if (!rc.isOk()) {
         auto exception_code = rc.getExceptionCode();
         if (exception_code == EX_SERVICE_SPECIFIC) {
@@ -252,6 +354,101 @@ std::optional<std::vector<uint8_t>> keystore2_sign(const Keystore2KeyBackend& ke
     return output;
 }
 
+/* Upper bound on the keystore2 operations a single batch keeps in flight.
+ * Keystore prunes operations when its per-caller slots run out, so a batch
+ * must not occupy more than a few of them at once. */
+constexpr size_t kMaxConcurrentSignOperations = 4;
+
+/* keystore2_sign_batch signs every entry of |inputs| with the key behind
+ * |key_backend|. Each signature still needs its own createOperation plus
+ * finish pair, because finish ends a keystore2 operation, but the pairs are
+ * kept in flight concurrently so the batch completes in a few round trip
+ * times instead of one per digest. The calling thread participates in the
+ * work, so a batch of one costs the same as keystore2_sign. */
+std::vector<std::optional<std::vector<uint8_t>>>
+keystore2_sign_batch(const Keystore2KeyBackend& key_backend,
+                     std::vector<std::vector<uint8_t>> inputs, KMV1::Algorithm algorithm) {
+    std::vector<std::optional<std::vector<uint8_t>>> outputs(inputs.size());
+    if (inputs.empty()) {
+        return outputs;
+    }
+
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        for (size_t i = nextIndex.fetch_add(1); i < inputs.size(); i = nextIndex.fetch_add(1)) {
+            outputs[i] = keystore2_sign(key_backend, std::move(inputs[i]), algorithm);
+        }
+    };
+
+    size_t hwThreads = std::thread::hardware_concurrency();
+    size_t extraWorkers = std::min(inputs.size() - 1, kMaxConcurrentSignOperations - 1);
+    if (hwThreads > 0) {
+        extraWorkers = std::min(extraWorkers, hwThreads - 1);
+    }
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(extraWorkers);
+    for (size_t i = 0; i < extraWorkers; ++i) {
+        futures.push_back(std::async(std::launch::async, worker));
+    }
+    worker();
+    for (auto& future : futures) {
+        future.wait();
+    }
+
+    return outputs;
+}
+
+/* copy_rsa_output writes the |len| byte big-endian result of an RSA keystore
+ * operation to |out|, compensating for implementations that strip or add
+ * leading zeros. */
+void copy_rsa_output(uint8_t* out, size_t len, const std::vector<uint8_t>& output) {
+    if (output.size() > len) {
+        /* The result of the RSA operation can never be larger than the size of
+         * the modulus so we assume that the result has extra zeros on the
+         * left. This provides attackers with an oracle, but there's nothing
+         * that we can do about it here. */
+        LOG(WARNING) << "Reply len " << output.size() << " greater than expected " << len;
+        memcpy(out, &output.data()[output.size() - len], len);
+    } else if (output.size() < len) {
+        /* If the Keystore implementation returns a short value we assume that
+         * it's because it removed leading zeros from the left side. This is
+         * bad because it provides attackers with an oracle but we cannot do
+         * anything about a broken Keystore implementation here. */
+        LOG(WARNING) << "Reply len " << output.size() << " less than expected " << len;
+        memset(out, 0, len);
+        memcpy(out + len - output.size(), output.data(), output.size());
+    } else {
+        memcpy(out, output.data(), len);
+    }
+}
+
+/* key_backend_for_pkey returns the Keystore2KeyBackend attached to a key that
+ * was produced by EVP_PKEY_from_keystore2, or nullptr if |pkey| carries none.
+ * On success |algorithm| receives the keymint algorithm to sign with and, for
+ * EC keys, |max_sig_len| the largest possible ASN.1 signature size. */
+std::shared_ptr<Keystore2KeyBackend>*
+key_backend_for_pkey(const EVP_PKEY* pkey, KMV1::Algorithm* algorithm, size_t* max_sig_len) {
+    switch (EVP_PKEY_type(pkey->type)) {
+    case EVP_PKEY_RSA: {
+        const RSA* rsa = EVP_PKEY_get0_RSA(pkey);
+        *algorithm = KMV1::Algorithm::RSA;
+        return reinterpret_cast<std::shared_ptr<Keystore2KeyBackend>*>(
+            RSA_get_ex_data(rsa, Keystore2Engine::get().rsa_ex_index()));
+    }
+    case EVP_PKEY_EC: {
+        const EC_KEY* ec_key = EVP_PKEY_get0_EC_KEY(pkey);
+        *algorithm = KMV1::Algorithm::EC;
+        *max_sig_len = ECDSA_size(ec_key);
+        return reinterpret_cast<std::shared_ptr<Keystore2KeyBackend>*>(
+            EC_KEY_get_ex_data(ec_key, Keystore2Engine::get().ec_key_ex_index()));
+    }
+    default:
+        LOG(ERROR) << AT << "Unsupported key type " << EVP_PKEY_type(pkey->type);
+        return nullptr;
+    }
+}
+
 /* rsa_private_transform takes a big-endian integer from |in|, calculates the
  * d'th power of it, modulo the RSA modulus, and writes the result as a
  * big-endian integer to |out|. Both |in| and |out| are |len| bytes long. It
@@ -271,24 +468,7 @@ extern "C" int rsa_private_transform(RSA* rsa, uint8_t* out, const uint8_t* in,
         return 0;
     }
 
-    if (output->size() > len) {
-        /* The result of the RSA operation can never be larger than the size of
-         * the modulus so we assume that the result has extra zeros on the
-         * left. This provides attackers with an oracle, but there's nothing
-         * that we can do about it here. */
-        LOG(WARNING) << "Reply len " << output->size() << " greater than expected " << len;
-        memcpy(out, &output->data()[output->size() - len], len);
-    } else if (output->size() < len) {
-        /* If the Keystore implementation returns a short value we assume that
-         * it's because it removed leading zeros from the left side. This is
-         * bad because it provides attackers with an oracle but we cannot do
-         * anything about a broken Keystore implementation here. */
-        LOG(WARNING) << "Reply len " << output->size() << " less than expected " << len;
-        memset(out, 0, len);
-        memcpy(out + len - output->size(), output->data(), output->size());
-    } else {
-        memcpy(out, output->data(), len);
-    }
+    copy_rsa_output(out, len, *output);
 
     return 1;
 }
@@ -329,7 +509,35 @@ extern "C" int ecdsa_sign(const uint8_t* digest, size_t digest_len, uint8_t* sig
     return 1;
 }
 
+/* Parsed public keys by SHA-256 of the certificate bytes they came from. The
+ * cert bytes for a given alias rarely change, so repeated resolutions of the
+ * same certificate can skip the DER parse and SPKI extraction. Public keys
+ * are immutable and ref-counted, so cached ones can be shared freely. */
+struct PubKeyCacheEntry {
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    bssl::UniquePtr<EVP_PKEY> pub_key;
+    uint64_t last_use;
+};
+constexpr size_t kPubKeyCacheCapacity = 8;
+std::mutex pubKeyCacheMutex;
+std::vector<PubKeyCacheEntry> pubKeyCache;
+uint64_t pubKeyCacheUseCounter = 0;
+
 bssl::UniquePtr<EVP_PKEY> extractPubKey(const std::vector<uint8_t>& cert_bytes) {
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256(cert_bytes.data(), cert_bytes.size(), digest);
+
+    {
+        std::lock_guard<std::mutex> lock(pubKeyCacheMutex);
+        for (auto& entry : pubKeyCache) {
+            if (memcmp(entry.digest, digest, sizeof(digest)) == 0) {
+                entry.last_use = ++pubKeyCacheUseCounter;
+                EVP_PKEY_up_ref(entry.pub_key.get());
+                return bssl::UniquePtr<EVP_PKEY>(entry.pub_key.get());
+            }
+        }
+    }
+
     const uint8_t* p = cert_bytes.data();
     bssl::UniquePtr<X509> decoded_cert(d2i_X509(nullptr, &p, cert_bytes.size()));
     if (!decoded_cert) {
@@ -351,9 +559,114 @@ bssl::UniquePtr<EVP_PKEY> extractPubKey(const std::vector<uint8_t>& cert_bytes)
         LOG(ERROR) << AT << "Could not extract public key.";
         return {};
     }
+
+    {
+        std::lock_guard<std::mutex> lock(pubKeyCacheMutex);
+        if (pubKeyCache.size() >= kPubKeyCacheCapacity) {
+            pubKeyCache.erase(std::min_element(pubKeyCache.begin(), pubKeyCache.end(),
+                                               [](const PubKeyCacheEntry& a,
+                                                  const PubKeyCacheEntry& b) {
+                                                   return a.last_use < b.last_use;
+                                               }));
+        }
+        PubKeyCacheEntry entry;
+        memcpy(entry.digest, digest, sizeof(digest));
+        EVP_PKEY_up_ref(pub_key.get());
+        entry.pub_key.reset(pub_key.get());
+        entry.last_use = ++pubKeyCacheUseCounter;
+        pubKeyCache.push_back(std::move(entry));
+    }
+
     return pub_key;
 }
 
+/* EvpKeyCache is a small per-process cache of the EVP_PKEYs produced by
+ * EVP_PKEY_from_keystore2, keyed by the key_id string the caller passed in.
+ * Building such a key costs a keystore2 getKeyEntry round trip plus an X.509
+ * parse, and clients tend to re-resolve the same alias for every TLS context
+ * they set up. Entries are evicted in LRU order once kCapacity aliases are
+ * cached, and the whole cache is dropped if keystore2 dies, because the
+ * cached keys hold binder proxies into the dead process. */
+class EvpKeyCache {
+  public:
+    /* get returns a new reference to the cached key for |key_id|, or nullptr
+     * on a cache miss. */
+    EVP_PKEY* get(const std::string& key_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : entries_) {
+            if (entry.key_id == key_id) {
+                entry.last_use = ++use_counter_;
+                EVP_PKEY_up_ref(entry.pkey.get());
+                return entry.pkey.get();
+            }
+        }
+        return nullptr;
+    }
+
+    /* put stores an additional reference to |pkey| under |key_id| and makes
+     * sure a death recipient is watching the keystore2 service binder. */
+    void put(const std::string& key_id, EVP_PKEY* pkey, const ::ndk::SpAIBinder& keystore_binder) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!death_linked_) {
+            if (AIBinder_linkToDeath(keystore_binder.get(), death_recipient_.get(), this) !=
+                STATUS_OK) {
+                /* Without the death notification a cached entry could outlive
+                 * a keystore2 restart, so don't cache at all. */
+                LOG(WARNING) << AT << "Failed to link to keystore2 death. Not caching key.";
+                return;
+            }
+            death_linked_ = true;
+        }
+        for (auto& entry : entries_) {
+            if (entry.key_id == key_id) {
+                EVP_PKEY_up_ref(pkey);
+                entry.pkey.reset(pkey);
+                entry.last_use = ++use_counter_;
+                return;
+            }
+        }
+        if (entries_.size() >= kCapacity) {
+            entries_.erase(std::min_element(
+                entries_.begin(), entries_.end(),
+                [](const Entry& a, const Entry& b) { return a.last_use < b.last_use; }));
+        }
+        EVP_PKEY_up_ref(pkey);
+        entries_.push_back(Entry{key_id, bssl::UniquePtr<EVP_PKEY>(pkey), ++use_counter_});
+    }
+
+    static EvpKeyCache& getInstance() {
+        static EvpKeyCache cache;
+        return cache;
+    }
+
+  private:
+    EvpKeyCache()
+        : death_recipient_(AIBinder_DeathRecipient_new(
+              [](void* cookie) { reinterpret_cast<EvpKeyCache*>(cookie)->clear(); })) {}
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        /* The binder we linked to is gone; re-link to the new service
+         * instance when the next key gets cached. */
+        death_linked_ = false;
+    }
+
+    struct Entry {
+        std::string key_id;
+        bssl::UniquePtr<EVP_PKEY> pkey;
+        uint64_t last_use;
+    };
+
+    static constexpr size_t kCapacity = 8;
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    uint64_t use_counter_ = 0;
+    ::ndk::ScopedAIBinder_DeathRecipient death_recipient_;
+    bool death_linked_ = false;
+};
+
 }  // namespace
 
 /* EVP_PKEY_from_keystore returns an |EVP_PKEY| that contains either an RSA or
@@ -361,8 +674,11 @@ bssl::UniquePtr<EVP_PKEY> extractPubKey(const std::vector<uint8_t>& cert_bytes)
  * named |key_id| in Keystore and the private operations are forwarded onto
  * KeyStore. */
 extern "C" EVP_PKEY* EVP_PKEY_from_keystore2(const char* key_id) {
-    ::ndk::SpAIBinder keystoreBinder(AServiceManager_checkService(keystore2_service_name));
-    auto keystore2 = ks2::IKeystoreService::fromBinder(keystoreBinder);
+    if (EVP_PKEY* cached = EvpKeyCache::getInstance().get(key_id)) {
+        return cached;
+    }
+
+    auto keystore2 = getKeystoreService();
 
     if (!keystore2) {
         LOG(ERROR) << AT << "Unable to connect to Keystore 2.0.";
@@ -416,8 +732,24 @@ extern "C" EVP_PKEY* EVP_PKEY_from_keystore2(const char* key_id) {
         return nullptr;
     }
 
+    /* Cache the stable form of the key descriptor in the backend. keystore2
+     * resolves grant aliases and SELINUX aliases during getKeyEntry and, when
+     * the caller may also address the key directly, reports the resolved
+     * key-id domain descriptor in metadata.key. Storing that form means every
+     * per-signature createOperation addresses the key by its stable nspace/id
+     * and skips alias parsing and permission re-derivation inside keystore2.
+     * If the service reports any other form — e.g. the caller's access is only
+     * valid through the grant itself — keep the numeric descriptor resolved
+     * above, which is equally parse-free on the sign path. */
+    ks2::KeyDescriptor resolved_descriptor = descriptor;
+    if (response.metadata.key.domain == ks2::Domain::KEY_ID) {
+        resolved_descriptor = response.metadata.key;
+        resolved_descriptor.alias = std::nullopt;
+        resolved_descriptor.blob = std::nullopt;
+    }
+
     auto key_backend = std::make_shared<Keystore2KeyBackend>(
-        Keystore2KeyBackend{response.metadata.key, response.iSecurityLevel});
+        Keystore2KeyBackend{std::move(resolved_descriptor), response.iSecurityLevel});
 
     bssl::UniquePtr<EVP_PKEY> result;
     switch (EVP_PKEY_type(pkey->type)) {
@@ -436,5 +768,119 @@ extern "C" EVP_PKEY* EVP_PKEY_from_keystore2(const char* key_id) {
         return nullptr;
     }
 
+    if (result) {
+        EvpKeyCache::getInstance().put(key_id, result.get(), keystore2->asBinder());
+    }
+
     return result.release();
 }
+
+/* EVP_PKEY_keystore2_sign_batch signs |count| raw inputs with a key
+ * previously returned by |EVP_PKEY_from_keystore2|, keeping several keystore2
+ * operations in flight instead of performing one round trip per input.
+ * For RSA keys each input is a pre-padded big-endian integer and the result
+ * written to |out[i]| is exactly |in_lens[i]| bytes, as with the raw private
+ * transform. For EC keys each input is a message digest and |out[i]| must
+ * have room for ECDSA_size of the key; |out_lens[i]| receives the length of
+ * the ASN.1 encoded signature. Returns one if every input was signed and zero
+ * otherwise. */
+extern "C" __attribute__((visibility("default"))) int
+EVP_PKEY_keystore2_sign_batch(const EVP_PKEY* pkey, const uint8_t* const* in,
+                              const size_t* in_lens, uint8_t* const* out, size_t* out_lens,
+                              size_t count) {
+    if (count == 0) {
+        return 1;
+    }
+
+    KMV1::Algorithm algorithm;
+    size_t max_sig_len = 0;
+    auto key_backend = key_backend_for_pkey(pkey, &algorithm, &max_sig_len);
+    if (key_backend == nullptr) {
+        LOG(ERROR) << AT << "Invalid key.";
+        return 0;
+    }
+
+    std::vector<std::vector<uint8_t>> inputs;
+    inputs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        inputs.emplace_back(in[i], in[i] + in_lens[i]);
+    }
+
+    auto outputs = keystore2_sign_batch(**key_backend, std::move(inputs), algorithm);
+
+    int result = 1;
+    for (size_t i = 0; i < count; ++i) {
+        if (!outputs[i]) {
+            result = 0;
+            continue;
+        }
+        if (algorithm == KMV1::Algorithm::RSA) {
+            copy_rsa_output(out[i], in_lens[i], *outputs[i]);
+            out_lens[i] = in_lens[i];
+        } else {
+            if (outputs[i]->size() == 0 || outputs[i]->size() > max_sig_len) {
+                LOG(ERROR) << AT << "Invalid signature size " << outputs[i]->size();
+                result = 0;
+                continue;
+            }
+            memcpy(out[i], outputs[i]->data(), outputs[i]->size());
+            out_lens[i] = outputs[i]->size();
+        }
+    }
+
+    return result;
+}
+
+/* EVP_PKEY_keystore2_sign_async submits one sign request for a key previously
+ * returned by |EVP_PKEY_from_keystore2| and returns without waiting for the
+ * keystore2 round trip. The ENGINE method table used by the synchronous path
+ * has no completion hooks, so the asynchronous variant lives next to it as a
+ * direct entry point. |done| is invoked exactly once from an internal worker
+ * thread, with ok set to one and the signature bytes on success or ok set to
+ * zero on failure; the signature buffer is only valid for the duration of the
+ * callback. The key backend is retained for the duration of the operation, so
+ * the caller may free |pkey| while the sign is still in flight. Returns one
+ * if the request was submitted and zero otherwise. */
+extern "C" __attribute__((visibility("default"))) int
+EVP_PKEY_keystore2_sign_async(const EVP_PKEY* pkey, const uint8_t* in, size_t in_len,
+                              EVP_PKEY_keystore2_sign_cb done, void* arg) {
+    KMV1::Algorithm algorithm;
+    size_t max_sig_len = 0;
+    auto key_backend = key_backend_for_pkey(pkey, &algorithm, &max_sig_len);
+    if (key_backend == nullptr) {
+        LOG(ERROR) << AT << "Invalid key.";
+        return 0;
+    }
+
+    std::thread([backend = *key_backend, input = std::vector<uint8_t>(in, in + in_len), in_len,
+                 algorithm, max_sig_len, done, arg]() mutable {
+        auto output = keystore2_sign(*backend, std::move(input), algorithm);
+        if (!output) {
+            done(arg, 0, nullptr, 0);
+            return;
+        }
+        if (algorithm == KMV1::Algorithm::RSA) {
+            std::vector<uint8_t> normalized(in_len);
+            copy_rsa_output(normalized.data(), in_len, *output);
+            done(arg, 1, normalized.data(), normalized.size());
+            return;
+        }
+        if (output->size() == 0 || output->size() > max_sig_len) {
+            LOG(ERROR) << AT << "Invalid signature size " << output->size();
+            done(arg, 0, nullptr, 0);
+            return;
+        }
+        done(arg, 1, output->data(), output->size());
+    }).detach();
+
+    return 1;
+}
+
+/* keystore2_engine_dump_latency writes the per-phase latency histograms of
+ * the engine sign path to |fd| in a human readable form, for host daemons to
+ * include in their dump()/dumpsys output. */
+extern "C" __attribute__((visibility("default"))) void keystore2_engine_dump_latency(int fd) {
+    gServiceLookupLatency.dump(fd, "keystore2_engine service_lookup");
+    gCreateOperationLatency.dump(fd, "keystore2_engine createOperation");
+    gFinishLatency.dump(fd, "keystore2_engine finish");
+}
@@ -19,3 +19,36 @@
 #include <openssl/evp.h>
 
 extern "C" EVP_PKEY* EVP_PKEY_from_keystore2(const char* key_id);
+
+/* EVP_PKEY_keystore2_sign_batch signs |count| inputs with a key previously
+ * returned by EVP_PKEY_from_keystore2, pipelining the keystore2 operations
+ * instead of performing one blocking round trip per input. For RSA keys the
+ * inputs are pre-padded big-endian integers and each output is exactly
+ * |in_lens[i]| bytes; for EC keys the inputs are message digests and each
+ * |out[i]| must have room for ECDSA_size of the key. |out_lens[i]| receives
+ * the length written to |out[i]|. Returns one if every input was signed and
+ * zero otherwise. */
+extern "C" int EVP_PKEY_keystore2_sign_batch(const EVP_PKEY* pkey, const uint8_t* const* in,
+                                             const size_t* in_lens, uint8_t* const* out,
+                                             size_t* out_lens, size_t count);
+
+/* Completion callback for EVP_PKEY_keystore2_sign_async. |ok| is one on
+ * success and zero on failure. On success |sig| points to |sig_len| bytes of
+ * signature which are only valid for the duration of the call. */
+typedef void (*EVP_PKEY_keystore2_sign_cb)(void* arg, int ok, const uint8_t* sig, size_t sig_len);
+
+/* EVP_PKEY_keystore2_sign_async signs |in_len| bytes from |in| with a key
+ * previously returned by EVP_PKEY_from_keystore2 without blocking the calling
+ * thread for the keystore2 round trip. |done| is invoked exactly once from an
+ * internal worker thread; event loop integrations should signal themselves
+ * from the callback, e.g. by writing to an eventfd. The input follows the
+ * same conventions as EVP_PKEY_keystore2_sign_batch. Returns one if the
+ * request was submitted and zero otherwise. */
+extern "C" int EVP_PKEY_keystore2_sign_async(const EVP_PKEY* pkey, const uint8_t* in, size_t in_len,
+                                             EVP_PKEY_keystore2_sign_cb done, void* arg);
+
+/* keystore2_engine_dump_latency writes log2-bucketed microsecond histograms
+ * for each phase of the engine sign path (service lookup, createOperation,
+ * finish) to |fd| in a human readable form. Host daemons can call this from
+ * their dump() handler to make the counters visible via dumpsys. */
+extern "C" void keystore2_engine_dump_latency(int fd);
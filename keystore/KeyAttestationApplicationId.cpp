@@ -17,6 +17,8 @@
 
 #include "include/keystore/KeyAttestationApplicationId.h"
 
+#include <utility>
+
 #include <binder/Parcel.h>
 
 namespace android {
@@ -25,26 +27,44 @@ namespace keymaster {
 
 KeyAttestationApplicationId::KeyAttestationApplicationId() = default;
 
-KeyAttestationApplicationId::KeyAttestationApplicationId(
-    std::optional<KeyAttestationPackageInfo> package)
-    : packageInfos_(new std::vector<std::optional<KeyAttestationPackageInfo>>()) {
-    packageInfos_->push_back(std::move(package));
+KeyAttestationApplicationId::KeyAttestationApplicationId(KeyAttestationPackageInfo package) {
+    packageInfos_.push_back(std::move(package));
 }
 
 KeyAttestationApplicationId::KeyAttestationApplicationId(PackageInfoVector packages)
-    : packageInfos_(std::make_shared<PackageInfoVector>(std::move(packages))) {}
+    : packageInfos_(std::move(packages)) {}
 
 status_t KeyAttestationApplicationId::writeToParcel(Parcel* parcel) const {
-    return parcel->writeParcelableVector(packageInfos_);
+    // Written by hand in the format of a vector of nullable parcelables.
+    auto rc = parcel->writeInt32(static_cast<int32_t>(packageInfos_.size()));
+    if (rc != NO_ERROR) return rc;
+    for (const auto& info : packageInfos_) {
+        rc = parcel->writeInt32(1);  // non-null entry follows
+        if (rc != NO_ERROR) return rc;
+        rc = info.writeToParcel(parcel);
+        if (rc != NO_ERROR) return rc;
+    }
+    return NO_ERROR;
 }
 
 status_t KeyAttestationApplicationId::readFromParcel(const Parcel* parcel) {
-    std::optional<std::vector<std::optional<KeyAttestationPackageInfo>>> temp_vector;
-    auto rc = parcel->readParcelableVector(&temp_vector);
+    packageInfos_.clear();
+    int32_t count;
+    auto rc = parcel->readInt32(&count);
     if (rc != NO_ERROR) return rc;
-    packageInfos_.reset();
-    if (temp_vector) {
-        packageInfos_ = std::make_shared<PackageInfoVector>(std::move(*temp_vector));
+    if (count < 0) return NO_ERROR;  // null vector
+    // Each entry occupies at least one int32, so this bounds a hostile count.
+    if (static_cast<size_t>(count) > parcel->dataAvail()) return BAD_VALUE;
+    packageInfos_.reserve(static_cast<size_t>(count));
+    for (int32_t i = 0; i < count; ++i) {
+        int32_t present;
+        rc = parcel->readInt32(&present);
+        if (rc != NO_ERROR) return rc;
+        if (!present) continue;  // null entry, dropped
+        KeyAttestationPackageInfo info;
+        rc = info.readFromParcel(parcel);
+        if (rc != NO_ERROR) return rc;
+        packageInfos_.push_back(std::move(info));
     }
     return NO_ERROR;
 }
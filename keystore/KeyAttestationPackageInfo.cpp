@@ -28,14 +28,44 @@ KeyAttestationPackageInfo::KeyAttestationPackageInfo() = default;
 KeyAttestationPackageInfo::KeyAttestationPackageInfo(const String16& packageName,
                                                      int64_t versionCode,
                                                      SharedSignaturesVector signatures)
-    : packageName_(packageName), versionCode_(versionCode), signatures_(signatures) {}
+    : packageName_(packageName), versionCode_(versionCode) {
+    if (!signatures) return;
+    hasSignatures_ = true;
+    size_t total_size = 0;
+    for (const auto& signature : *signatures) {
+        if (signature) total_size += signature->data().size();
+    }
+    signatureArena_.reserve(total_size);
+    signatureOffsets_.reserve(signatures->size() + 1);
+    for (const auto& signature : *signatures) {
+        if (!signature) continue;
+        const auto& data = signature->data();
+        signatureArena_.insert(signatureArena_.end(), data.begin(), data.end());
+        signatureOffsets_.push_back(signatureArena_.size());
+    }
+}
 
 status_t KeyAttestationPackageInfo::writeToParcel(Parcel* parcel) const {
     auto rc = parcel->writeString16(packageName_);
     if (rc != NO_ERROR) return rc;
     rc = parcel->writeInt64(versionCode_);
     if (rc != NO_ERROR) return rc;
-    return parcel->writeParcelableVector(signatures_);
+
+    // Written by hand in the format of a nullable vector of nullable Signature
+    // parcelables, each of which holds a single byte vector.
+    if (!hasSignatures_) return parcel->writeInt32(-1);
+    rc = parcel->writeInt32(static_cast<int32_t>(signature_count()));
+    if (rc != NO_ERROR) return rc;
+    for (size_t i = 0; i < signature_count(); ++i) {
+        rc = parcel->writeInt32(1);  // non-null entry follows
+        if (rc != NO_ERROR) return rc;
+        const SignatureView signature = signature_at(i);
+        rc = parcel->writeInt32(static_cast<int32_t>(signature.size));
+        if (rc != NO_ERROR) return rc;
+        rc = parcel->write(signature.data, signature.size);
+        if (rc != NO_ERROR) return rc;
+    }
+    return NO_ERROR;
 }
 
 status_t KeyAttestationPackageInfo::readFromParcel(const Parcel* parcel) {
@@ -44,12 +74,36 @@ status_t KeyAttestationPackageInfo::readFromParcel(const Parcel* parcel) {
     rc = parcel->readInt64(&versionCode_);
     if (rc != NO_ERROR) return rc;
 
-    std::optional<SignaturesVector> temp_vector;
-    rc = parcel->readParcelableVector(&temp_vector);
+    signatureArena_.clear();
+    signatureOffsets_.assign(1, 0);
+    hasSignatures_ = false;
+
+    // The signature bytes are read straight into the shared arena rather than
+    // through one Signature parcelable (and byte vector allocation) per entry.
+    int32_t count;
+    rc = parcel->readInt32(&count);
     if (rc != NO_ERROR) return rc;
-    signatures_.reset();
-    if (temp_vector) {
-        signatures_ = std::make_shared<SignaturesVector>(std::move(*temp_vector));
+    if (count < 0) return NO_ERROR;  // null signatures vector
+    hasSignatures_ = true;
+    // Each entry occupies at least one int32, so this bounds a hostile count
+    // before it sizes the reservation below.
+    if (static_cast<size_t>(count) > parcel->dataAvail()) return BAD_VALUE;
+    signatureOffsets_.reserve(static_cast<size_t>(count) + 1);
+    for (int32_t i = 0; i < count; ++i) {
+        int32_t present;
+        rc = parcel->readInt32(&present);
+        if (rc != NO_ERROR) return rc;
+        if (!present) continue;  // null entry, dropped
+        int32_t size;
+        rc = parcel->readInt32(&size);
+        if (rc != NO_ERROR) return rc;
+        if (size < 0) continue;  // null byte vector, dropped
+        if (static_cast<size_t>(size) > parcel->dataAvail()) return BAD_VALUE;
+        const size_t offset = signatureArena_.size();
+        signatureArena_.resize(offset + static_cast<size_t>(size));
+        rc = parcel->read(signatureArena_.data() + offset, static_cast<size_t>(size));
+        if (rc != NO_ERROR) return rc;
+        signatureOffsets_.push_back(signatureArena_.size());
     }
     return NO_ERROR;
 }
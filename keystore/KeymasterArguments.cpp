@@ -0,0 +1,205 @@
+/*
+**
+** Copyright 2017, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include "include/keystore/KeymasterArguments.h"
+
+#include <binder/Parcel.h>
+
+namespace android {
+namespace security {
+namespace keymaster {
+
+using ::keystore::KeyParameter;
+using ::keystore::Tag;
+using ::keystore::TagType;
+
+namespace {
+
+// The tag type lives in the top nibble of the tag value.
+TagType tagType(Tag tag) {
+    return static_cast<TagType>(static_cast<uint32_t>(tag) & 0xF0000000);
+}
+
+}  // namespace
+
+KeymasterArguments::KeymasterArguments(hardware::hidl_vec<KeyParameter>&& other) {
+    for (const auto& param : other) {
+        push(param);
+    }
+}
+
+KeymasterArguments::KeymasterArguments(const hardware::hidl_vec<KeyParameter>& other) {
+    for (const auto& param : other) {
+        push(param);
+    }
+}
+
+void KeymasterArguments::push(const KeyParameter& param) {
+    Param flat{param.tag, 0, -1, static_cast<uint32_t>(arena_.size())};
+    switch (tagType(param.tag)) {
+    case TagType::ENUM:
+    case TagType::ENUM_REP:
+    case TagType::UINT:
+    case TagType::UINT_REP:
+        flat.value = param.f.integer;
+        break;
+    case TagType::ULONG:
+    case TagType::ULONG_REP:
+        flat.value = param.f.longInteger;
+        break;
+    case TagType::DATE:
+        flat.value = param.f.dateTime;
+        break;
+    case TagType::BOOL:
+        flat.value = param.f.boolValue;
+        break;
+    case TagType::BIGNUM:
+    case TagType::BYTES:
+        flat.blob_size = static_cast<int32_t>(param.blob.size());
+        arena_.insert(arena_.end(), param.blob.begin(), param.blob.end());
+        break;
+    default:
+        break;
+    }
+    if (count_ < kInlineCapacity) {
+        inline_table_[count_] = flat;
+    } else {
+        overflow_table_.push_back(flat);
+    }
+    ++count_;
+}
+
+void KeymasterArguments::clear() {
+    overflow_table_.clear();
+    count_ = 0;
+    arena_.clear();
+}
+
+hardware::hidl_vec<KeyParameter> KeymasterArguments::getParameters() const {
+    hardware::hidl_vec<KeyParameter> result;
+    result.resize(count_);
+    for (size_t i = 0; i < count_; ++i) {
+        const Param& flat = at(i);
+        auto& param = result[i];
+        param.tag = flat.tag;
+        switch (tagType(flat.tag)) {
+        case TagType::ENUM:
+        case TagType::ENUM_REP:
+        case TagType::UINT:
+        case TagType::UINT_REP:
+            param.f.integer = static_cast<uint32_t>(flat.value);
+            break;
+        case TagType::ULONG:
+        case TagType::ULONG_REP:
+            param.f.longInteger = flat.value;
+            break;
+        case TagType::DATE:
+            param.f.dateTime = flat.value;
+            break;
+        case TagType::BOOL:
+            param.f.boolValue = flat.value != 0;
+            break;
+        case TagType::BIGNUM:
+        case TagType::BYTES:
+            // Borrow the arena bytes; no per-blob allocation or copy.
+            param.blob.setToExternal(const_cast<uint8_t*>(arena_.data()) + flat.blob_offset,
+                                     flat.blob_size);
+            break;
+        default:
+            break;
+        }
+    }
+    return result;
+}
+
+status_t KeymasterArguments::writeToParcel(Parcel* out) const {
+    auto rc = out->writeInt32(static_cast<int32_t>(count_));
+    if (rc != NO_ERROR) return rc;
+    for (size_t i = 0; i < count_; ++i) {
+        const Param& flat = at(i);
+        rc = out->writeInt32(static_cast<int32_t>(flat.tag));
+        if (rc != NO_ERROR) return rc;
+        rc = out->writeInt64(static_cast<int64_t>(flat.value));
+        if (rc != NO_ERROR) return rc;
+        rc = out->writeInt32(flat.blob_size);
+        if (rc != NO_ERROR) return rc;
+    }
+    // All blob values travel as one block; slice boundaries are implied by
+    // the per-parameter sizes above.
+    rc = out->writeInt32(static_cast<int32_t>(arena_.size()));
+    if (rc != NO_ERROR) return rc;
+    return out->write(arena_.data(), arena_.size());
+}
+
+status_t KeymasterArguments::readFromParcel(const Parcel* in) {
+    clear();
+
+    int32_t count;
+    auto rc = in->readInt32(&count);
+    if (rc != NO_ERROR) return rc;
+    // Each entry occupies at least four words, so this bounds a hostile count.
+    if (count < 0 || static_cast<size_t>(count) > in->dataAvail()) return BAD_VALUE;
+
+    overflow_table_.reserve(count > static_cast<int32_t>(kInlineCapacity)
+                                ? count - kInlineCapacity
+                                : 0);
+    // Accumulated in 64 bits and checked against the remaining parcel bytes
+    // after every entry: the arena bytes still have to come out of this
+    // parcel, so no blob (and no running total) may exceed dataAvail(), and a
+    // hostile parcel cannot wrap the total back into range to smuggle
+    // gigabyte-sized blob_size/blob_offset values past the arena_size check
+    // below.
+    uint64_t arena_used = 0;
+    for (int32_t i = 0; i < count; ++i) {
+        int32_t tag;
+        int64_t value;
+        int32_t blob_size;
+        rc = in->readInt32(&tag);
+        if (rc != NO_ERROR) return rc;
+        rc = in->readInt64(&value);
+        if (rc != NO_ERROR) return rc;
+        rc = in->readInt32(&blob_size);
+        if (rc != NO_ERROR) return rc;
+        if (blob_size > 0 && static_cast<size_t>(blob_size) > in->dataAvail()) return BAD_VALUE;
+        Param flat{static_cast<Tag>(tag), static_cast<uint64_t>(value), blob_size,
+                   static_cast<uint32_t>(arena_used)};
+        if (blob_size > 0) {
+            arena_used += static_cast<uint64_t>(blob_size);
+            if (arena_used > in->dataAvail()) return BAD_VALUE;
+        }
+        if (count_ < kInlineCapacity) {
+            inline_table_[count_] = flat;
+        } else {
+            overflow_table_.push_back(flat);
+        }
+        ++count_;
+    }
+
+    int32_t arena_size;
+    rc = in->readInt32(&arena_size);
+    if (rc != NO_ERROR) return rc;
+    if (arena_size < 0 || static_cast<uint64_t>(arena_size) != arena_used ||
+        static_cast<size_t>(arena_size) > in->dataAvail()) {
+        return BAD_VALUE;
+    }
+    arena_.resize(static_cast<size_t>(arena_size));
+    return in->read(arena_.data(), arena_.size());
+}
+
+}  // namespace keymaster
+}  // namespace security
+}  // namespace android
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KEYSTORE_CONFIRMATIONUI_RATE_LIMITING_H_
+#define KEYSTORE_CONFIRMATIONUI_RATE_LIMITING_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+#include <android/hardware/confirmationui/1.0/types.h>
+
+namespace keystore {
+
+using ConfirmationResponseCode = android::hardware::confirmationui::V1_0::ResponseCode;
+
+/**
+ * RateLimiting throttles confirmation prompts per requesting uid. Each uid
+ * gets a single counter and the time of its most recent attempt — constant
+ * memory per uid and constant work per decision. No per-prompt history is
+ * kept, and the decision path never scans the table.
+ *
+ * Policy: the first kFreeTries cancelled prompts are free. The next
+ * kFlatTries cancellations earn a flat kFlatPenalty wait. After that the
+ * penalty starts at kBasePenalty and doubles with every further
+ * cancellation, capped at kForgetAfter. A slot whose last attempt lies more
+ * than kForgetAfter in the past is forgotten entirely. A confirmed prompt
+ * clears the slot; a prompt that fails for reasons outside the caller's
+ * control (abort, system error) refunds the attempt so the accrued wait is
+ * not consumed.
+ */
+template <typename Clock = std::chrono::steady_clock> class RateLimiting {
+  private:
+    struct Slot {
+        typename Clock::time_point last_attempt;
+        typename Clock::time_point prev_attempt;
+        uint32_t count = 0;
+    };
+
+    std::unordered_map<uid_t, Slot> slots_;
+    uid_t latest_requester_ = 0;
+
+    static constexpr uint32_t kFreeTries = 3;
+    static constexpr uint32_t kFlatTries = 3;
+    // kBasePenalty << kMaxDoublings exceeds kForgetAfter, so further doubling
+    // is moot (and would eventually overflow).
+    static constexpr uint32_t kMaxDoublings = 11;
+    static constexpr std::chrono::seconds kFlatPenalty{30};
+    static constexpr std::chrono::seconds kBasePenalty{60};
+    static constexpr std::chrono::hours kForgetAfter{24};
+
+    static typename Clock::duration penalty(uint32_t count) {
+        if (count < kFreeTries) return typename Clock::duration(0);
+        if (count < kFreeTries + kFlatTries) return kFlatPenalty;
+        uint32_t doublings = count - (kFreeTries + kFlatTries);
+        if (doublings >= kMaxDoublings) return kForgetAfter;
+        return std::min<typename Clock::duration>(kBasePenalty * (int64_t(1) << doublings),
+                                                  kForgetAfter);
+    }
+
+    // Constant-work garbage collection: each decision inspects one arbitrary
+    // slot and drops it if its penalty has been forgotten, so stale slots get
+    // retired over time without ever sweeping the table.
+    void collectGarbage(typename Clock::time_point now) {
+        if (slots_.empty()) return;
+        auto iter = slots_.begin();
+        if (now >= iter->second.last_attempt &&
+            now - iter->second.last_attempt >= kForgetAfter) {
+            slots_.erase(iter);
+        }
+    }
+
+  public:
+    // Returns true if uid `id` may prompt now, charging the attempt to its
+    // slot. O(1): one hash lookup, no history walk.
+    bool tryPrompt(uid_t id) {
+        auto now = Clock::now();
+        collectGarbage(now);
+
+        auto iter = slots_.find(id);
+        if (iter == slots_.end()) {
+            auto& slot = slots_[id];
+            slot.last_attempt = slot.prev_attempt = now;
+            latest_requester_ = id;
+            return true;
+        }
+
+        auto& slot = iter->second;
+        // A clock that jumped backwards must not shorten the wait.
+        if (now < slot.last_attempt) return false;
+        if (now - slot.last_attempt >= kForgetAfter) {
+            slot.count = 0;
+        } else if (now - slot.last_attempt < penalty(slot.count)) {
+            return false;
+        }
+        slot.prev_attempt = slot.last_attempt;
+        slot.last_attempt = now;
+        latest_requester_ = id;
+        return true;
+    }
+
+    // Updates the slot of the most recent successful tryPrompt caller
+    // according to the prompt's outcome.
+    void processResult(ConfirmationResponseCode rc) {
+        switch (rc) {
+        case ConfirmationResponseCode::OK:
+            // Confirmed prompts are not counted against the uid.
+            slots_.erase(latest_requester_);
+            break;
+        case ConfirmationResponseCode::Canceled:
+            // The user actively declined; this is what the penalty counts.
+            ++slots_[latest_requester_].count;
+            break;
+        default: {
+            // The prompt failed for reasons outside the caller's control;
+            // refund the attempt so the accrued wait is not consumed.
+            auto iter = slots_.find(latest_requester_);
+            if (iter != slots_.end()) iter->second.last_attempt = iter->second.prev_attempt;
+            break;
+        }
+        }
+    }
+
+    size_t usedSlots() const { return slots_.size(); }
+};
+
+}  // namespace keystore
+
+#endif  // KEYSTORE_CONFIRMATIONUI_RATE_LIMITING_H_
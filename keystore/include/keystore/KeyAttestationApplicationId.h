@@ -15,8 +15,6 @@
 #ifndef KEYSTORE_INCLUDE_KEYSTORE_KEYATTESTATIONAPPLICATIONID_H_
 #define KEYSTORE_INCLUDE_KEYSTORE_KEYATTESTATIONAPPLICATIONID_H_
 
-#include <memory>
-#include <optional>
 #include <vector>
 
 #include <binder/Parcelable.h>
@@ -29,26 +27,23 @@ namespace keymaster {
 
 class KeyAttestationApplicationId : public Parcelable {
   public:
-    typedef SharedNullableIterator<const KeyAttestationPackageInfo, std::vector>
-        ConstKeyAttestationPackageInfoIterator;
-    typedef std::vector<std::optional<KeyAttestationPackageInfo>> PackageInfoVector;
+    // Package infos are stored flat and by value; readFromParcel moves each
+    // unparceled entry in, so no per-package shared_ptr indirection remains.
+    typedef std::vector<KeyAttestationPackageInfo> PackageInfoVector;
+    typedef PackageInfoVector::const_iterator ConstKeyAttestationPackageInfoIterator;
     KeyAttestationApplicationId();
     // Following c'tors are for initializing instances containing test data.
-    explicit KeyAttestationApplicationId(std::optional<KeyAttestationPackageInfo> package);
+    explicit KeyAttestationApplicationId(KeyAttestationPackageInfo package);
     explicit KeyAttestationApplicationId(PackageInfoVector packages);
 
     status_t writeToParcel(Parcel*) const override;
     status_t readFromParcel(const Parcel* parcel) override;
 
-    ConstKeyAttestationPackageInfoIterator pinfos_begin() const {
-        return ConstKeyAttestationPackageInfoIterator(packageInfos_);
-    }
-    ConstKeyAttestationPackageInfoIterator pinfos_end() const {
-        return ConstKeyAttestationPackageInfoIterator();
-    }
+    ConstKeyAttestationPackageInfoIterator pinfos_begin() const { return packageInfos_.begin(); }
+    ConstKeyAttestationPackageInfoIterator pinfos_end() const { return packageInfos_.end(); }
 
   private:
-    std::shared_ptr<PackageInfoVector> packageInfos_;
+    PackageInfoVector packageInfos_;
 };
 
 }  // namespace keymaster
@@ -24,7 +24,6 @@
 #include <binder/Parcelable.h>
 
 #include "Signature.h"
-#include "utils.h"
 
 namespace android {
 namespace security {
@@ -32,11 +31,17 @@ namespace keymaster {
 
 class KeyAttestationPackageInfo : public Parcelable {
   public:
-    typedef SharedNullableIterator<const content::pm::Signature, std::vector>
-        ConstSignatureIterator;
     typedef std::vector<std::optional<content::pm::Signature>> SignaturesVector;
     typedef std::shared_ptr<SignaturesVector> SharedSignaturesVector;
 
+    // Non-owning view of one signature's bytes inside the shared arena. Only
+    // valid as long as the owning KeyAttestationPackageInfo is alive and
+    // unmodified.
+    struct SignatureView {
+        const uint8_t* data;
+        size_t size;
+    };
+
     KeyAttestationPackageInfo(const String16& packageName, int64_t versionCode,
                               SharedSignaturesVector signatures);
     KeyAttestationPackageInfo();
@@ -47,13 +52,25 @@ class KeyAttestationPackageInfo : public Parcelable {
     const std::optional<String16>& package_name() const { return packageName_; }
     int64_t version_code() const { return versionCode_; }
 
-    ConstSignatureIterator sigs_begin() const { return ConstSignatureIterator(signatures_); }
-    ConstSignatureIterator sigs_end() const { return ConstSignatureIterator(); }
+    size_t signature_count() const { return signatureOffsets_.size() - 1; }
+    SignatureView signature_at(size_t index) const {
+        return {signatureArena_.data() + signatureOffsets_[index],
+                signatureOffsets_[index + 1] - signatureOffsets_[index]};
+    }
 
   private:
     std::optional<String16> packageName_;
     int64_t versionCode_;
-    SharedSignaturesVector signatures_;
+    // All signatures are stored back to back in a single arena so that
+    // unparceling a provider response costs one allocation for a package's
+    // signature bytes instead of one Signature parcelable per entry.
+    // signatureOffsets_ holds the start of each signature plus a trailing end
+    // offset; the wire format of the nested Signature parcelables is
+    // unchanged. Null entries are dropped on read, matching the old nullable
+    // iterator which skipped them.
+    std::vector<uint8_t> signatureArena_;
+    std::vector<size_t> signatureOffsets_{0};
+    bool hasSignatures_ = false;
 };
 
 }  // namespace keymaster
@@ -23,7 +23,14 @@ namespace android {
 namespace security {
 namespace keymaster {
 
-// struct for serializing/deserializing a list of KeyParameters
+// Flat container for serializing/deserializing a list of KeyParameters.
+//
+// Parameters are kept as a compact table of (tag, value, blob slice) records
+// with all blob bytes in one shared arena, rather than as a vector of hidl
+// KeyParameters where every blob-bearing entry owns its own heap buffer. The
+// table lives inline for the typical 10-30 parameter operation and only
+// spills to the heap beyond that, and parceling transfers the table and the
+// arena as single blocks.
 struct KeymasterArguments : public Parcelable {
     KeymasterArguments(){};
     // NOLINTNEXTLINE(google-explicit-constructor)
@@ -33,12 +40,39 @@ struct KeymasterArguments : public Parcelable {
     status_t readFromParcel(const Parcel* in) override;
     status_t writeToParcel(Parcel* out) const override;
 
-    const inline hardware::hidl_vec<::keystore::KeyParameter>& getParameters() const {
-        return data_;
-    }
+    size_t size() const { return count_; }
+
+    // Materializes the parameters as hidl KeyParameters. Blob values borrow
+    // the internal arena via setToExternal, so the result is only valid while
+    // this object is alive and unmodified.
+    hardware::hidl_vec<::keystore::KeyParameter> getParameters() const;
 
   private:
-    hardware::hidl_vec<::keystore::KeyParameter> data_;
+    struct Param {
+        ::keystore::Tag tag;
+        uint64_t value;     // holds the enum/uint/ulong/date/bool payload
+        int32_t blob_size;  // -1 when the tag does not carry a blob
+        uint32_t blob_offset;
+    };
+
+    // Inline capacity covering the common parameter count.
+    static constexpr size_t kInlineCapacity = 32;
+
+    void push(const ::keystore::KeyParameter& param);
+    void clear();
+    Param& at(size_t index) {
+        return index < kInlineCapacity ? inline_table_[index]
+                                       : overflow_table_[index - kInlineCapacity];
+    }
+    const Param& at(size_t index) const {
+        return index < kInlineCapacity ? inline_table_[index]
+                                       : overflow_table_[index - kInlineCapacity];
+    }
+
+    Param inline_table_[kInlineCapacity];
+    std::vector<Param> overflow_table_;
+    size_t count_ = 0;
+    std::vector<uint8_t> arena_;
 };
 
 }  // namespace keymaster
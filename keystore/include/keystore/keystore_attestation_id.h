@@ -18,6 +18,7 @@
 #define KEYSTORE_KEYSTORE_ATTESTATION_ID_H_
 
 #include <utils/Errors.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -71,6 +72,22 @@ template <typename T> class StatusOr {
  */
 StatusOr<std::vector<uint8_t>> gather_attestation_application_id(uid_t uid);
 
+/**
+ * Like gather_attestation_application_id, but returns a reference counted handle to the
+ * encoded attestation application id. On a cache hit the returned handle shares the cached
+ * bytes, so callers that only need to read the encoding avoid copying it.
+ */
+StatusOr<std::shared_ptr<const std::vector<uint8_t>>>
+gather_attestation_application_id_shared(uid_t uid);
+
+/**
+ * Drops the cached attestation application id for the given uid. Must be called when the
+ * platform reports a package change for the uid (install, update or removal), so the next
+ * attestation re-queries the package manager. A short TTL on the cache acts as a backstop
+ * for changes that are not reported.
+ */
+void invalidate_attestation_application_id_cache(uid_t uid);
+
 /**
  * Generates a DER-encoded vector containing information from KeyAttestationApplicationId.
  * The size of the returned vector will not exceed KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE.
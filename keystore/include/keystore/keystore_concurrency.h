@@ -18,6 +18,9 @@
 #ifndef KEYSTORE_INCLUDE_KEYSTORE_KEYSTORE_CONCURRENCY_H_
 #define KEYSTORE_INCLUDE_KEYSTORE_KEYSTORE_CONCURRENCY_H_
 
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
 #include <type_traits>
 
 namespace keystore {
@@ -109,6 +112,23 @@ template <typename Implementation> class ProxyLock {
     }
 };
 
+/*
+ * Reader/writer variants of the proxy pattern above, backed by a
+ * std::shared_mutex. An ExclusiveLockedProxy holds the mutex exclusively and
+ * exposes mutable access; a SharedLockedProxy holds it shared and exposes
+ * const access only, so any number of read-mostly consumers can inspect the
+ * same object concurrently while writers still serialize. The same
+ * use-and-discard rules apply: holding a proxy beyond the immediate use or
+ * acquiring a second one on the same mutex from the same thread deadlocks.
+ */
+template <typename LockedType>
+using ExclusiveLockedProxy =
+    ProxyLock<MutexProxyLockHelper<LockedType, std::shared_mutex, std::unique_lock>>;
+
+template <typename LockedType>
+using SharedLockedProxy =
+    ProxyLock<MutexProxyLockHelper<const LockedType, std::shared_mutex, std::shared_lock>>;
+
 }  // namespace keystore
 
 #endif  // KEYSTORE_INCLUDE_KEYSTORE_KEYSTORE_CONCURRENCY_H_
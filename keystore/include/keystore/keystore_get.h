@@ -32,6 +32,33 @@ extern "C" {
  */
 ssize_t keystore_get(const char* key, size_t length, uint8_t** value);
 
+/* Completion callback for keystore_get_async. On success `length` is the size
+ * of the value and `value` was allocated with malloc(); the callee is
+ * responsible for calling free() on it. On failure `length` is -1 and `value`
+ * is NULL. */
+typedef void (*keystore_get_cb)(void* arg, ssize_t length, uint8_t* value);
+
+/* Opaque handle to an in-flight keystore_get_async request. */
+typedef struct keystore_get_request keystore_get_request;
+
+/* Asynchronous variant of keystore_get for event-loop users that must not
+ * block on a slow keystore. The lookup runs on an internal worker thread over
+ * a shared cached service connection and the callback is invoked at most once.
+ * Returns a cancellation handle, or NULL on invalid arguments.
+ *
+ * The caller must pass the handle to keystore_get_cancel() exactly once,
+ * whether or not the callback has already run.
+ */
+keystore_get_request* keystore_get_async(const char* key, size_t length, keystore_get_cb cb,
+                                         void* arg);
+
+/* Cancels `request` if its callback has not been delivered yet and releases
+ * the handle. Once this returns the callback will not be invoked; if the
+ * callback is running on the worker thread this call blocks until it
+ * completes, so it must not be called from inside the callback itself.
+ */
+void keystore_get_cancel(keystore_get_request* request);
+
 #ifdef __cplusplus
 }
 #endif
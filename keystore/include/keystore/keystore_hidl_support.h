@@ -21,6 +21,8 @@
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <android/hardware/keymaster/3.0/IKeymasterDevice.h>
@@ -145,6 +147,44 @@ inline std::string hidlVec2String(const hidl_vec<uint8_t>& value) {
     return std::string(reinterpret_cast<const std::string::value_type*>(&value[0]), value.size());
 }
 
+/**
+ * HidlBuf is a non-owning hidl_vec<uint8_t> view over a caller-owned buffer,
+ * built on hidl_vec::setToExternal: constructing one neither copies nor takes
+ * ownership of the bytes. The type encodes the lifetime contract — a HidlBuf
+ * must not outlive (or observe modification of) its source, so it is only
+ * suitable as an argument to strictly synchronous HIDL calls that consume the
+ * data before returning. Copying a HidlBuf into a plain hidl_vec makes an
+ * owned deep copy, as hidl_vec's copy semantics always do.
+ */
+class HidlBuf : public hidl_vec<uint8_t> {
+  public:
+    HidlBuf() = default;
+    HidlBuf(const uint8_t* data, size_t size) {
+        setToExternal(const_cast<uint8_t*>(data), size, false /* shouldOwn */);
+    }
+    explicit HidlBuf(const std::vector<uint8_t>& value) : HidlBuf(value.data(), value.size()) {}
+    explicit HidlBuf(const std::string& value)
+        : HidlBuf(reinterpret_cast<const uint8_t*>(value.data()), value.size()) {}
+};
+
+/**
+ * Borrowing counterparts of blob2hidlVec/hidlVec2String for synchronous call
+ * sites where the source outlives the call: no byte payload is copied. See
+ * HidlBuf for the lifetime contract of the returned view.
+ */
+inline HidlBuf blob2hidlVecBorrowed(const std::string& value) {
+    return HidlBuf(value);
+}
+
+inline HidlBuf blob2hidlVecBorrowed(const std::vector<uint8_t>& value) {
+    return HidlBuf(value);
+}
+
+inline std::string_view hidlVec2StringView(const hidl_vec<uint8_t>& value) {
+    return std::string_view(reinterpret_cast<const std::string_view::value_type*>(value.data()),
+                            value.size());
+}
+
 }  // namespace keystore
 
 #endif  // KEYSTORE_KEYSTORE_HIDL_SUPPORT_H_
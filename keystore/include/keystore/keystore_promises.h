@@ -24,6 +24,8 @@
 #include <android/security/keystore/BnKeystoreOperationResultCallback.h>
 #include <android/security/keystore/BnKeystoreResponseCallback.h>
 #include <future>
+#include <tuple>
+#include <vector>
 
 namespace keystore {
 
@@ -67,6 +69,61 @@ using KeyCertChainPromise =
                     std::tuple<::android::security::keystore::KeystoreResponse,
                                ::android::security::keymaster::KeymasterCertificateChain>>;
 
+/*
+ * Minimal continuation support over the promise types above. The asynchrony
+ * comes from the binder calls themselves: once a call carrying a
+ * CallbackPromise has been issued it is in flight regardless of what the
+ * caller does with the future. These combinators therefore use deferred
+ * execution — the continuation runs on the thread that eventually calls
+ * get()/wait() — which is enough to express "issue N requests, join once"
+ * without spawning threads of our own.
+ */
+
+/**
+ * Returns a future that, when waited on, waits for \p future and feeds its
+ * result through \p continuation. Chains of then() collapse into a single
+ * wait at the end.
+ */
+template <typename T, typename F>
+auto then(std::future<T>&& future, F&& continuation)
+    -> std::future<decltype(continuation(std::declval<T>()))> {
+    return std::async(std::launch::deferred,
+                      [future = std::move(future),
+                       continuation = std::forward<F>(continuation)]() mutable {
+                          return continuation(future.get());
+                      });
+}
+
+/**
+ * Joins a homogeneous batch of in-flight requests: the returned future
+ * yields all results, in the order the futures were given, once every one
+ * has completed.
+ */
+template <typename T> std::future<std::vector<T>> whenAll(std::vector<std::future<T>>&& futures) {
+    return std::async(std::launch::deferred, [futures = std::move(futures)]() mutable {
+        std::vector<T> results;
+        results.reserve(futures.size());
+        for (auto& future : futures) {
+            results.push_back(future.get());
+        }
+        return results;
+    });
+}
+
+/**
+ * Joins a fixed set of differently-typed in-flight requests into one future
+ * of the result tuple.
+ */
+template <typename... Results>
+std::future<std::tuple<Results...>> whenAll(std::future<Results>&&... futures) {
+    return std::async(std::launch::deferred,
+                      [futures = std::make_tuple(std::move(futures)...)]() mutable {
+                          return std::apply(
+                              [](auto&... future) { return std::tuple<Results...>{future.get()...}; },
+                              futures);
+                      });
+}
+
 }  // namespace keystore
 
 #endif  // KEYSTORE_INCLUDE_KEYSTORE_KEYSTORE_PROMISES_H_
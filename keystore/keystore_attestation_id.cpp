@@ -20,7 +20,12 @@
 
 #include <log/log.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -39,8 +44,6 @@
 
 #include <private/android_filesystem_config.h> /* for AID_SYSTEM */
 
-#include <openssl/asn1t.h>
-#include <openssl/bn.h>
 #include <openssl/sha.h>
 
 #include <utils/String8.h>
@@ -52,12 +55,6 @@ namespace {
 constexpr const char* kAttestationSystemPackageName = "AndroidSystem";
 constexpr const char* kUnknownPackageName = "UnknownPackage";
 
-std::vector<uint8_t> signature2SHA256(const content::pm::Signature& sig) {
-    std::vector<uint8_t> digest_buffer(SHA256_DIGEST_LENGTH);
-    SHA256(sig.data().data(), sig.data().size(), digest_buffer.data());
-    return digest_buffer;
-}
-
 using ::android::security::keymaster::BpKeyAttestationApplicationIdProvider;
 
 class KeyAttestationApplicationIdProvider : public BpKeyAttestationApplicationIdProvider {
@@ -79,33 +76,30 @@ KeyAttestationApplicationIdProvider::KeyAttestationApplicationIdProvider()
     : BpKeyAttestationApplicationIdProvider(
           android::defaultServiceManager()->getService(String16("sec_key_att_app_id_provider"))) {}
 
-DECLARE_STACK_OF(ASN1_OCTET_STRING);
+/* The attestation application id is DER encoded directly; the structure is
+ * small and fixed:
+ *
+ *   AttestationApplicationId ::= SEQUENCE {
+ *       packageInfos      SET OF SEQUENCE {
+ *           packageName   OCTET STRING,
+ *           version       INTEGER },
+ *       signatureDigests  SET OF OCTET STRING }
+ */
 
-typedef struct km_attestation_package_info {
-    ASN1_OCTET_STRING* package_name;
-    ASN1_INTEGER* version;
-} KM_ATTESTATION_PACKAGE_INFO;
+constexpr uint8_t kAsn1TagInteger = 0x02;
+constexpr uint8_t kAsn1TagOctetString = 0x04;
+constexpr uint8_t kAsn1TagSequence = 0x30;
+constexpr uint8_t kAsn1TagSet = 0x31;
 
 // Estimated size:
 // 4 bytes for the package name + package_name length
 // 11 bytes for the version (2 bytes header and up to 9 bytes of data).
 constexpr size_t AAID_PKG_INFO_OVERHEAD = 15;
-ASN1_SEQUENCE(KM_ATTESTATION_PACKAGE_INFO) = {
-    ASN1_SIMPLE(KM_ATTESTATION_PACKAGE_INFO, package_name, ASN1_OCTET_STRING),
-    ASN1_SIMPLE(KM_ATTESTATION_PACKAGE_INFO, version, ASN1_INTEGER),
-} ASN1_SEQUENCE_END(KM_ATTESTATION_PACKAGE_INFO);
-IMPLEMENT_ASN1_FUNCTIONS(KM_ATTESTATION_PACKAGE_INFO);
-
-DECLARE_STACK_OF(KM_ATTESTATION_PACKAGE_INFO);
 
 // Estimated size:
 // See estimate above for the stack of package infos.
 // 34 (32 + 2) bytes for each signature digest.
 constexpr size_t AAID_SIGNATURE_SIZE = 34;
-typedef struct km_attestation_application_id {
-    STACK_OF(KM_ATTESTATION_PACKAGE_INFO) * package_infos;
-    STACK_OF(ASN1_OCTET_STRING) * signature_digests;
-} KM_ATTESTATION_APPLICATION_ID;
 
 // Estimated overhead:
 // 4 for the header of the octet string containing the fully-encoded data.
@@ -113,98 +107,119 @@ typedef struct km_attestation_application_id {
 // 4 for the header of the package info set.
 // 4 for the header of the signature set.
 constexpr size_t AAID_GENERAL_OVERHEAD = 16;
-ASN1_SEQUENCE(KM_ATTESTATION_APPLICATION_ID) = {
-    ASN1_SET_OF(KM_ATTESTATION_APPLICATION_ID, package_infos, KM_ATTESTATION_PACKAGE_INFO),
-    ASN1_SET_OF(KM_ATTESTATION_APPLICATION_ID, signature_digests, ASN1_OCTET_STRING),
-} ASN1_SEQUENCE_END(KM_ATTESTATION_APPLICATION_ID);
-IMPLEMENT_ASN1_FUNCTIONS(KM_ATTESTATION_APPLICATION_ID);
 
-}  // namespace
+/* Size of a DER tag-length header for the given content size. The encoded id is
+ * capped at KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE, so two length octets always
+ * suffice. */
+size_t derHeaderSize(size_t content_size) {
+    if (content_size < 0x80) return 2;
+    if (content_size < 0x100) return 3;
+    return 4;
+}
 
-}  // namespace android
+void derAppendHeader(std::vector<uint8_t>* out, uint8_t tag, size_t content_size) {
+    out->push_back(tag);
+    if (content_size < 0x80) {
+        out->push_back(content_size);
+    } else if (content_size < 0x100) {
+        out->push_back(0x81);
+        out->push_back(content_size);
+    } else {
+        out->push_back(0x82);
+        out->push_back(content_size >> 8);
+        out->push_back(content_size & 0xff);
+    }
+}
 
-namespace std {
-template <> struct default_delete<android::KM_ATTESTATION_PACKAGE_INFO> {
-    void operator()(android::KM_ATTESTATION_PACKAGE_INFO* p) {
-        android::KM_ATTESTATION_PACKAGE_INFO_free(p);
+/* Minimal big-endian content octets of an INTEGER holding the given value,
+ * treated as non-negative: a leading zero octet keeps the sign bit clear. */
+std::vector<uint8_t> derIntegerContent(uint64_t value) {
+    std::vector<uint8_t> content;
+    for (uint64_t v = value; v != 0; v >>= 8) {
+        content.insert(content.begin(), v & 0xff);
     }
-};
-template <> struct default_delete<ASN1_OCTET_STRING> {
-    void operator()(ASN1_OCTET_STRING* p) { ASN1_OCTET_STRING_free(p); }
-};
-template <> struct default_delete<android::KM_ATTESTATION_APPLICATION_ID> {
-    void operator()(android::KM_ATTESTATION_APPLICATION_ID* p) {
-        android::KM_ATTESTATION_APPLICATION_ID_free(p);
+    if (content.empty() || (content.front() & 0x80)) {
+        content.insert(content.begin(), 0x00);
     }
-};
-}  // namespace std
+    return content;
+}
 
-namespace android {
+std::vector<uint8_t> encodeAttestationPackageInfo(const std::string& package_name,
+                                                  uint64_t version) {
+    const std::vector<uint8_t> version_content = derIntegerContent(version);
+    const size_t content_size = derHeaderSize(package_name.size()) + package_name.size() +
+                                derHeaderSize(version_content.size()) + version_content.size();
+    std::vector<uint8_t> out;
+    out.reserve(derHeaderSize(content_size) + content_size);
+    derAppendHeader(&out, kAsn1TagSequence, content_size);
+    derAppendHeader(&out, kAsn1TagOctetString, package_name.size());
+    out.insert(out.end(), package_name.begin(), package_name.end());
+    derAppendHeader(&out, kAsn1TagInteger, version_content.size());
+    out.insert(out.end(), version_content.begin(), version_content.end());
+    return out;
+}
+
+}  // namespace
 namespace security {
 namespace {
 
 using ::android::security::keymaster::KeyAttestationApplicationId;
 using ::android::security::keymaster::KeyAttestationPackageInfo;
 
-status_t build_attestation_package_info(const KeyAttestationPackageInfo& pinfo,
-    std::unique_ptr<KM_ATTESTATION_PACKAGE_INFO>* attestation_package_info_ptr) {
-
-    if (!attestation_package_info_ptr) return BAD_VALUE;
-    auto& attestation_package_info = *attestation_package_info_ptr;
-
-    attestation_package_info.reset(KM_ATTESTATION_PACKAGE_INFO_new());
-    if (!attestation_package_info.get()) return NO_MEMORY;
-
-    if (!pinfo.package_name()) {
-        ALOGE("Key attestation package info lacks package name");
-        return BAD_VALUE;
-    }
-
-    std::string pkg_name(String8(*pinfo.package_name()).string());
-    if (!ASN1_OCTET_STRING_set(attestation_package_info->package_name,
-                               reinterpret_cast<const unsigned char*>(pkg_name.data()),
-                               pkg_name.size())) {
-        return UNKNOWN_ERROR;
-    }
-
-    BIGNUM* bn_version = BN_new();
-    if (bn_version == nullptr) {
-        return NO_MEMORY;
-    }
-    if (BN_set_u64(bn_version, static_cast<uint64_t>(pinfo.version_code())) != 1) {
-        BN_free(bn_version);
-        return UNKNOWN_ERROR;
-    }
-    status_t retval = NO_ERROR;
-    if (BN_to_ASN1_INTEGER(bn_version, attestation_package_info->version) == nullptr) {
-        retval = UNKNOWN_ERROR;
+// Cache of final DER-encoded attestation application IDs, keyed by UID. The
+// ID for a UID is stable until the UID's packages change, so entries are
+// invalidated through invalidate_attestation_application_id_cache() when the
+// platform reports a package change, and additionally expire after a short
+// TTL as a backstop for changes that don't reach this process (e.g. an app
+// update, which bumps the version code embedded in the ID). A hit skips both
+// the binder call into the package manager and the DER encoding. Entries are
+// reference counted so a hit hands out the cached bytes without copying them.
+struct AaidCacheEntry {
+    std::shared_ptr<const std::vector<uint8_t>> aaid;
+    std::chrono::steady_clock::time_point expiry;
+};
+constexpr auto kAaidCacheTtl = std::chrono::seconds(60);
+std::mutex gAaidCacheMutex;
+std::map<uid_t, AaidCacheEntry> gAaidCache;
+
+/* Hashes the first |count| signatures of |pinfo| in one pass, emitting the
+ * DER OCTET STRING elements back to back into a single arena sized up front.
+ * Every element has the same fixed size - AAID_SIGNATURE_SIZE is exact, not
+ * just an estimate - so the caller can sort fixed-stride views into the arena
+ * instead of individually allocated buffers. BoringSSL has no public
+ * multi-buffer SHA-256 interface; each SHA256() call already takes the SHA
+ * extension/NEON block path on CPUs that have it, so the win for
+ * heavily-signed uids is one allocation instead of one per signature and a
+ * tight cache-warm hashing loop. */
+std::vector<uint8_t> digestSignatures(const KeyAttestationPackageInfo& pinfo, size_t count) {
+    static_assert(AAID_SIGNATURE_SIZE == 2 + SHA256_DIGEST_LENGTH,
+                  "signature digest elements must have a fixed encoded size");
+    std::vector<uint8_t> arena;
+    arena.reserve(count * AAID_SIGNATURE_SIZE);
+    for (size_t i = 0; i < count; ++i) {
+        const auto sig = pinfo.signature_at(i);
+        derAppendHeader(&arena, kAsn1TagOctetString, SHA256_DIGEST_LENGTH);
+        arena.resize(arena.size() + SHA256_DIGEST_LENGTH);
+        SHA256(sig.data, sig.size, arena.data() + arena.size() - SHA256_DIGEST_LENGTH);
     }
-    BN_free(bn_version);
-    return retval;
-}
-
-/* The following function are not used. They are mentioned here to silence
- * warnings about them not being used.
- */
-void unused_functions_silencer() __attribute__((unused));
-void unused_functions_silencer() {
-    i2d_KM_ATTESTATION_PACKAGE_INFO(nullptr, nullptr);
-    d2i_KM_ATTESTATION_APPLICATION_ID(nullptr, nullptr, 0);
-    d2i_KM_ATTESTATION_PACKAGE_INFO(nullptr, nullptr, 0);
+    return arena;
 }
 
 }  // namespace
 
 StatusOr<std::vector<uint8_t>>
 build_attestation_application_id(const KeyAttestationApplicationId& key_attestation_id) {
-    auto attestation_id =
-        std::unique_ptr<KM_ATTESTATION_APPLICATION_ID>(KM_ATTESTATION_APPLICATION_ID_new());
     size_t estimated_encoded_size = AAID_GENERAL_OVERHEAD;
 
-    auto attestation_pinfo_stack = reinterpret_cast<_STACK*>(attestation_id->package_infos);
-
     if (key_attestation_id.pinfos_begin() == key_attestation_id.pinfos_end()) return BAD_VALUE;
 
+    /* Each SET OF element is encoded into its own buffer first, because DER
+     * requires the elements of a SET OF in ascending order of their encodings
+     * and the order of the parcelable data is arbitrary. A package info that
+     * would push the estimated size past the limit is dropped along with all
+     * subsequent ones, keeping the encoding within
+     * KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE. */
+    std::vector<std::vector<uint8_t>> package_infos;
     for (auto pinfo = key_attestation_id.pinfos_begin(); pinfo != key_attestation_id.pinfos_end();
          ++pinfo) {
         if (!pinfo->package_name()) {
@@ -216,21 +231,12 @@ build_attestation_application_id(const KeyAttestationApplicationId& key_attestat
         if (package_name == "com.google.android.gms") {
             return KM_ERROR_KEY_RATE_LIMIT_EXCEEDED;
         }
-        std::unique_ptr<KM_ATTESTATION_PACKAGE_INFO> attestation_package_info;
-        auto rc = build_attestation_package_info(*pinfo, &attestation_package_info);
-        if (rc != NO_ERROR) {
-            ALOGE("Building DER attestation package info failed %d", rc);
-            return rc;
-        }
         estimated_encoded_size += AAID_PKG_INFO_OVERHEAD + package_name.size();
         if (estimated_encoded_size > KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE) {
             break;
         }
-        if (!sk_push(attestation_pinfo_stack, attestation_package_info.get())) {
-            return NO_MEMORY;
-        }
-        // if push succeeded, the stack takes ownership
-        attestation_package_info.release();
+        package_infos.push_back(encodeAttestationPackageInfo(
+            package_name, static_cast<uint64_t>(pinfo->version_code())));
     }
 
     /** Apps can only share a uid iff they were signed with the same certificate(s). Because the
@@ -238,49 +244,86 @@ build_attestation_application_id(const KeyAttestationApplicationId& key_attestat
      *  simply use the set of signature digests of the first package info.
      */
     const auto& pinfo = *key_attestation_id.pinfos_begin();
-    std::vector<std::vector<uint8_t>> signature_digests;
-
-    for (auto sig = pinfo.sigs_begin(); sig != pinfo.sigs_end(); ++sig) {
-        signature_digests.push_back(signature2SHA256(*sig));
-    }
 
-    auto signature_digest_stack = reinterpret_cast<_STACK*>(attestation_id->signature_digests);
-    for (auto si : signature_digests) {
+    size_t signature_count = 0;
+    while (signature_count < pinfo.signature_count()) {
         estimated_encoded_size += AAID_SIGNATURE_SIZE;
         if (estimated_encoded_size > KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE) {
             break;
         }
-        auto asn1_item = std::unique_ptr<ASN1_OCTET_STRING>(ASN1_OCTET_STRING_new());
-        if (!asn1_item) return NO_MEMORY;
-        if (!ASN1_OCTET_STRING_set(asn1_item.get(), si.data(), si.size())) {
-            return UNKNOWN_ERROR;
-        }
-        if (!sk_push(signature_digest_stack, asn1_item.get())) {
-            return NO_MEMORY;
-        }
-        asn1_item.release();  // if push succeeded, the stack takes ownership
+        signature_count += 1;
+    }
+    const std::vector<uint8_t> signature_arena = digestSignatures(pinfo, signature_count);
+
+    /* std::vector's lexicographic operator< matches the DER SET OF element
+     * ordering (and OpenSSL's der_cmp), so a plain sort yields the same
+     * encoding the old template-based i2d produced. The signature digest
+     * elements all have the same fixed size, so sorting memcmp'd views into
+     * the arena gives the same order. */
+    std::sort(package_infos.begin(), package_infos.end());
+
+    std::vector<const uint8_t*> signature_elements;
+    signature_elements.reserve(signature_count);
+    for (size_t i = 0; i < signature_count; ++i) {
+        signature_elements.push_back(signature_arena.data() + i * AAID_SIGNATURE_SIZE);
+    }
+    std::sort(signature_elements.begin(), signature_elements.end(),
+              [](const uint8_t* a, const uint8_t* b) {
+                  return memcmp(a, b, AAID_SIGNATURE_SIZE) < 0;
+              });
+
+    size_t package_set_size = 0;
+    for (const auto& element : package_infos) package_set_size += element.size();
+    const size_t signature_set_size = signature_arena.size();
+    const size_t sequence_size = derHeaderSize(package_set_size) + package_set_size +
+                                 derHeaderSize(signature_set_size) + signature_set_size;
+
+    std::vector<uint8_t> result;
+    result.reserve(derHeaderSize(sequence_size) + sequence_size);
+    derAppendHeader(&result, kAsn1TagSequence, sequence_size);
+    derAppendHeader(&result, kAsn1TagSet, package_set_size);
+    for (const auto& element : package_infos) {
+        result.insert(result.end(), element.begin(), element.end());
+    }
+    derAppendHeader(&result, kAsn1TagSet, signature_set_size);
+    for (const uint8_t* element : signature_elements) {
+        result.insert(result.end(), element, element + AAID_SIGNATURE_SIZE);
     }
-
-    int len = i2d_KM_ATTESTATION_APPLICATION_ID(attestation_id.get(), nullptr);
-    if (len < 0) return UNKNOWN_ERROR;
-
-    std::vector<uint8_t> result(len);
-    uint8_t* p = result.data();
-    len = i2d_KM_ATTESTATION_APPLICATION_ID(attestation_id.get(), &p);
-    if (len < 0) return UNKNOWN_ERROR;
-
     return result;
 }
 
+void invalidate_attestation_application_id_cache(uid_t uid) {
+    std::lock_guard<std::mutex> lock(gAaidCacheMutex);
+    gAaidCache.erase(uid);
+}
+
 StatusOr<std::vector<uint8_t>> gather_attestation_application_id(uid_t uid) {
+    auto result = gather_attestation_application_id_shared(uid);
+    if (!result.isOk()) return result.status();
+    return *result.value();
+}
+
+StatusOr<std::shared_ptr<const std::vector<uint8_t>>>
+gather_attestation_application_id_shared(uid_t uid) {
     KeyAttestationApplicationId key_attestation_id;
 
+    {
+        std::lock_guard<std::mutex> lock(gAaidCacheMutex);
+        auto entry = gAaidCache.find(uid);
+        if (entry != gAaidCache.end()) {
+            if (std::chrono::steady_clock::now() < entry->second.expiry) {
+                return entry->second.aaid;
+            }
+            gAaidCache.erase(entry);
+        }
+    }
+
+    bool provider_ok = true;
     if (uid == AID_SYSTEM) {
         /* Use a fixed ID for system callers */
-        auto pinfo = std::make_optional<KeyAttestationPackageInfo>(
+        key_attestation_id = KeyAttestationApplicationId(KeyAttestationPackageInfo(
             String16(kAttestationSystemPackageName), 1 /* version code */,
-            std::make_shared<KeyAttestationPackageInfo::SignaturesVector>());
-        key_attestation_id = KeyAttestationApplicationId(std::move(pinfo));
+            std::make_shared<KeyAttestationPackageInfo::SignaturesVector>()));
     } else {
         /* Get the attestation application ID from package manager */
         auto& pm = KeyAttestationApplicationIdProvider::get();
@@ -290,15 +333,25 @@ StatusOr<std::vector<uint8_t>> gather_attestation_application_id(uid_t uid) {
         if (!status.isOk()) {
             ALOGW("package manager request for key attestation ID failed with: %s %d",
                   status.exceptionMessage().string(), status.exceptionCode());
-            auto pinfo = std::make_optional<KeyAttestationPackageInfo>(
+            key_attestation_id = KeyAttestationApplicationId(KeyAttestationPackageInfo(
                 String16(kUnknownPackageName), 1 /* version code */,
-                std::make_shared<KeyAttestationPackageInfo::SignaturesVector>());
-            key_attestation_id = KeyAttestationApplicationId(std::move(pinfo));
+                std::make_shared<KeyAttestationPackageInfo::SignaturesVector>()));
+            // Don't cache the UnknownPackage fallback; the next attestation
+            // should retry the package manager.
+            provider_ok = false;
         }
     }
 
     /* DER encode the attestation application ID */
-    return build_attestation_application_id(key_attestation_id);
+    auto result = build_attestation_application_id(key_attestation_id);
+    if (!result.isOk()) return result.status();
+
+    auto aaid = std::make_shared<const std::vector<uint8_t>>(std::move(result).value());
+    if (provider_ok) {
+        std::lock_guard<std::mutex> lock(gAaidCacheMutex);
+        gAaidCache[uid] = {aaid, std::chrono::steady_clock::now() + kAaidCacheTtl};
+    }
+    return aaid;
 }
 
 }  // namespace security
@@ -12,13 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdio>
+#include <functional>
 #include <future>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <base/command_line.h>
@@ -81,20 +86,23 @@ void PrintUsageAndExit() {
     printf("Commands: brillo-platform-test [--prefix=<test_name_prefix>] [--test_for_0_3]\n"
            "          list-brillo-tests\n"
            "          add-entropy --input=<entropy> [--seclevel=software|strongbox|tee(default)]\n"
-           "          generate --name=<key_name> [--seclevel=software|strongbox|tee(default)]\n"
+           "          generate --name=<key_name> [--count=<n>] [--parallel=<n>]\n"
+           "                   [--seclevel=software|strongbox|tee(default)]\n"
            "          get-chars --name=<key_name>\n"
            "          export --name=<key_name>\n"
            "          delete --name=<key_name>\n"
-           "          delete-all\n"
+           "          delete-all [--parallel=<n>]\n"
            "          exists --name=<key_name>\n"
-           "          list [--prefix=<key_name_prefix>]\n"
+           "          list [--prefix=<key_name_prefix>] [--chars] [--parallel=<n>]\n"
            "          list-apps-with-keys\n"
            "          sign-verify --name=<key_name>\n"
            "          [en|de]crypt --name=<key_name> --in=<file> --out=<file>\n"
            "                       [--seclevel=software|strongbox|tee(default)]\n"
            "          confirmation --prompt_text=<PromptText> --extra_data=<hex>\n"
            "                       --locale=<locale> [--ui_options=<list_of_ints>]\n"
-           "                       --cancel_after=<seconds>\n");
+           "                       --cancel_after=<seconds>\n"
+           "          benchmark --op=sign|encrypt [--payload=<bytes>] [--threads=<n>]\n"
+           "                    [--duration=<seconds>] [--seclevel=software|strongbox|tee]\n");
     exit(1);
 }
 
@@ -136,8 +144,73 @@ void PrintKeyCharacteristics(const std::vector<ks2::Authorization>& characterist
     PrintTags(characteristics, false /* printHardwareEnforced */);
 }
 
+// Fans the indices [0, count) out to a pool of `parallel` worker threads via a
+// shared work counter; the calling thread participates as one of the workers.
+// Binder proxies are thread safe, so workers may share the caller's service
+// connections. Callers that need ordered output should aggregate results by
+// index and print after this returns.
+void runOnWorkerPool(int parallel, size_t count, const std::function<void(size_t)>& work) {
+    if (count == 0) return;
+    if (static_cast<size_t>(parallel) > count) parallel = count;
+    std::atomic<size_t> next_index(0);
+    auto worker = [&]() {
+        for (size_t index = next_index.fetch_add(1); index < count;
+             index = next_index.fetch_add(1)) {
+            work(index);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < parallel; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 const char kEncryptSuffix[] = "_ENC";
 const char kAuthenticateSuffix[] = "_AUTH";
+
+// keystore2 caps the size of a single operation request well below what the
+// encrypt/decrypt commands accept as input files, so large payloads have to be
+// streamed through update() in bounded chunks with only the tail going to
+// finish(). Output is accumulated into a buffer reserved from the input size;
+// for the cipher and MAC modes used here the output tracks the input to within
+// one chunk.
+constexpr size_t kOperationChunkSize = 32 * 1024;
+
+std::variant<int, std::vector<uint8_t>>
+streamOperation(const ks2::CreateOperationResponse& operation, const std::vector<uint8_t>& input,
+                const std::optional<std::vector<uint8_t>>& signature, const char* description) {
+    std::vector<uint8_t> output;
+    output.reserve(input.size() + kOperationChunkSize);
+    size_t consumed = 0;
+    while (input.size() - consumed > kOperationChunkSize) {
+        std::vector<uint8_t> chunk(input.begin() + consumed,
+                                   input.begin() + consumed + kOperationChunkSize);
+        std::optional<std::vector<uint8_t>> chunkOutput;
+        auto rc = operation.iOperation->update(chunk, &chunkOutput);
+        if (!rc.isOk()) {
+            std::cerr << "Failed to update " << description << " operation: " << rc.getDescription()
+                      << std::endl;
+            return unwrapError(rc);
+        }
+        if (chunkOutput) output.insert(output.end(), chunkOutput->begin(), chunkOutput->end());
+        consumed += kOperationChunkSize;
+    }
+
+    std::vector<uint8_t> tail(input.begin() + consumed, input.end());
+    std::optional<std::vector<uint8_t>> finishOutput;
+    auto rc = operation.iOperation->finish(tail, signature, &finishOutput);
+    if (!rc.isOk()) {
+        std::cerr << "Failed to finish " << description << " operation: " << rc.getDescription()
+                  << std::endl;
+        return unwrapError(rc);
+    }
+    if (finishOutput) output.insert(output.end(), finishOutput->begin(), finishOutput->end());
+    return output;
+}
 constexpr uint32_t kAESKeySize = 256;      // bits
 constexpr uint32_t kHMACKeySize = 256;     // bits
 constexpr uint32_t kHMACOutputSize = 256;  // bits
@@ -223,9 +296,26 @@ bool verifyAuthenticationKeyAttributes(const std::vector<ks2::Authorization> aut
     return verified;
 }
 
+// Per-process cache of key entries whose attributes have already been fetched
+// and verified, keyed by key name. encryptWithAuthentication and friends look
+// up key metadata before every operation; caching the verified entry lets
+// repeated operations in one process go straight to createOperation instead of
+// repeating the getKeyEntry round trip. Entries must be dropped whenever this
+// process mutates or deletes the key.
+std::map<std::string, ks2::KeyEntryResponse> verifiedKeyCache;
+
+void invalidateVerifiedKeyCache(const std::string& name) {
+    verifiedKeyCache.erase(name);
+}
+
 std::variant<int, ks2::KeyEntryResponse>
 loadOrCreateAndVerifyEncryptionKey(const std::string& name, keymint::SecurityLevel securityLevel,
                                    bool create) {
+    auto cached = verifiedKeyCache.find(name);
+    if (cached != verifiedKeyCache.end()) {
+        return cached->second;
+    }
+
     auto keystore = CreateKeystoreInstance();
 
     ks2::KeyEntryResponse keyEntryResponse;
@@ -273,12 +363,18 @@ loadOrCreateAndVerifyEncryptionKey(const std::string& name, keymint::SecurityLev
         return static_cast<int>(ks2::ResponseCode::INVALID_ARGUMENT);
     }
 
+    verifiedKeyCache[name] = keyEntryResponse;
     return keyEntryResponse;
 }
 
 std::variant<int, ks2::KeyEntryResponse>
 loadOrCreateAndVerifyAuthenticationKey(const std::string& name,
                                        keymint::SecurityLevel securityLevel, bool create) {
+    auto cached = verifiedKeyCache.find(name);
+    if (cached != verifiedKeyCache.end()) {
+        return cached->second;
+    }
+
     auto keystore = CreateKeystoreInstance();
 
     ks2::KeyEntryResponse keyEntryResponse;
@@ -326,6 +422,7 @@ loadOrCreateAndVerifyAuthenticationKey(const std::string& name,
         return static_cast<int>(ks2::ResponseCode::INVALID_ARGUMENT);
     }
 
+    verifiedKeyCache[name] = keyEntryResponse;
     return keyEntryResponse;
 }
 
@@ -366,12 +463,9 @@ encryptWithAuthentication(const std::string& name, const std::vector<uint8_t>& d
         return unwrapError(rc);
     }
 
-    std::optional<std::vector<uint8_t>> optCiphertext;
-
-    rc = encOperationResponse.iOperation->finish(data, {}, &optCiphertext);
-    if (!rc.isOk()) {
-        std::cerr << "Failed to finish encryption operation: " << rc.getDescription() << std::endl;
-        return unwrapError(rc);
+    auto ciphertextResult = streamOperation(encOperationResponse, data, {}, "encryption");
+    if (auto error = std::get_if<int>(&ciphertextResult)) {
+        return *error;
     }
 
     std::vector<uint8_t> initVector;
@@ -388,12 +482,12 @@ encryptWithAuthentication(const std::string& name, const std::vector<uint8_t>& d
         }
     }
 
-    if (!optCiphertext) {
+    auto ciphertext = std::move(std::get<std::vector<uint8_t>>(ciphertextResult));
+    if (ciphertext.empty()) {
         std::cerr << "Encryption succeeded but no ciphertext returned." << std::endl;
         return static_cast<int>(ks2::ResponseCode::SYSTEM_ERROR);
     }
 
-    auto ciphertext = std::move(*optCiphertext);
     auto toBeSigned = initVector;
     toBeSigned.insert(toBeSigned.end(), ciphertext.begin(), ciphertext.end());
 
@@ -411,21 +505,17 @@ encryptWithAuthentication(const std::string& name, const std::vector<uint8_t>& d
         return unwrapError(rc);
     }
 
-    std::optional<std::vector<uint8_t>> optMac;
-
-    rc = signOperationResponse.iOperation->finish(toBeSigned, {}, &optMac);
-    if (!rc.isOk()) {
-        std::cerr << "Failed to finish encryption operation: " << rc.getDescription() << std::endl;
-        return unwrapError(rc);
+    auto macResult = streamOperation(signOperationResponse, toBeSigned, {}, "signing");
+    if (auto error = std::get_if<int>(&macResult)) {
+        return *error;
     }
 
-    if (!optMac) {
+    auto mac = std::move(std::get<std::vector<uint8_t>>(macResult));
+    if (mac.empty()) {
         std::cerr << "Signing succeeded but no MAC returned." << std::endl;
         return static_cast<int>(ks2::ResponseCode::SYSTEM_ERROR);
     }
 
-    auto mac = std::move(*optMac);
-
     EncryptedData protobuf;
     protobuf.set_init_vector(initVector.data(), initVector.size());
     protobuf.set_authentication_data(mac.data(), mac.size());
@@ -494,11 +584,10 @@ decryptWithAuthentication(const std::string& name, const std::vector<uint8_t>& d
     p = reinterpret_cast<const uint8_t*>(protobuf.authentication_data().data());
     std::vector<uint8_t> signature(p, p + protobuf.authentication_data().size());
 
-    std::optional<std::vector<uint8_t>> optOut;
-    rc = signOperationResponse.iOperation->finish(toBeVerified, signature, &optOut);
-    if (!rc.isOk()) {
-        std::cerr << "Decrypt: HMAC verification failed: " << rc.getDescription() << std::endl;
-        return unwrapError(rc);
+    auto verifyResult =
+        streamOperation(signOperationResponse, toBeVerified, signature, "HMAC verification");
+    if (auto error = std::get_if<int>(&verifyResult)) {
+        return *error;
     }
 
     // Begin decryption operation
@@ -518,23 +607,15 @@ decryptWithAuthentication(const std::string& name, const std::vector<uint8_t>& d
         return unwrapError(rc);
     }
 
-    std::optional<std::vector<uint8_t>> optPlaintext;
-
     p = reinterpret_cast<const uint8_t*>(protobuf.encrypted_data().data());
     std::vector<uint8_t> cyphertext(p, p + protobuf.encrypted_data().size());
 
-    rc = encOperationResponse.iOperation->finish(cyphertext, {}, &optPlaintext);
-    if (!rc.isOk()) {
-        std::cerr << "Failed to finish encryption operation: " << rc.getDescription() << std::endl;
-        return unwrapError(rc);
-    }
-
-    if (!optPlaintext) {
-        std::cerr << "Decryption succeeded but no plaintext returned." << std::endl;
-        return static_cast<int>(ks2::ResponseCode::SYSTEM_ERROR);
+    auto plaintextResult = streamOperation(encOperationResponse, cyphertext, {}, "decryption");
+    if (auto error = std::get_if<int>(&plaintextResult)) {
+        return *error;
     }
 
-    return *optPlaintext;
+    return std::get<std::vector<uint8_t>>(plaintextResult);
 }
 
 bool TestKey(const std::string& name, bool required,
@@ -743,10 +824,7 @@ void WriteFile(const std::string& filename, const std::vector<uint8_t>& content)
     }
 }
 
-// Note: auth_bound keys created with this tool will not be usable.
-int GenerateKey(const std::string& name, keymint::SecurityLevel securityLevel, bool auth_bound) {
-    auto keystore = CreateKeystoreInstance();
-    auto sec_level = GetSecurityLevelInterface(keystore, securityLevel);
+keymint::AuthorizationSetBuilder generateKeySigningParams(bool auth_bound) {
     keymint::AuthorizationSetBuilder params;
     params.RsaSigningKey(2048, 65537)
         .Digest(keymint::Digest::SHA_2_224)
@@ -762,6 +840,14 @@ int GenerateKey(const std::string& name, keymint::SecurityLevel securityLevel, b
     } else {
         params.Authorization(keymint::TAG_NO_AUTH_REQUIRED);
     }
+    return params;
+}
+
+// Note: auth_bound keys created with this tool will not be usable.
+int GenerateKey(const std::string& name, keymint::SecurityLevel securityLevel, bool auth_bound) {
+    auto keystore = CreateKeystoreInstance();
+    auto sec_level = GetSecurityLevelInterface(keystore, securityLevel);
+    auto params = generateKeySigningParams(auth_bound);
 
     ks2::KeyMetadata keyMetadata;
 
@@ -773,6 +859,7 @@ int GenerateKey(const std::string& name, keymint::SecurityLevel securityLevel, b
         std::cerr << "GenerateKey failed: " << rc.getDescription() << std::endl;
         return unwrapError(rc);
     }
+    invalidateVerifiedKeyCache(name);
     std::cout << "GenerateKey: success" << std::endl;
     PrintKeyCharacteristics(keyMetadata.authorizations);
     return 0;
@@ -822,6 +909,7 @@ int DeleteKey(const std::string& name) {
         std::cerr << "Failed to delete key: " << rc.getDescription();
         return unwrapError(rc);
     }
+    invalidateVerifiedKeyCache(name);
     std::cout << "Successfully deleted key." << std::endl;
     return 0;
 }
@@ -845,7 +933,7 @@ int DoesKeyExist(const std::string& name) {
     return 0;
 }
 
-int List() {
+int List(bool withCharacteristics, int parallel) {
     auto keystore = CreateKeystoreInstance();
     std::vector<ks2::KeyDescriptor> key_list;
     auto rc = keystore->listEntries(ks2::Domain::APP, -1 /* nspace ignored */, &key_list);
@@ -853,15 +941,110 @@ int List() {
         std::cerr << "ListKeys failed: " << rc.getDescription() << std::endl;
         return unwrapError(rc);
     }
+
+    if (!withCharacteristics) {
+        std::cout << "Keys:\n";
+        for (const auto& key : key_list) {
+            std::cout << "  "
+                      << (key.alias ? *key.alias : "Whoopsi - no alias, this should not happen.")
+                      << std::endl;
+        }
+        return 0;
+    }
+
+    // The entries are fetched on the worker pool but stored by index, so the
+    // printed order matches the plain listing no matter which worker ran what.
+    std::vector<ks2::KeyEntryResponse> entries(key_list.size());
+    std::vector<std::string> errors(key_list.size());
+    runOnWorkerPool(parallel, key_list.size(), [&](size_t index) {
+        auto get_rc = keystore->getKeyEntry(key_list[index], &entries[index]);
+        if (!get_rc.isOk()) errors[index] = get_rc.getDescription();
+    });
+
     std::cout << "Keys:\n";
-    for (const auto& key : key_list) {
+    for (size_t i = 0; i < key_list.size(); ++i) {
         std::cout << "  "
-                  << (key.alias ? *key.alias : "Whoopsi - no alias, this should not happen.")
+                  << (key_list[i].alias ? *key_list[i].alias
+                                        : "Whoopsi - no alias, this should not happen.")
                   << std::endl;
+        if (!errors[i].empty()) {
+            std::cout << "    Failed to get characteristics: " << errors[i] << std::endl;
+            continue;
+        }
+        PrintKeyCharacteristics(entries[i].metadata.authorizations);
     }
     return 0;
 }
 
+int DeleteAllKeys(int parallel) {
+    auto keystore = CreateKeystoreInstance();
+    std::vector<ks2::KeyDescriptor> key_list;
+    auto rc = keystore->listEntries(ks2::Domain::APP, -1 /* nspace ignored */, &key_list);
+    if (!rc.isOk()) {
+        std::cerr << "ListKeys failed: " << rc.getDescription() << std::endl;
+        return unwrapError(rc);
+    }
+
+    std::vector<std::string> errors(key_list.size());
+    std::atomic<size_t> deleted(0);
+    runOnWorkerPool(parallel, key_list.size(), [&](size_t index) {
+        auto delete_rc = keystore->deleteKey(key_list[index]);
+        if (delete_rc.isOk()) {
+            deleted.fetch_add(1);
+        } else {
+            errors[index] = delete_rc.getDescription();
+        }
+    });
+
+    // The key cache is not thread safe, so invalidation happens after the join.
+    for (size_t i = 0; i < key_list.size(); ++i) {
+        if (key_list[i].alias && errors[i].empty()) {
+            invalidateVerifiedKeyCache(*key_list[i].alias);
+        }
+    }
+    for (size_t i = 0; i < key_list.size(); ++i) {
+        if (!errors[i].empty()) {
+            std::cerr << "Failed to delete "
+                      << (key_list[i].alias ? *key_list[i].alias : "<no alias>") << ": "
+                      << errors[i] << std::endl;
+        }
+    }
+    std::cout << "Deleted " << deleted.load() << " of " << key_list.size() << " keys."
+              << std::endl;
+    return deleted.load() == key_list.size() ? 0 : 1;
+}
+
+int BatchGenerateKeys(const std::string& prefix, keymint::SecurityLevel securityLevel,
+                      bool auth_bound, int count, int parallel) {
+    auto keystore = CreateKeystoreInstance();
+    auto sec_level = GetSecurityLevelInterface(keystore, securityLevel);
+
+    std::vector<std::string> errors(count);
+    std::atomic<size_t> generated(0);
+    runOnWorkerPool(parallel, count, [&](size_t index) {
+        auto params = generateKeySigningParams(auth_bound);
+        ks2::KeyMetadata keyMetadata;
+        auto generate_rc = sec_level->generateKey(
+            keyDescriptor(prefix + "_" + std::to_string(index)), {} /* attestationKey */,
+            params.vector_data(), 0 /* flags */, {} /* entropy */, &keyMetadata);
+        if (generate_rc.isOk()) {
+            generated.fetch_add(1);
+        } else {
+            errors[index] = generate_rc.getDescription();
+        }
+    });
+
+    for (int i = 0; i < count; ++i) {
+        if (!errors[i].empty()) {
+            std::cerr << "Failed to generate " << prefix << "_" << i << ": " << errors[i]
+                      << std::endl;
+        }
+    }
+    std::cout << "Generated " << generated.load() << " of " << count << " keys with prefix "
+              << prefix << "." << std::endl;
+    return generated.load() == static_cast<size_t>(count) ? 0 : 1;
+}
+
 int SignAndVerify(const std::string& name) {
     auto keystore = CreateKeystoreInstance();
     auto sign_params = keymint::AuthorizationSetBuilder()
@@ -969,6 +1152,17 @@ keymint::SecurityLevel securityLevelOption2SecurlityLevel(const CommandLine& cmd
     return keymint::SecurityLevel::TRUSTED_ENVIRONMENT;
 }
 
+// Parses --parallel (defaults to 1). Returns 0 on a malformed value.
+int parallelOption(const CommandLine& cmd) {
+    if (!cmd.HasSwitch("parallel")) return 1;
+    int parallel = 0;
+    if (!base::StringToInt(cmd.GetSwitchValueASCII("parallel"), &parallel) || parallel <= 0) {
+        std::cerr << "--parallel must be a positive integer." << std::endl;
+        return 0;
+    }
+    return parallel;
+}
+
 class ConfirmationListener
     : public apc::BnConfirmationCallback,
       public std::promise<std::tuple<apc::ResponseCode, std::optional<std::vector<uint8_t>>>> {
@@ -1077,6 +1271,140 @@ int Confirmation(const std::string& promptText, const std::string& extraDataHex,
     return 0;
 }
 
+// One measured benchmark iteration: a full createOperation/update/finish round
+// trip using the same parameter sets as the encrypt and sign-verify commands.
+bool BenchmarkIteration(const std::string& op, const ks2::KeyEntryResponse& key,
+                        const std::vector<uint8_t>& payload) {
+    keymint::AuthorizationSetBuilder params;
+    if (op == "sign") {
+        params.Authorization(keymint::TAG_PURPOSE, keymint::KeyPurpose::SIGN)
+            .Digest(keymint::Digest::SHA_2_256)
+            .Authorization(keymint::TAG_MAC_LENGTH, kHMACOutputSize);
+    } else {
+        params.Authorization(keymint::TAG_PURPOSE, keymint::KeyPurpose::ENCRYPT)
+            .Padding(keymint::PaddingMode::PKCS7)
+            .Authorization(keymint::TAG_BLOCK_MODE, keymint::BlockMode::CBC);
+    }
+
+    ks2::CreateOperationResponse operationResponse;
+    auto rc = key.iSecurityLevel->createOperation(key.metadata.key, params.vector_data(),
+                                                  false /* forced */, &operationResponse);
+    if (!rc.isOk()) {
+        std::cerr << "Benchmark: failed to begin operation: " << rc.getDescription() << std::endl;
+        return false;
+    }
+
+    auto result = streamOperation(operationResponse, payload, {}, "benchmark");
+    return std::get_if<int>(&result) == nullptr;
+}
+
+int Benchmark(const std::string& op, const std::string& payloadArg, const std::string& threadsArg,
+              const std::string& durationArg, keymint::SecurityLevel securityLevel) {
+    if (op != "sign" && op != "encrypt") {
+        std::cerr << "Benchmark: --op must be sign or encrypt." << std::endl;
+        return 1;
+    }
+    int payload_size = 1024;
+    int thread_count = 1;
+    int duration_seconds = 10;
+    if (!payloadArg.empty() && !base::StringToInt(payloadArg, &payload_size)) return 1;
+    if (!threadsArg.empty() && !base::StringToInt(threadsArg, &thread_count)) return 1;
+    if (!durationArg.empty() && !base::StringToInt(durationArg, &duration_seconds)) return 1;
+    if (payload_size <= 0 || thread_count <= 0 || duration_seconds <= 0) {
+        std::cerr << "Benchmark: --payload, --threads and --duration must be positive."
+                  << std::endl;
+        return 1;
+    }
+
+    // Keys are created up front, one per worker, so neither key generation nor
+    // the key cache (which is not thread safe) is touched on the measured path.
+    std::vector<ks2::KeyEntryResponse> keys;
+    std::vector<std::string> key_names;
+    for (int i = 0; i < thread_count; ++i) {
+        std::string name = "benchmark_" + op + "_" + std::to_string(i);
+        auto key_result = op == "sign"
+                              ? loadOrCreateAndVerifyAuthenticationKey(name, securityLevel,
+                                                                       true /* create */)
+                              : loadOrCreateAndVerifyEncryptionKey(name, securityLevel,
+                                                                   true /* create */);
+        if (auto error = std::get_if<int>(&key_result)) {
+            return *error;
+        }
+        keys.push_back(std::move(std::get<ks2::KeyEntryResponse>(key_result)));
+        key_names.push_back(std::move(name));
+    }
+
+    const std::vector<uint8_t> payload(payload_size, 0xaa);
+    std::atomic<bool> stop(false);
+    std::atomic<bool> failed(false);
+    std::vector<std::vector<double>> latencies_ms(thread_count);
+
+    auto worker = [&](int index) {
+        auto& latencies = latencies_ms[index];
+        while (!stop.load(std::memory_order_relaxed)) {
+            auto begin = std::chrono::steady_clock::now();
+            if (!BenchmarkIteration(op, keys[index], payload)) {
+                failed = true;
+                stop = true;
+                return;
+            }
+            auto end = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+        }
+    };
+
+    auto benchmark_begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(duration_seconds));
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - benchmark_begin).count();
+
+    auto keystore = CreateKeystoreInstance();
+    for (const auto& name : key_names) {
+        keystore->deleteKey(keyDescriptor(name));
+        invalidateVerifiedKeyCache(name);
+    }
+
+    if (failed) {
+        std::cerr << "Benchmark aborted by a failing operation." << std::endl;
+        return 1;
+    }
+
+    std::vector<double> all_latencies;
+    for (auto& latencies : latencies_ms) {
+        all_latencies.insert(all_latencies.end(), latencies.begin(), latencies.end());
+    }
+    if (all_latencies.empty()) {
+        std::cerr << "Benchmark: no operation completed." << std::endl;
+        return 1;
+    }
+    std::sort(all_latencies.begin(), all_latencies.end());
+    auto percentile = [&](double p) {
+        size_t index = static_cast<size_t>(p * (all_latencies.size() - 1));
+        return all_latencies[index];
+    };
+    double total_ms = 0;
+    for (double latency : all_latencies) {
+        total_ms += latency;
+    }
+
+    printf("op=%s payload=%d threads=%d duration=%.1fs\n", op.c_str(), payload_size, thread_count,
+           elapsed_seconds);
+    printf("ops: %zu  ops/sec: %.1f\n", all_latencies.size(),
+           all_latencies.size() / elapsed_seconds);
+    printf("latency ms: avg %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           total_ms / all_latencies.size(), percentile(0.5), percentile(0.9), percentile(0.99),
+           all_latencies.back());
+    return 0;
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -1095,6 +1423,19 @@ int main(int argc, char** argv) {
     } else if (args[0] == "list-brillo-tests") {
         return ListTestCases();
     } else if (args[0] == "generate") {
+        if (command_line->HasSwitch("count")) {
+            int count = 0;
+            if (!base::StringToInt(command_line->GetSwitchValueASCII("count"), &count) ||
+                count <= 0) {
+                std::cerr << "--count must be a positive integer." << std::endl;
+                return 1;
+            }
+            int parallel = parallelOption(*command_line);
+            if (parallel == 0) return 1;
+            return BatchGenerateKeys(command_line->GetSwitchValueASCII("name"),
+                                     securityLevelOption2SecurlityLevel(*command_line),
+                                     command_line->HasSwitch("auth_bound"), count, parallel);
+        }
         return GenerateKey(command_line->GetSwitchValueASCII("name"),
                            securityLevelOption2SecurlityLevel(*command_line),
                            command_line->HasSwitch("auth_bound"));
@@ -1104,10 +1445,16 @@ int main(int argc, char** argv) {
         return ExportKey(command_line->GetSwitchValueASCII("name"));
     } else if (args[0] == "delete") {
         return DeleteKey(command_line->GetSwitchValueASCII("name"));
+    } else if (args[0] == "delete-all") {
+        int parallel = parallelOption(*command_line);
+        if (parallel == 0) return 1;
+        return DeleteAllKeys(parallel);
     } else if (args[0] == "exists") {
         return DoesKeyExist(command_line->GetSwitchValueASCII("name"));
     } else if (args[0] == "list") {
-        return List();
+        int parallel = parallelOption(*command_line);
+        if (parallel == 0) return 1;
+        return List(command_line->HasSwitch("chars"), parallel);
     } else if (args[0] == "sign-verify") {
         return SignAndVerify(command_line->GetSwitchValueASCII("name"));
     } else if (args[0] == "encrypt") {
@@ -1119,6 +1466,12 @@ int main(int argc, char** argv) {
         return Decrypt(command_line->GetSwitchValueASCII("name"),
                        command_line->GetSwitchValueASCII("in"),
                        command_line->GetSwitchValueASCII("out"));
+    } else if (args[0] == "benchmark") {
+        return Benchmark(command_line->GetSwitchValueASCII("op"),
+                         command_line->GetSwitchValueASCII("payload"),
+                         command_line->GetSwitchValueASCII("threads"),
+                         command_line->GetSwitchValueASCII("duration"),
+                         securityLevelOption2SecurlityLevel(*command_line));
     } else if (args[0] == "confirmation") {
         return Confirmation(command_line->GetSwitchValueNative("prompt_text"),
                             command_line->GetSwitchValueASCII("extra_data"),
@@ -18,16 +18,79 @@
 #include <binder/IServiceManager.h>
 
 #include <keystore/keystore_get.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 using namespace android;
 using namespace keystore;
 
-ssize_t keystore_get(const char* key, size_t keyLength, uint8_t** value) {
+namespace {
+
+/* The service handle is resolved once and shared by all callers; a death
+ * recipient drops it if keystore dies so the next caller resolves the new
+ * instance. Without this every lookup pays a service manager round trip, and
+ * concurrent async requests would each resolve their own connection. */
+std::mutex gServiceMutex;
+sp<android::security::keystore::IKeystoreService> gService;
+
+class ServiceDeathRecipient : public IBinder::DeathRecipient {
+    void binderDied(const wp<IBinder>& /* who */) override {
+        std::lock_guard<std::mutex> lock(gServiceMutex);
+        gService = nullptr;
+    }
+};
+
+sp<android::security::keystore::IKeystoreService> getKeystoreService() {
+    std::lock_guard<std::mutex> lock(gServiceMutex);
+    if (gService != nullptr) {
+        return gService;
+    }
+
     sp<IServiceManager> sm = defaultServiceManager();
     sp<IBinder> binder = sm->getService(String16("android.security.keystore"));
     sp<android::security::keystore::IKeystoreService> service =
         interface_cast<android::security::keystore::IKeystoreService>(binder);
+    if (service == nullptr) {
+        return nullptr;
+    }
+
+    static sp<ServiceDeathRecipient> deathRecipient = new ServiceDeathRecipient();
+    if (binder->linkToDeath(deathRecipient) != OK) {
+        /* Without the death notification the handle could go stale across a
+         * keystore restart, so use it for this call only. */
+        return service;
+    }
+
+    gService = service;
+    return gService;
+}
+
+}  // namespace
+
+/* Shared between the requesting thread and the worker thread. Both hold a
+ * reference; the last one to let go frees the request. The worker delivers
+ * the callback under the mutex so that keystore_get_cancel can guarantee the
+ * callback will not run once it has returned. */
+struct keystore_get_request {
+    std::mutex mutex;
+    bool cancelled = false;
+    int refs = 2; /* caller handle + worker thread */
+};
+
+static void keystore_get_request_release(keystore_get_request* request) {
+    bool destroy;
+    {
+        std::lock_guard<std::mutex> lock(request->mutex);
+        destroy = (--request->refs == 0);
+    }
+    if (destroy) delete request;
+}
+
+ssize_t keystore_get(const char* key, size_t keyLength, uint8_t** value) {
+    sp<android::security::keystore::IKeystoreService> service = getKeystoreService();
 
     if (service == nullptr) {
         return -1;
@@ -44,3 +107,41 @@ ssize_t keystore_get(const char* key, size_t keyLength, uint8_t** value) {
     }
     return result.size();
 }
+
+keystore_get_request* keystore_get_async(const char* key, size_t keyLength,
+                                         keystore_get_cb callback, void* arg) {
+    if (key == nullptr || keyLength == 0 || callback == nullptr) {
+        return nullptr;
+    }
+
+    auto* request = new keystore_get_request;
+
+    /* The blocking get (including the service lookup) runs on a worker thread
+     * so the caller's event loop is never stalled by a slow keystore. */
+    std::thread([request, key = std::string(key, keyLength), callback, arg]() {
+        uint8_t* value = nullptr;
+        ssize_t length = keystore_get(key.data(), key.size(), &value);
+        {
+            std::lock_guard<std::mutex> lock(request->mutex);
+            if (!request->cancelled) {
+                callback(arg, length, length < 0 ? nullptr : value);
+                value = nullptr; /* ownership passed to the callback */
+            }
+        }
+        free(value);
+        keystore_get_request_release(request);
+    }).detach();
+
+    return request;
+}
+
+void keystore_get_cancel(keystore_get_request* request) {
+    if (request == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(request->mutex);
+        request->cancelled = true;
+    }
+    keystore_get_request_release(request);
+}
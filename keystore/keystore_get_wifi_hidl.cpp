@@ -21,8 +21,13 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include <android/system/wifi/keystore/1.0/IKeystore.h>
+#include <hidl/HidlSupport.h>
 #include <log/log.h>
 
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include <keystore/keystore_get.h>
 
 using namespace android;
@@ -33,13 +38,56 @@ using android::hardware::Return;
 using android::sp;
 using android::system::wifi::keystore::V1_0::IKeystore;
 
+namespace {
+
+/* The keystore HAL handle is resolved once and cached; a death recipient
+ * drops it if keystore dies so the next caller resolves the new instance.
+ * Without this, every keystore_get pays a service manager lookup, and after
+ * a keystore restart queued wifi gets serialize behind repeated lookups. */
+std::mutex gServiceMutex;
+sp<IKeystore> gService;
+
+struct ServiceDeathRecipient : public hardware::hidl_death_recipient {
+    void serviceDied(uint64_t /* cookie */,
+                     const wp<hidl::base::V1_0::IBase>& /* who */) override {
+        std::lock_guard<std::mutex> lock(gServiceMutex);
+        gService = nullptr;
+    }
+};
+
+sp<IKeystore> getKeystoreService() {
+    std::lock_guard<std::mutex> lock(gServiceMutex);
+    if (gService != nullptr) {
+        return gService;
+    }
+
+    sp<IKeystore> service = IKeystore::tryGetService();
+    if (service == nullptr) {
+        return nullptr;
+    }
+
+    static sp<ServiceDeathRecipient> deathRecipient = new ServiceDeathRecipient();
+    auto linked = service->linkToDeath(deathRecipient, 0 /* cookie */);
+    if (!linked.isOk() || !linked) {
+        /* Without the death notification the handle could go stale across a
+         * keystore restart, so use it for this call only. */
+        ALOGW("Cannot link to keystore HAL death. Not caching the handle.");
+        return service;
+    }
+
+    gService = service;
+    return gService;
+}
+
+}  // namespace
+
 ssize_t keystore_get(const char *key, size_t keyLength, uint8_t** value) {
     if (key == nullptr || keyLength == 0 || value == nullptr) {
         ALOGE("Null pointer argument passed");
         return -1;
     }
 
-    sp<IKeystore> service = IKeystore::tryGetService();
+    sp<IKeystore> service = getKeystoreService();
     if (service == nullptr) {
         ALOGE("could not contact keystore HAL");
         return -1;
@@ -58,3 +106,61 @@ ssize_t keystore_get(const char *key, size_t keyLength, uint8_t** value) {
     Return<void> ret = service->getBlob(hidl_string(key, keyLength), cb);
     return ret.isOk() && success ? return_size : -1;
 }
+
+/* Shared between the requesting thread and the worker thread. Both hold a
+ * reference; the last one to let go frees the request. The worker delivers
+ * the callback under the mutex so that keystore_get_cancel can guarantee the
+ * callback will not run once it has returned. */
+struct keystore_get_request {
+    std::mutex mutex;
+    bool cancelled = false;
+    int refs = 2; /* caller handle + worker thread */
+};
+
+static void keystore_get_request_release(keystore_get_request* request) {
+    bool destroy;
+    {
+        std::lock_guard<std::mutex> lock(request->mutex);
+        destroy = (--request->refs == 0);
+    }
+    if (destroy) delete request;
+}
+
+keystore_get_request* keystore_get_async(const char* key, size_t keyLength,
+                                         keystore_get_cb callback, void* arg) {
+    if (key == nullptr || keyLength == 0 || callback == nullptr) {
+        ALOGE("Null pointer argument passed");
+        return nullptr;
+    }
+
+    auto* request = new keystore_get_request;
+
+    /* The blocking get runs on a worker thread so the caller's event loop is
+     * not stalled by a slow keystore. */
+    std::thread([request, key = std::string(key, keyLength), callback, arg]() {
+        uint8_t* value = nullptr;
+        ssize_t length = keystore_get(key.data(), key.size(), &value);
+        {
+            std::lock_guard<std::mutex> lock(request->mutex);
+            if (!request->cancelled) {
+                callback(arg, length, length < 0 ? nullptr : value);
+                value = nullptr; /* ownership passed to the callback */
+            }
+        }
+        free(value);
+        keystore_get_request_release(request);
+    }).detach();
+
+    return request;
+}
+
+void keystore_get_cancel(keystore_get_request* request) {
+    if (request == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(request->mutex);
+        request->cancelled = true;
+    }
+    keystore_get_request_release(request);
+}
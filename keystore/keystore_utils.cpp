@@ -147,9 +147,8 @@ void log_key_integrity_violation(const char* name, uid_t uid) {
 
 namespace keystore {
 
-hidl_vec<uint8_t> blob2hidlVec(const Blob& blob) {
-    hidl_vec<uint8_t> result(blob.getValue(), blob.getValue() + blob.getLength());
-    return result;
+HidlBuf blob2hidlVec(const Blob& blob) {
+    return HidlBuf(blob.getValue(), blob.getLength());
 }
 
 SecurityLevel flagsToSecurityLevel(int32_t flags) {
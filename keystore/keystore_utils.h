@@ -27,6 +27,7 @@
 #include <memory>
 
 #include <keystore/keymaster_types.h>
+#include <keystore/keystore_hidl_support.h>
 
 size_t readFully(int fd, uint8_t* data, size_t size);
 size_t writeFully(int fd, uint8_t* data, size_t size);
@@ -60,7 +61,10 @@ void log_key_integrity_violation(const char* name, uid_t uid);
 
 namespace keystore {
 
-hidl_vec<uint8_t> blob2hidlVec(const Blob& blob);
+// Returns a HidlBuf borrowing the blob's bytes: no copy is made, and the
+// result must not outlive the blob. Every caller passes it straight into a
+// synchronous keymaster call, so the lifetime is naturally bounded.
+HidlBuf blob2hidlVec(const Blob& blob);
 
 SecurityLevel flagsToSecurityLevel(int32_t flags);
 uint32_t securityLevelToFlags(SecurityLevel secLevel);
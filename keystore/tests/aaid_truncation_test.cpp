@@ -75,15 +75,15 @@ constexpr const size_t kTooManySignatures = 35;
 using ::android::content::pm::Signature;
 using ::android::security::build_attestation_application_id;
 
-std::optional<KeyAttestationPackageInfo>
+KeyAttestationPackageInfo
 make_package_info_with_signatures(const char* package_name,
                                   KeyAttestationPackageInfo::SignaturesVector signatures) {
-    return std::make_optional<KeyAttestationPackageInfo>(
+    return KeyAttestationPackageInfo(
         String16(package_name), 1 /* version code */,
         std::make_shared<KeyAttestationPackageInfo::SignaturesVector>(std::move(signatures)));
 }
 
-std::optional<KeyAttestationPackageInfo> make_package_info(const char* package_name) {
+KeyAttestationPackageInfo make_package_info(const char* package_name) {
     return make_package_info_with_signatures(package_name,
                                              KeyAttestationPackageInfo::SignaturesVector());
 }
@@ -27,6 +27,7 @@
 #include <openssl/digest.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
+#include <openssl/sha.h>
 
 #include <log/log.h>
 
@@ -74,6 +75,10 @@ void UserState::setState(State state) {
 void UserState::zeroizeMasterKeysInMemory() {
     memset(mMasterKey.data(), 0, mMasterKey.size());
     memset(mSalt, 0, sizeof(mSalt));
+    memset(mCachedPasswordKey.data(), 0, mCachedPasswordKey.size());
+    mCachedPasswordKey.clear();
+    memset(mCachedPasswordKeyDigest, 0, sizeof(mCachedPasswordKeyDigest));
+    mCachedPasswordKeyValid = false;
 }
 
 bool UserState::deleteMasterKey() {
@@ -246,6 +251,21 @@ void UserState::generateKeyFromPassword(std::vector<uint8_t>& key, const android
         saltSize = sizeof("keystore");
     }
 
+    // A digest of the derivation inputs keys the cache, so the password itself
+    // is not kept around for the comparison.
+    uint8_t inputDigest[SHA256_DIGEST_SIZE_BYTES];
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, pw.string(), pw.length());
+    SHA256_Update(&ctx, salt, saltSize);
+    SHA256_Final(inputDigest, &ctx);
+
+    if (mCachedPasswordKeyValid && mCachedPasswordKey.size() == key.size() &&
+        memcmp(inputDigest, mCachedPasswordKeyDigest, sizeof(inputDigest)) == 0) {
+        std::copy(mCachedPasswordKey.begin(), mCachedPasswordKey.end(), key.begin());
+        return;
+    }
+
     const EVP_MD* digest = EVP_sha256();
 
     // SHA1 was used prior to increasing the key size
@@ -255,6 +275,10 @@ void UserState::generateKeyFromPassword(std::vector<uint8_t>& key, const android
 
     PKCS5_PBKDF2_HMAC(reinterpret_cast<const char*>(pw.string()), pw.length(), salt, saltSize, 8192,
                       digest, key.size(), key.data());
+
+    mCachedPasswordKey = key;
+    memcpy(mCachedPasswordKeyDigest, inputDigest, sizeof(mCachedPasswordKeyDigest));
+    mCachedPasswordKeyValid = true;
 }
 
 bool UserState::generateSalt() {
@@ -277,12 +301,15 @@ void UserState::setupMasterKeys() {
 }
 
 LockedUserState<UserState> UserStateDB::getUserState(uid_t userId) {
-    std::unique_lock<std::mutex> lock(locked_state_mutex_);
-    decltype(mMasterKeys.begin()) it;
+    auto& shard = getShard(userId);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    decltype(shard.master_keys.begin()) it;
     bool inserted;
-    std::tie(it, inserted) = mMasterKeys.emplace(userId, userId);
+    std::tie(it, inserted) = shard.master_keys.emplace(std::piecewise_construct,
+                                                      std::forward_as_tuple(userId),
+                                                      std::forward_as_tuple(userId));
     if (inserted) {
-        if (!it->second.initialize()) {
+        if (!it->second.state.initialize()) {
             /* There's not much we can do if initialization fails. Trying to
              * unlock the keystore for that user will fail as well, so any
              * subsequent request for this user will just return SYSTEM_ERROR.
@@ -290,7 +317,12 @@ LockedUserState<UserState> UserStateDB::getUserState(uid_t userId) {
             ALOGE("User initialization failed for %u; subsequent operations will fail", userId);
         }
     }
-    return get(std::move(lock), &it->second);
+    Entry* entry = &it->second;
+    /* Entries are never erased, so the shard mutex can be dropped before
+     * blocking on the entry: a writer waiting its turn must not stall lookups
+     * of other users in the shard. */
+    lock.unlock();
+    return {&entry->state, std::unique_lock<std::shared_mutex>(entry->mutex)};
 }
 
 LockedUserState<UserState> UserStateDB::getUserStateByUid(uid_t uid) {
@@ -298,10 +330,15 @@ LockedUserState<UserState> UserStateDB::getUserStateByUid(uid_t uid) {
 }
 
 LockedUserState<const UserState> UserStateDB::getUserState(uid_t userId) const {
-    std::unique_lock<std::mutex> lock(locked_state_mutex_);
-    auto it = mMasterKeys.find(userId);
-    if (it == mMasterKeys.end()) return {};
-    return get(std::move(lock), &it->second);
+    auto& shard = getShard(userId);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    auto it = shard.master_keys.find(userId);
+    if (it == shard.master_keys.end()) return {};
+    Entry* entry = &it->second;
+    /* Read-only access takes the entry mutex shared: concurrent queries for
+     * the same user no longer serialize, only a writer excludes them. */
+    lock.unlock();
+    return {&entry->state, std::shared_lock<std::shared_mutex>(entry->mutex)};
 }
 
 LockedUserState<const UserState> UserStateDB::getUserStateByUid(uid_t uid) const {
@@ -29,17 +29,23 @@
 #include "keystore_utils.h"
 
 #include <android-base/logging.h>
-#include <condition_variable>
 #include <keystore/keystore_concurrency.h>
+#include <map>
 #include <mutex>
-#include <set>
+#include <shared_mutex>
 #include <vector>
 
 namespace keystore {
 
 class UserState;
 
-template <typename UserState> using LockedUserState = ProxyLock<UnlockProxyLockHelper<UserState>>;
+/* Mutable access rides an ExclusiveLockedProxy, const access a
+ * SharedLockedProxy, so read-only queries for the same user run concurrently
+ * while writers still get the entry to themselves. */
+template <typename T>
+using LockedUserState = std::conditional_t<std::is_const<T>::value,
+                                           SharedLockedProxy<std::remove_const_t<T>>,
+                                           ExclusiveLockedProxy<T>>;
 
 class UserState {
   public:
@@ -94,6 +100,14 @@ class UserState {
 
     std::vector<uint8_t> mMasterKey;
     uint8_t mSalt[SALT_SIZE];
+
+    /* Cache of the last derived password key, keyed by a digest of the
+     * derivation inputs. Within one unlock flow the 8192-round PBKDF2 runs
+     * repeatedly with identical password and salt; the cache lets all but the
+     * first run skip the KDF. Zeroized together with the master key. */
+    std::vector<uint8_t> mCachedPasswordKey;
+    uint8_t mCachedPasswordKeyDigest[SHA256_DIGEST_SIZE_BYTES] = {};
+    bool mCachedPasswordKeyValid = false;
 };
 
 bool operator<(uid_t userId, const UserState& rhs);
@@ -106,24 +120,30 @@ class UserStateDB {
     LockedUserState<const UserState> getUserStateByUid(uid_t uid) const;
 
   private:
-    mutable std::set<const UserState*> locked_state_;
-    mutable std::mutex locked_state_mutex_;
-    mutable std::condition_variable locked_state_mutex_cond_var_;
-
-    template <typename UserState>
-    LockedUserState<UserState> get(std::unique_lock<std::mutex> lock, UserState* entry) const {
-        locked_state_mutex_cond_var_.wait(
-            lock, [&] { return locked_state_.find(entry) == locked_state_.end(); });
-        locked_state_.insert(entry);
-        return {entry, [&](UserState* entry) {
-                    std::unique_lock<std::mutex> lock(locked_state_mutex_);
-                    locked_state_.erase(entry);
-                    lock.unlock();
-                    locked_state_mutex_cond_var_.notify_all();
-                }};
-    }
-
-    std::map<uid_t, UserState> mMasterKeys;
+    static constexpr size_t kNumShards = 8;
+
+    /* Each user's state carries its own shared_mutex: readers take it shared,
+     * writers exclusive. Entries are never erased, so once an entry has been
+     * located under the shard mutex its address and mutex stay valid and the
+     * shard mutex can be dropped before blocking on the entry. */
+    struct Entry {
+        explicit Entry(uid_t userId) : state(userId) {}
+        UserState state;
+        std::shared_mutex mutex;
+    };
+
+    /* The map is sharded by user id with a lock per shard, so requests for
+     * different users only contend when they hash to the same shard. std::map
+     * entries are node based, so handed-out UserState pointers stay valid while
+     * other entries of the shard come and go. */
+    struct Shard {
+        std::mutex mutex;
+        std::map<uid_t, Entry> master_keys;
+    };
+
+    Shard& getShard(uid_t userId) const { return shards_[userId % kNumShards]; }
+
+    mutable Shard shards_[kNumShards];
 };
 
 }  //  namespace keystore
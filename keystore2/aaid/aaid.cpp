@@ -18,25 +18,30 @@
 
 #include <keystore/keystore_attestation_id.h>
 
-using android::security::gather_attestation_application_id;
+using android::security::gather_attestation_application_id_shared;
+using android::security::invalidate_attestation_application_id_cache;
 
-uint32_t aaid_keystore_attestation_id(uint32_t uid, uint8_t* aaid, size_t* aaid_size) {
+using AaidHandle = std::shared_ptr<const std::vector<uint8_t>>;
+
+uint32_t aaid_keystore_attestation_id_acquire(uint32_t uid, const uint8_t** aaid,
+                                              size_t* aaid_size, void** handle) {
     static_assert(sizeof(uint32_t) == sizeof(uid_t), "uid_t has unexpected size");
     static_assert(sizeof(uint32_t) == sizeof(android::status_t), "status_t has unexpected size");
-    static_assert(KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE ==
-                      android::security::KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE,
-                  "KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE sizes don't match.");
-    auto result = gather_attestation_application_id(uid);
+    auto result = gather_attestation_application_id_shared(uid);
     if (!result.isOk()) {
         return result.status();
     }
-    if (result.value().size() > KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE) {
-        return ::android::NO_MEMORY;
-    }
-    if (*aaid_size != KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE) {
-        return ::android::BAD_VALUE;
-    }
-    std::copy(result.value().begin(), result.value().end(), aaid);
-    *aaid_size = result.value().size();
+    auto* shared = new AaidHandle(std::move(result).value());
+    *aaid = (*shared)->data();
+    *aaid_size = (*shared)->size();
+    *handle = shared;
     return ::android::OK;
 }
+
+void aaid_keystore_attestation_id_release(void* handle) {
+    delete static_cast<AaidHandle*>(handle);
+}
+
+void aaid_keystore_attestation_id_invalidate(uint32_t uid) {
+    invalidate_attestation_application_id_cache(uid);
+}
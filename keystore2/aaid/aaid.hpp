@@ -18,27 +18,38 @@
 #include <stdint.h>
 #include <stddef.h>
 
-/**
- * This is a redefinition of KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE in
- * system/security/keystore/keystore_attestation_id.h and must be kept in sync.
- * There is a static assert in aaid.cpp to assure that they are in sync.
- * We redefine this here to avoid unnecessary build dependencies for
- * the rust bindgen target.
- */
-constexpr const size_t KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE = 1024;
-
 extern "C" {
     /**
-     * Fills the buffer at aaid with the attestation application id of the app uid.
-     * The buffer must be exactly KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE bytes in size.
-     * *aaid_size is set to the number of bytes written to aaid.
+     * Borrows the attestation application id of the app uid without copying it.
+     * On success *aaid and *aaid_size describe the DER encoded attestation id and
+     * *handle is set to an opaque handle that keeps the bytes alive. The caller
+     * must pass the handle to aaid_keystore_attestation_id_release exactly once
+     * when done; *aaid must not be dereferenced after that. On a cache hit the
+     * returned bytes are shared with the cache, so no copy is made anywhere.
      *
      * @param uid the uid of the app to retrieve the aaid for.
-     * @param aaid output buffer for the attestation id.
-     * @param aaid_size must be set to the size of the output buffer, which must be exactly
-     *          KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE bytes in size, by the caller. On success
-     *          it is set to the number of bytes written.
+     * @param aaid output parameter, set to the borrowed attestation id bytes.
+     * @param aaid_size output parameter, set to the size of the attestation id.
+     * @param handle output parameter, set to the handle owning the bytes.
      * @return OK on success.
      */
-    uint32_t aaid_keystore_attestation_id(uint32_t uid, uint8_t* aaid, size_t* aaid_size);
+    uint32_t aaid_keystore_attestation_id_acquire(uint32_t uid, const uint8_t** aaid,
+                                                  size_t* aaid_size, void** handle);
+
+    /**
+     * Releases a handle returned by a successful aaid_keystore_attestation_id_acquire
+     * call. The bytes borrowed through that call become invalid.
+     *
+     * @param handle the handle to release.
+     */
+    void aaid_keystore_attestation_id_release(void* handle);
+
+    /**
+     * Drops the cached attestation application id for the given uid. Must be called when
+     * the platform reports a package change for the uid, so the next attestation
+     * re-queries the package manager.
+     *
+     * @param uid the uid of the app whose cache entry should be dropped.
+     */
+    void aaid_keystore_attestation_id_invalidate(uint32_t uid);
 }
@@ -15,21 +15,43 @@
 //! Rust binding for getting the attestation application id.
 
 use keystore2_aaid_bindgen::{
-    aaid_keystore_attestation_id, KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE,
+    aaid_keystore_attestation_id_acquire, aaid_keystore_attestation_id_invalidate,
+    aaid_keystore_attestation_id_release,
 };
 
 /// Returns the attestation application id for the given uid or an error code
 /// corresponding to ::android::status_t.
 pub fn get_aaid(uid: u32) -> Result<Vec<u8>, u32> {
-    let mut buffer = [0u8; KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE];
-    let mut size = KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE;
+    let mut data: *const u8 = std::ptr::null();
+    let mut size: usize = 0;
+    let mut handle: *mut std::os::raw::c_void = std::ptr::null_mut();
     // Safety:
-    // aaid_keystore_attestation_id expects a buffer of exactly
-    // KEY_ATTESTATION_APPLICATION_ID_MAX_SIZE bytes and returns the number of bytes written
-    // in the second pointer argument.
-    let status = unsafe { aaid_keystore_attestation_id(uid, buffer.as_mut_ptr(), &mut size) };
-    match status {
-        0 => Ok(buffer[0..size as usize].to_vec()),
-        status => Err(status),
+    // On success aaid_keystore_attestation_id_acquire points data at size bytes
+    // that stay valid until handle is released, and sets handle to the owner of
+    // those bytes.
+    let status = unsafe {
+        aaid_keystore_attestation_id_acquire(uid, &mut data, &mut size, &mut handle)
+    };
+    if status != 0 {
+        return Err(status);
     }
+    // Safety:
+    // data points to size initialized bytes which are kept alive by handle, which
+    // has not been released yet.
+    let aaid = unsafe { std::slice::from_raw_parts(data, size) }.to_vec();
+    // Safety:
+    // handle was returned by a successful acquire call above and is released
+    // exactly once.
+    unsafe { aaid_keystore_attestation_id_release(handle) };
+    Ok(aaid)
+}
+
+/// Drops the cached attestation application id for the given uid. Must be called
+/// when the platform reports a package change for the uid, so the next attestation
+/// re-queries the package manager.
+pub fn invalidate_aaid(uid: u32) {
+    // Safety:
+    // aaid_keystore_attestation_id_invalidate takes the uid by value and has no
+    // failure mode.
+    unsafe { aaid_keystore_attestation_id_invalidate(uid) };
 }
@@ -19,6 +19,8 @@
 #include <android/hardware/confirmationui/1.0/IConfirmationUI.h>
 #include <hwbinder/IBinder.h>
 
+#include <string.h>
+
 #include <memory>
 #include <string>
 #include <thread>
@@ -30,6 +32,7 @@ namespace keystore2 {
 
 using android::sp;
 using android::hardware::hidl_death_recipient;
+using android::hardware::hidl_string;
 using android::hardware::hidl_vec;
 using android::hardware::Return;
 using android::hardware::Status;
@@ -62,10 +65,50 @@ static uint32_t responseCode2Compat(ResponseCode rc) {
     }
 }
 
+// Process-wide cache of the IConfirmationUI service proxy. Discovery through
+// hwservicemanager adds tens of milliseconds of jitter to the first byte of a
+// confirmation prompt, and the compat layer re-acquires the service around
+// every prompt life cycle. The cached proxy is dropped when the confirmationui
+// daemon dies, so the next prompt discovers a fresh one.
+class ConfuiServiceCache : public hidl_death_recipient {
+  public:
+    static sp<IConfirmationUI> get() {
+        static sp<ConfuiServiceCache> instance = new ConfuiServiceCache;
+        {
+            auto lock = std::lock_guard(instance->service_lock_);
+            if (instance->service_) {
+                return instance->service_;
+            }
+        }
+        sp<IConfirmationUI> service = IConfirmationUI::tryGetService();
+        if (!service) {
+            return nullptr;
+        }
+        // Only cache the proxy if the death recipient is in place; otherwise
+        // a dead proxy could be handed out indefinitely.
+        auto linked = service->linkToDeath(instance, 0);
+        if (linked.isOk() && linked) {
+            auto lock = std::lock_guard(instance->service_lock_);
+            instance->service_ = service;
+        }
+        return service;
+    }
+
+    void serviceDied(uint64_t /* cookie */,
+                     const ::android::wp<::android::hidl::base::V1_0::IBase>& /* who */) override {
+        auto lock = std::lock_guard(service_lock_);
+        service_ = nullptr;
+    }
+
+  private:
+    std::mutex service_lock_;
+    sp<IConfirmationUI> service_;
+};
+
 class ConfuiCompatSession : public IConfirmationResultCallback, public hidl_death_recipient {
   public:
     static sp<ConfuiCompatSession>* tryGetService() {
-        sp<IConfirmationUI> service = IConfirmationUI::tryGetService();
+        sp<IConfirmationUI> service = ConfuiServiceCache::get();
         if (service) {
             return new sp(new ConfuiCompatSession(std::move(service)));
         } else {
@@ -76,16 +119,26 @@ class ConfuiCompatSession : public IConfirmationResultCallback, public hidl_deat
     uint32_t promptUserConfirmation(ApcCompatCallback callback, const char* prompt_text,
                                     const uint8_t* extra_data, size_t extra_data_size,
                                     const char* locale, ApcCompatUiOptions ui_options) {
-        std::string hidl_prompt(prompt_text);
-        std::vector<uint8_t> hidl_extra(extra_data, extra_data + extra_data_size);
-        std::string hidl_locale(locale);
-        std::vector<UIOption> hidl_ui_options;
+        // The HIDL proxy serializes its arguments before the call returns,
+        // and the caller's buffers stay valid for the duration of the call,
+        // so the hidl types can wrap them with setToExternal instead of
+        // copying the prompt, extra data and locale into fresh allocations.
+        hidl_string hidl_prompt;
+        hidl_prompt.setToExternal(prompt_text, strlen(prompt_text));
+        hidl_vec<uint8_t> hidl_extra;
+        hidl_extra.setToExternal(const_cast<uint8_t*>(extra_data), extra_data_size);
+        hidl_string hidl_locale;
+        hidl_locale.setToExternal(locale, strlen(locale));
+        UIOption ui_option_buf[2];
+        size_t num_ui_options = 0;
         if (ui_options.inverted) {
-            hidl_ui_options.push_back(UIOption::AccessibilityInverted);
+            ui_option_buf[num_ui_options++] = UIOption::AccessibilityInverted;
         }
         if (ui_options.magnified) {
-            hidl_ui_options.push_back(UIOption::AccessibilityMagnified);
+            ui_option_buf[num_ui_options++] = UIOption::AccessibilityMagnified;
         }
+        hidl_vec<UIOption> hidl_ui_options;
+        hidl_ui_options.setToExternal(ui_option_buf, num_ui_options);
         auto lock = std::lock_guard(callback_lock_);
         if (callback_.result != nullptr) {
             return APC_COMPAT_ERROR_OPERATION_PENDING;
@@ -179,6 +232,12 @@ ApcCompatServiceHandle tryGetUserConfirmationService() {
     return reinterpret_cast<ApcCompatServiceHandle>(ConfuiCompatSession::tryGetService());
 }
 
+void prewarmUserConfirmationService() {
+    // Resolve and cache the service proxy so the first prompt doesn't pay for
+    // discovery. Failure is fine; the next prompt simply retries.
+    ConfuiServiceCache::get();
+}
+
 uint32_t promptUserConfirmation(ApcCompatServiceHandle handle, ApcCompatCallback callback,
                                 const char* prompt_text, const uint8_t* extra_data,
                                 size_t extra_data_size, char const* locale,
@@ -89,6 +89,14 @@ struct ApcCompatCallback {
  */
 ApcCompatServiceHandle tryGetUserConfirmationService();
 
+/**
+ * Resolves the confirmationui HIDL backend and caches the connection, so that
+ * a subsequent `tryGetUserConfirmationService` call does not pay for service
+ * discovery. Intended to be called once at process startup; failures are
+ * ignored and the next prompt simply retries discovery.
+ */
+void prewarmUserConfirmationService();
+
 /**
  * Attempts to start a protected confirmation session on the given service handle.
  * The function takes ownership of the callback object (`cb`) IFF APC_COMPAT_ERROR_OK
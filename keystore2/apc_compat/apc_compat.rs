@@ -19,8 +19,9 @@
 //! client.
 
 use keystore2_apc_compat_bindgen::{
-    abortUserConfirmation, closeUserConfirmationService, promptUserConfirmation, size_t,
-    tryGetUserConfirmationService, ApcCompatCallback, ApcCompatServiceHandle,
+    abortUserConfirmation, closeUserConfirmationService, prewarmUserConfirmationService,
+    promptUserConfirmation, size_t, tryGetUserConfirmationService, ApcCompatCallback,
+    ApcCompatServiceHandle,
 };
 pub use keystore2_apc_compat_bindgen::{
     ApcCompatUiOptions, APC_COMPAT_ERROR_ABORTED, APC_COMPAT_ERROR_CANCELLED,
@@ -29,6 +30,17 @@ pub use keystore2_apc_compat_bindgen::{
 };
 use std::{ffi::CString, slice};
 
+/// Resolves the confirmationui backend and caches the connection, so that the
+/// first prompt does not pay for HIDL service discovery. Intended to be called
+/// once at process startup; failures are ignored and the next prompt simply
+/// retries discovery.
+pub fn prewarm_user_confirmation_service() {
+    // # Safety:
+    // `prewarmUserConfirmationService` takes no arguments, transfers no
+    // ownership, and has no failure mode.
+    unsafe { prewarmUserConfirmationService() };
+}
+
 /// Safe wrapper around the ConfirmationUI HIDL spec.
 ///
 /// # Example
@@ -203,6 +203,9 @@ impl ApcManager {
     pub fn new_native_binder(
         confirmation_token_sender: Sender<Vec<u8>>,
     ) -> Result<Strong<dyn IProtectedConfirmation>> {
+        // Resolve and cache the confirmation UI backend off the critical
+        // path, so the first prompt doesn't pay for HIDL service discovery.
+        std::thread::spawn(keystore2_apc_compat::prewarm_user_confirmation_service);
         Ok(BnProtectedConfirmation::new_binder(
             Self { state: Arc::new(Mutex::new(ApcState::new(confirmation_token_sender))) },
             BinderFeatures { set_requesting_sid: true, ..BinderFeatures::default() },
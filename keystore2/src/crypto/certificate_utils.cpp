@@ -21,8 +21,14 @@
 #include <openssl/mem.h>
 #include <openssl/x509v3.h>
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <future>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <variant>
 #include <vector>
 
@@ -51,6 +57,38 @@ DEFINE_OPENSSL_OBJECT_POINTER(BIGNUM);
 
 constexpr const char kDefaultCommonName[] = "Default Common Name";
 
+// Keystore-issued certificates share their structure and most field values, so the invariant
+// pieces below are built a single time and copied into each new certificate by the X509 setters
+// (which all take copies). A full dup-and-patch X509 skeleton was considered instead, but an
+// unsigned skeleton does not survive the i2d/d2i round trip X509_dup performs, and since the
+// setters copy anyway, caching the sub-objects bounds issuance cost by the same amount.
+
+static const X509_NAME* defaultSubjectName() {
+    static X509_NAME* defaultName = []() -> X509_NAME* {
+        X509_NAME_Ptr name(X509_NAME_new());
+        if (!name ||
+            !X509_NAME_add_entry_by_txt(name.get(), "CN", MBSTRING_ASC,
+                                        reinterpret_cast<const uint8_t*>(kDefaultCommonName),
+                                        sizeof(kDefaultCommonName) - 1, -1 /* loc */, 0 /* set */)) {
+            return nullptr;
+        }
+        return name.release();
+    }();
+    return defaultName;
+}
+
+static const ASN1_INTEGER* zeroSerialNumber() {
+    static ASN1_INTEGER* serial = []() -> ASN1_INTEGER* {
+        ASN1_INTEGER* result = ASN1_INTEGER_new();
+        if (result && !ASN1_INTEGER_set(result, 0)) {
+            ASN1_INTEGER_free(result);
+            return nullptr;
+        }
+        return result;
+    }();
+    return serial;
+}
+
 std::variant<CertUtilsError, X509_NAME_Ptr>
 makeCommonName(std::optional<std::reference_wrapper<const std::vector<uint8_t>>> name) {
     if (name) {
@@ -62,15 +100,13 @@ makeCommonName(std::optional<std::reference_wrapper<const std::vector<uint8_t>>>
         return x509_name;
     }
 
-    X509_NAME_Ptr x509_name(X509_NAME_new());
+    if (!defaultSubjectName()) {
+        return CertUtilsError::BoringSsl;
+    }
+    X509_NAME_Ptr x509_name(X509_NAME_dup(const_cast<X509_NAME*>(defaultSubjectName())));
     if (!x509_name) {
         return CertUtilsError::MemoryAllocation;
     }
-    if (!X509_NAME_add_entry_by_txt(x509_name.get(), "CN", MBSTRING_ASC,
-                                    reinterpret_cast<const uint8_t*>(kDefaultCommonName),
-                                    sizeof(kDefaultCommonName) - 1, -1 /* loc */, 0 /* set */)) {
-        return CertUtilsError::BoringSsl;
-    }
     return x509_name;
 }
 
@@ -208,6 +244,39 @@ std::optional<std::array<char, 16>> toTimeString(int64_t timeMillis) {
     return buffer;
 }
 
+// Returns an ASN1_TIME for the given timestamp, remembering the most recently used values.
+// Issuance bursts stamp every certificate with the same activation and expiry dates, so the
+// gmtime/snprintf conversion in toTimeString runs once per distinct timestamp instead of twice
+// per certificate. The returned object is a private copy owned by the caller.
+static std::variant<CertUtilsError, ASN1_TIME_Ptr> makeValidityTime(int64_t timeMillis) {
+    constexpr size_t kTimeCacheCapacity = 16;
+    static std::mutex cacheMutex;
+    static std::map<int64_t, ASN1_TIME_Ptr> cache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto i = cache.find(timeMillis);
+    if (i == cache.end()) {
+        auto timeStr = toTimeString(timeMillis);
+        if (!timeStr) {
+            return CertUtilsError::TimeError;
+        }
+        ASN1_TIME_Ptr time(ASN1_TIME_new());
+        if (!time || !ASN1_TIME_set_string(time.get(), timeStr->data())) {
+            return CertUtilsError::BoringSsl;
+        }
+        if (cache.size() >= kTimeCacheCapacity) {
+            cache.clear();
+        }
+        i = cache.emplace(timeMillis, std::move(time)).first;
+    }
+    // ASN1_TIME is an ASN1_STRING, so a plain string dup makes a usable copy.
+    ASN1_TIME_Ptr result(ASN1_STRING_dup(i->second.get()));
+    if (!result) {
+        return CertUtilsError::MemoryAllocation;
+    }
+    return result;
+}
+
 // Creates a rump certificate structure with serial, subject and issuer names, as well as
 // activation and expiry date.
 // Callers should pass an empty X509_Ptr and check the return value for CertUtilsError::Ok (0)
@@ -229,55 +298,60 @@ makeCertRump(std::optional<std::reference_wrapper<const std::vector<uint8_t>>> s
         return CertUtilsError::BoringSsl;
     }
 
-    BIGNUM_Ptr bn_serial;
+    // Set the certificate serialNumber
     if (serial) {
-        bn_serial = BIGNUM_Ptr(BN_bin2bn(serial->get().data(), serial->get().size(), nullptr));
+        BIGNUM_Ptr bn_serial(BN_bin2bn(serial->get().data(), serial->get().size(), nullptr));
         if (!bn_serial) {
             return CertUtilsError::MemoryAllocation;
         }
+        ASN1_INTEGER_Ptr serialNumber(ASN1_INTEGER_new());
+        if (!serialNumber || !BN_to_ASN1_INTEGER(bn_serial.get(), serialNumber.get()) ||
+            !X509_set_serialNumber(certificate.get(),
+                                   serialNumber.get() /* Don't release; copied */))
+            return CertUtilsError::BoringSsl;
     } else {
-        bn_serial = BIGNUM_Ptr(BN_new());
-        if (!bn_serial) {
-            return CertUtilsError::MemoryAllocation;
-        }
-        BN_zero(bn_serial.get());
+        // The default serial is invariant; the setter copies the shared instance.
+        if (!zeroSerialNumber() ||
+            !X509_set_serialNumber(certificate.get(),
+                                   const_cast<ASN1_INTEGER*>(zeroSerialNumber())))
+            return CertUtilsError::BoringSsl;
     }
 
-    // Set the certificate serialNumber
-    ASN1_INTEGER_Ptr serialNumber(ASN1_INTEGER_new());
-    if (!serialNumber || !BN_to_ASN1_INTEGER(bn_serial.get(), serialNumber.get()) ||
-        !X509_set_serialNumber(certificate.get(), serialNumber.get() /* Don't release; copied */))
-        return CertUtilsError::BoringSsl;
-
     // Set Subject Name
-    auto subjectName = makeCommonName(subject);
-    if (auto x509_subject = std::get_if<X509_NAME_Ptr>(&subjectName)) {
-        if (!X509_set_subject_name(certificate.get(), x509_subject->get() /* copied */)) {
-            return CertUtilsError::BoringSsl;
+    if (subject) {
+        auto subjectName = makeCommonName(subject);
+        if (auto x509_subject = std::get_if<X509_NAME_Ptr>(&subjectName)) {
+            if (!X509_set_subject_name(certificate.get(), x509_subject->get() /* copied */)) {
+                return CertUtilsError::BoringSsl;
+            }
+        } else {
+            return std::get<CertUtilsError>(subjectName);
         }
     } else {
-        return std::get<CertUtilsError>(subjectName);
+        // The default subject is invariant; the setter copies the shared instance.
+        if (!defaultSubjectName() ||
+            !X509_set_subject_name(certificate.get(),
+                                   const_cast<X509_NAME*>(defaultSubjectName()))) {
+            return CertUtilsError::BoringSsl;
+        }
     }
 
-    auto notBeforeTime = toTimeString(activeDateTimeMilliSeconds);
-    if (!notBeforeTime) {
-        return CertUtilsError::TimeError;
-    }
     // Set activation date.
-    ASN1_TIME_Ptr notBefore(ASN1_TIME_new());
-    if (!notBefore || !ASN1_TIME_set_string(notBefore.get(), notBeforeTime->data()) ||
-        !X509_set_notBefore(certificate.get(), notBefore.get() /* Don't release; copied */))
+    auto notBeforeV = makeValidityTime(activeDateTimeMilliSeconds);
+    if (auto error = std::get_if<CertUtilsError>(&notBeforeV)) {
+        return *error;
+    }
+    auto notBefore = std::move(std::get<ASN1_TIME_Ptr>(notBeforeV));
+    if (!X509_set_notBefore(certificate.get(), notBefore.get() /* Don't release; copied */))
         return CertUtilsError::BoringSsl;
 
     // Set expiration date.
-    auto notAfterTime = toTimeString(usageExpireDateTimeMilliSeconds);
-    if (!notAfterTime) {
-        return CertUtilsError::TimeError;
+    auto notAfterV = makeValidityTime(usageExpireDateTimeMilliSeconds);
+    if (auto error = std::get_if<CertUtilsError>(&notAfterV)) {
+        return *error;
     }
-
-    ASN1_TIME_Ptr notAfter(ASN1_TIME_new());
-    if (!notAfter || !ASN1_TIME_set_string(notAfter.get(), notAfterTime->data()) ||
-        !X509_set_notAfter(certificate.get(), notAfter.get() /* Don't release; copied */)) {
+    auto notAfter = std::move(std::get<ASN1_TIME_Ptr>(notAfterV));
+    if (!X509_set_notAfter(certificate.get(), notAfter.get() /* Don't release; copied */)) {
         return CertUtilsError::BoringSsl;
     }
 
@@ -409,18 +483,33 @@ CertUtilsError signCert(X509* certificate, EVP_PKEY* signing_key) {
     return CertUtilsError::Ok;
 }
 
-std::variant<CertUtilsError, std::vector<uint8_t>> encodeCert(X509* certificate) {
+CertUtilsError encodeCertInto(X509* certificate, std::vector<uint8_t>* buffer) {
+    if (certificate == nullptr || buffer == nullptr) {
+        return CertUtilsError::UnexpectedNullPointer;
+    }
+
     int len = i2d_X509(certificate, nullptr);
     if (len < 0) {
         return CertUtilsError::BoringSsl;
     }
 
-    auto result = std::vector<uint8_t>(len);
-    uint8_t* p = result.data();
+    // Appends behind any bytes already present, so a chain can be encoded into
+    // one buffer; the resize reuses the caller's capacity where possible.
+    size_t offset = buffer->size();
+    buffer->resize(offset + len);
+    uint8_t* p = buffer->data() + offset;
 
     if (i2d_X509(certificate, &p) < 0) {
         return CertUtilsError::BoringSsl;
     }
+    return CertUtilsError::Ok;
+}
+
+std::variant<CertUtilsError, std::vector<uint8_t>> encodeCert(X509* certificate) {
+    std::vector<uint8_t> result;
+    if (auto error = encodeCertInto(certificate, &result)) {
+        return error;
+    }
     return result;
 }
 
@@ -470,7 +559,7 @@ static CertUtilsError setSaltLength(RSA_PSS_PARAMS* pss_params, unsigned length)
     return CertUtilsError::Ok;
 }
 
-std::variant<CertUtilsError, ASN1_STRING_Ptr> buildRsaPssParameter(Digest digest) {
+static std::variant<CertUtilsError, ASN1_STRING_Ptr> buildRsaPssParameterUncached(Digest digest) {
     RSA_PSS_PARAMS_Ptr pss(RSA_PSS_PARAMS_new());
     if (!pss) {
         return CertUtilsError::MemoryAllocation;
@@ -517,77 +606,127 @@ std::variant<CertUtilsError, ASN1_STRING_Ptr> buildRsaPssParameter(Digest digest
     return ASN1_STRING_Ptr(algo_str);
 }
 
-CertUtilsError makeAndSetAlgo(X509_ALGOR* algo_field, Algo algo, Padding padding, Digest digest) {
-    if (algo_field == nullptr) {
-        return CertUtilsError::UnexpectedNullPointer;
+std::variant<CertUtilsError, ASN1_STRING_Ptr> buildRsaPssParameter(Digest digest) {
+    // The packed parameter structure depends only on the digest, so it is
+    // built once per digest and duplicated per certificate.
+    static std::mutex cacheMutex;
+    static std::map<Digest, ASN1_STRING_Ptr> cache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto i = cache.find(digest);
+    if (i == cache.end()) {
+        auto result = buildRsaPssParameterUncached(digest);
+        if (auto error = std::get_if<CertUtilsError>(&result)) {
+            return *error;
+        }
+        i = cache.emplace(digest, std::move(std::get<ASN1_STRING_Ptr>(result))).first;
     }
-    ASN1_STRING_Ptr param;
-    int param_type = V_ASN1_UNDEF;
-    int nid = 0;
+    ASN1_STRING_Ptr param(ASN1_STRING_dup(i->second.get()));
+    if (!param) {
+        return CertUtilsError::MemoryAllocation;
+    }
+    return param;
+}
+
+// The (algo, padding, digest) triplet maps to a signature algorithm NID and an ASN.1 parameter
+// type by pure enum arithmetic, so the mapping is resolved by the constexpr functions below — at
+// compile time where the triplet is constant, and as one flat branch-free lookup otherwise.
+// NID_undef marks invalid combinations. The only runtime object construction left in
+// makeAndSetAlgo is duplicating the cached pre-encoded RSA-PSS parameter string.
+
+static constexpr int sigAlgNid(Algo algo, Padding padding, Digest digest) {
     switch (algo) {
     case Algo::ECDSA:
         switch (digest) {
         case Digest::SHA1:
-            nid = NID_ecdsa_with_SHA1;
-            break;
+            return NID_ecdsa_with_SHA1;
         case Digest::SHA224:
-            nid = NID_ecdsa_with_SHA224;
-            break;
+            return NID_ecdsa_with_SHA224;
         case Digest::SHA256:
-            nid = NID_ecdsa_with_SHA256;
-            break;
+            return NID_ecdsa_with_SHA256;
         case Digest::SHA384:
-            nid = NID_ecdsa_with_SHA384;
-            break;
+            return NID_ecdsa_with_SHA384;
         case Digest::SHA512:
-            nid = NID_ecdsa_with_SHA512;
-            break;
+            return NID_ecdsa_with_SHA512;
         default:
-            return CertUtilsError::InvalidArgument;
+            return NID_undef;
         }
-        break;
     case Algo::RSA:
         switch (padding) {
         case Padding::PKCS1_5:
-            param_type = V_ASN1_NULL;
             switch (digest) {
             case Digest::SHA1:
-                nid = NID_sha1WithRSAEncryption;
-                break;
+                return NID_sha1WithRSAEncryption;
             case Digest::SHA224:
-                nid = NID_sha224WithRSAEncryption;
-                break;
+                return NID_sha224WithRSAEncryption;
             case Digest::SHA256:
-                nid = NID_sha256WithRSAEncryption;
-                break;
+                return NID_sha256WithRSAEncryption;
             case Digest::SHA384:
-                nid = NID_sha384WithRSAEncryption;
-                break;
+                return NID_sha384WithRSAEncryption;
             case Digest::SHA512:
-                nid = NID_sha512WithRSAEncryption;
-                break;
+                return NID_sha512WithRSAEncryption;
             default:
-                return CertUtilsError::InvalidArgument;
+                return NID_undef;
             }
-            break;
-        case Padding::PSS: {
-            auto v = buildRsaPssParameter(digest);
-            if (auto param_str = std::get_if<ASN1_STRING_Ptr>(&v)) {
-                param = std::move(*param_str);
-                param_type = V_ASN1_SEQUENCE;
-                nid = NID_rsassaPss;
-            } else {
-                return std::get<CertUtilsError>(v);
+        case Padding::PSS:
+            switch (digest) {
+            case Digest::SHA1:
+            case Digest::SHA224:
+            case Digest::SHA256:
+            case Digest::SHA384:
+            case Digest::SHA512:
+                return NID_rsassaPss;
+            default:
+                return NID_undef;
             }
-            break;
-        }
         default:
-            return CertUtilsError::InvalidArgument;
+            return NID_undef;
         }
-        break;
     default:
+        return NID_undef;
+    }
+}
+
+static constexpr int sigAlgParamType(Algo algo, Padding padding) {
+    if (algo == Algo::RSA && padding == Padding::PKCS1_5) {
+        return V_ASN1_NULL;
+    }
+    if (algo == Algo::RSA && padding == Padding::PSS) {
+        return V_ASN1_SEQUENCE;
+    }
+    return V_ASN1_UNDEF;
+}
+
+// Spot-check the compile-time mapping.
+static_assert(sigAlgNid(Algo::ECDSA, Padding::Ignored, Digest::SHA256) == NID_ecdsa_with_SHA256);
+static_assert(sigAlgNid(Algo::RSA, Padding::PKCS1_5, Digest::SHA512) ==
+              NID_sha512WithRSAEncryption);
+static_assert(sigAlgNid(Algo::RSA, Padding::PSS, Digest::SHA256) == NID_rsassaPss);
+static_assert(sigAlgNid(Algo::RSA, Padding::Ignored, Digest::SHA256) == NID_undef);
+static_assert(sigAlgParamType(Algo::RSA, Padding::PKCS1_5) == V_ASN1_NULL);
+static_assert(sigAlgParamType(Algo::ECDSA, Padding::Ignored) == V_ASN1_UNDEF);
+
+CertUtilsError makeAndSetAlgo(X509_ALGOR* algo_field, Algo algo, Padding padding, Digest digest) {
+    if (algo_field == nullptr) {
+        return CertUtilsError::UnexpectedNullPointer;
+    }
+
+    const int nid = sigAlgNid(algo, padding, digest);
+    if (nid == NID_undef) {
         return CertUtilsError::InvalidArgument;
     }
+    const int param_type = sigAlgParamType(algo, padding);
+
+    ASN1_STRING_Ptr param;
+    if (param_type == V_ASN1_SEQUENCE) {
+        // PSS parameters are pre-encoded once per digest and duplicated here.
+        auto v = buildRsaPssParameter(digest);
+        if (auto param_str = std::get_if<ASN1_STRING_Ptr>(&v)) {
+            param = std::move(*param_str);
+        } else {
+            return std::get<CertUtilsError>(v);
+        }
+    }
 
     if (!X509_ALGOR_set0(algo_field, OBJ_nid2obj(nid), param_type, param.get())) {
         return CertUtilsError::Encoding;
@@ -630,4 +769,39 @@ CertUtilsError signCertWith(X509* certificate,
     return CertUtilsError::Ok;
 }
 
+std::vector<CertUtilsError>
+signCertBatchWith(const std::vector<X509*>& certificates,
+                  std::function<std::vector<uint8_t>(const uint8_t*, size_t)> sign, Algo algo,
+                  Padding padding, Digest digest) {
+    std::vector<CertUtilsError> results(certificates.size(), CertUtilsError::Ok);
+    if (certificates.empty()) {
+        return results;
+    }
+
+    // Work stealing by atomic index; each worker signs whole certificates. The calling thread
+    // participates, so extra threads are only spawned when there is enough work to share.
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        for (size_t i = nextIndex.fetch_add(1); i < certificates.size();
+             i = nextIndex.fetch_add(1)) {
+            results[i] = signCertWith(certificates[i], sign, algo, padding, digest);
+        }
+    };
+
+    size_t hwThreads = std::thread::hardware_concurrency();
+    size_t extraWorkers = std::min(certificates.size() - 1, hwThreads > 0 ? hwThreads - 1 : 0);
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(extraWorkers);
+    for (size_t i = 0; i < extraWorkers; ++i) {
+        futures.push_back(std::async(std::launch::async, worker));
+    }
+    worker();
+    for (auto& future : futures) {
+        future.wait();
+    }
+
+    return results;
+}
+
 }  // namespace keystore
@@ -20,20 +20,29 @@
 
 #include <log/log.h>
 #include <openssl/aes.h>
+#include <openssl/bytestring.h>
 #include <openssl/ec.h>
 #include <openssl/ec_key.h>
 #include <openssl/ecdh.h>
 #include <openssl/evp.h>
 #include <openssl/hkdf.h>
+#include <openssl/mem.h>
 #include <openssl/rand.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <mutex>
 #include <vector>
 
 // Copied from system/security/keystore/blob.h.
 
 constexpr size_t kGcmTagLength = 128 / 8;
 constexpr size_t kAes128KeySizeBytes = 128 / 8;
+constexpr size_t kAes256KeySizeBytes = 256 / 8;
 
 // Copied from system/security/keystore/blob.cpp.
 
@@ -66,33 +75,96 @@ const EVP_CIPHER* getAesCipherForKey(size_t key_size) {
     return cipher;
 }
 
+/**
+ * A per-thread, per-direction cache of one AES-GCM cipher context. The database layer encrypts
+ * and decrypts long runs of blobs with the same per-user super key, so the expanded key schedule
+ * from the previous call is almost always reusable; caching it saves the context allocation and
+ * AES key setup on every call. The cached key copy is erased when it is replaced and when the
+ * thread exits.
+ */
+class GcmCtxCache {
+  public:
+    explicit GcmCtxCache(bool encrypt) : mEncrypt(encrypt) {}
+    ~GcmCtxCache() { clearKey(); }
+
+    /**
+     * Returns a context whose cipher and key schedule are set up for the given key, reusing the
+     * schedule from the previous call on this thread when the key is unchanged. Returns nullptr
+     * on setup failure.
+     */
+    EVP_CIPHER_CTX* get(const uint8_t* key, size_t key_size) {
+        if (mCtx && key_size == mKeySize && CRYPTO_memcmp(mKey, key, key_size) == 0) {
+            return mCtx.get();
+        }
+        if (!mCtx) {
+            mCtx.reset(EVP_CIPHER_CTX_new());
+            if (!mCtx) return nullptr;
+        }
+        clearKey();
+        const EVP_CIPHER* cipher = getAesCipherForKey(key_size);
+        int result = mEncrypt ? EVP_EncryptInit_ex(mCtx.get(), cipher, nullptr /* engine */, key,
+                                                   nullptr /* iv */)
+                              : EVP_DecryptInit_ex(mCtx.get(), cipher, nullptr /* engine */, key,
+                                                   nullptr /* iv */);
+        if (!result) {
+            mCtx.reset();
+            return nullptr;
+        }
+        // Keys larger than the cache slot cannot occur with AES, but don't write past the
+        // slot if a caller hands us one; the context is still valid for this one call.
+        if (key_size <= sizeof(mKey)) {
+            memcpy(mKey, key, key_size);
+            mKeySize = key_size;
+        }
+        return mCtx.get();
+    }
+
+  private:
+    OPTNONE void clearKey() {
+        volatile uint8_t* key = mKey;
+        std::fill(key, key + sizeof(mKey), 0);
+        mKeySize = 0;
+    }
+
+    const bool mEncrypt;
+    bssl::UniquePtr<EVP_CIPHER_CTX> mCtx;
+    uint8_t mKey[kAes256KeySizeBytes];
+    size_t mKeySize = 0;
+};
+
+/**
+ * Returns the calling thread's cached cipher context for the given direction, keyed for 'key'.
+ */
+static EVP_CIPHER_CTX* getCachedGcmCtx(bool encrypt, const uint8_t* key, size_t key_size) {
+    static thread_local GcmCtxCache encryptCtxCache(true);
+    static thread_local GcmCtxCache decryptCtxCache(false);
+    return (encrypt ? encryptCtxCache : decryptCtxCache).get(key, key_size);
+}
+
 bool randomBytes(uint8_t* out, size_t len) {
     return RAND_bytes(out, len);
 }
 
 /*
- * Encrypt 'len' data at 'in' with AES-GCM, using 128-bit or 256-bit key at 'key', 96-bit IV at
- * 'iv' and write output to 'out' (which may be the same location as 'in') and 128-bit tag to
- * 'tag'.
+ * Encrypt one buffer with a context whose cipher and key schedule have already been set up by
+ * EVP_EncryptInit_ex. Only the IV is (re)initialized here, so the key schedule is shared across
+ * consecutive calls with the same context.
  */
-bool AES_gcm_encrypt(const uint8_t* in, uint8_t* out, size_t len, const uint8_t* key,
-                     size_t key_size, const uint8_t* iv, uint8_t* tag) {
-
-    // There can be 128-bit and 256-bit keys
-    const EVP_CIPHER* cipher = getAesCipherForKey(key_size);
-
-    bssl::UniquePtr<EVP_CIPHER_CTX> ctx(EVP_CIPHER_CTX_new());
-
-    EVP_EncryptInit_ex(ctx.get(), cipher, nullptr /* engine */, key, iv);
-    EVP_CIPHER_CTX_set_padding(ctx.get(), 0 /* no padding needed with GCM */);
+static bool AES_gcm_encrypt_with_ctx(EVP_CIPHER_CTX* ctx, const uint8_t* in, uint8_t* out,
+                                     size_t len, const uint8_t* iv, uint8_t* tag) {
+    if (!EVP_EncryptInit_ex(ctx, nullptr /* cipher */, nullptr /* engine */, nullptr /* key */,
+                            iv)) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 0 /* no padding needed with GCM */);
 
     std::vector<uint8_t> out_tmp(len);
     uint8_t* out_pos = out_tmp.data();
     int out_len;
 
-    EVP_EncryptUpdate(ctx.get(), out_pos, &out_len, in, len);
+    EVP_EncryptUpdate(ctx, out_pos, &out_len, in, len);
     out_pos += out_len;
-    EVP_EncryptFinal_ex(ctx.get(), out_pos, &out_len);
+    EVP_EncryptFinal_ex(ctx, out_pos, &out_len);
     out_pos += out_len;
     if (out_pos - out_tmp.data() != static_cast<ssize_t>(len)) {
         ALOGD("Encrypted ciphertext is the wrong size, expected %zu, got %zd", len,
@@ -101,36 +173,160 @@ bool AES_gcm_encrypt(const uint8_t* in, uint8_t* out, size_t len, const uint8_t*
     }
 
     std::copy(out_tmp.data(), out_pos, out);
-    EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, kGcmTagLength, tag);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, kGcmTagLength, tag);
 
     return true;
 }
 
 /*
- * Decrypt 'len' data at 'in' with AES-GCM, using 128-bit or 256-bit key at 'key', 96-bit IV at
- * 'iv', checking 128-bit tag at 'tag' and writing plaintext to 'out'(which may be the same
- * location as 'in').
+ * Encrypt 'len' data at 'in' with AES-GCM, using 128-bit or 256-bit key at 'key', 96-bit IV at
+ * 'iv' and write output to 'out' (which may be the same location as 'in') and 128-bit tag to
+ * 'tag'.
  */
-bool AES_gcm_decrypt(const uint8_t* in, uint8_t* out, size_t len, const uint8_t* key,
-                     size_t key_size, const uint8_t* iv, const uint8_t* tag) {
+bool AES_gcm_encrypt(const uint8_t* in, uint8_t* out, size_t len, const uint8_t* key,
+                     size_t key_size, const uint8_t* iv, uint8_t* tag) {
+
+    EVP_CIPHER_CTX* ctx = getCachedGcmCtx(true /* encrypt */, key, key_size);
+    if (!ctx) {
+        return false;
+    }
+
+    return AES_gcm_encrypt_with_ctx(ctx, in, out, len, iv, tag);
+}
+
+/*
+ * Encrypt 'count' independent buffers described by 'bufs' with the same 128-bit or 256-bit key,
+ * running the cipher and key-schedule setup only once for the whole batch. Returns the number of
+ * buffers encrypted successfully; processing stops at the first failure.
+ */
+size_t AES_gcm_encrypt_batch(const AES_gcm_io* bufs, size_t count, const uint8_t* key,
+                             size_t key_size) {
+
+    EVP_CIPHER_CTX* ctx = getCachedGcmCtx(true /* encrypt */, key, key_size);
+    if (!ctx) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!AES_gcm_encrypt_with_ctx(ctx, bufs[i].in, bufs[i].out, bufs[i].len, bufs[i].iv,
+                                      bufs[i].tag)) {
+            return i;
+        }
+    }
+    return count;
+}
+
+OPTNONE static void eraseBuffer(uint8_t* buf, size_t len) {
+    volatile uint8_t* pos = buf;
+    std::fill(pos, pos + len, 0);
+}
+
+/*
+ * Encrypt a message spread over 'count' discontiguous segments with AES-GCM under one IV,
+ * writing each segment's ciphertext directly to its 'out' pointer (which may alias 'in') and the
+ * 128-bit tag to 'tag'. GCM is a stream mode, so every update produces exactly as many bytes as
+ * it consumes and no output ever spills across a segment boundary; this is checked defensively.
+ */
+bool AES_gcm_encrypt_iov(const AES_gcm_segment* segs, size_t count, const uint8_t* key,
+                         size_t key_size, const uint8_t* iv, uint8_t* tag) {
+
+    EVP_CIPHER_CTX* ctx = getCachedGcmCtx(true /* encrypt */, key, key_size);
+    if (!ctx ||
+        !EVP_EncryptInit_ex(ctx, nullptr /* cipher */, nullptr /* engine */, nullptr /* key */,
+                            iv)) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 0 /* no padding needed with GCM */);
+
+    for (size_t i = 0; i < count; ++i) {
+        int out_len;
+        if (!EVP_EncryptUpdate(ctx, segs[i].out, &out_len, segs[i].in, segs[i].len) ||
+            out_len != static_cast<int>(segs[i].len)) {
+            ALOGE("Encrypted segment is the wrong size, expected %zu, got %d", segs[i].len,
+                  out_len);
+            return false;
+        }
+    }
 
-    // There can be 128-bit and 256-bit keys
-    const EVP_CIPHER* cipher = getAesCipherForKey(key_size);
+    uint8_t final_buf[AES_BLOCK_SIZE];
+    int out_len;
+    if (!EVP_EncryptFinal_ex(ctx, final_buf, &out_len) || out_len != 0) {
+        return false;
+    }
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, kGcmTagLength, tag);
 
-    bssl::UniquePtr<EVP_CIPHER_CTX> ctx(EVP_CIPHER_CTX_new());
+    return true;
+}
 
-    EVP_DecryptInit_ex(ctx.get(), cipher, nullptr /* engine */, key, iv);
-    EVP_CIPHER_CTX_set_padding(ctx.get(), 0 /* no padding needed with GCM */);
-    EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, kGcmTagLength, const_cast<uint8_t*>(tag));
+/*
+ * Decrypt a message spread over 'count' discontiguous segments with AES-GCM under one IV,
+ * checking the 128-bit tag at 'tag' and writing each segment's plaintext directly to its 'out'
+ * pointer (which may alias 'in'). The plaintext lands in the caller's segments before the tag
+ * has been verified; if verification fails the output segments are erased and false is returned.
+ */
+bool AES_gcm_decrypt_iov(const AES_gcm_segment* segs, size_t count, const uint8_t* key,
+                         size_t key_size, const uint8_t* iv, const uint8_t* tag) {
+
+    EVP_CIPHER_CTX* ctx = getCachedGcmCtx(false /* encrypt */, key, key_size);
+    if (!ctx ||
+        !EVP_DecryptInit_ex(ctx, nullptr /* cipher */, nullptr /* engine */, nullptr /* key */,
+                            iv)) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 0 /* no padding needed with GCM */);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, kGcmTagLength, const_cast<uint8_t*>(tag));
+
+    bool success = true;
+    for (size_t i = 0; i < count && success; ++i) {
+        int out_len;
+        if (!EVP_DecryptUpdate(ctx, segs[i].out, &out_len, segs[i].in, segs[i].len) ||
+            out_len != static_cast<int>(segs[i].len)) {
+            success = false;
+        }
+    }
+
+    if (success) {
+        uint8_t final_buf[AES_BLOCK_SIZE];
+        int out_len;
+        if (!EVP_DecryptFinal_ex(ctx, final_buf, &out_len) || out_len != 0) {
+            ALOGE("Failed to decrypt blob; ciphertext or tag is likely corrupted");
+            success = false;
+        }
+    }
+
+    if (!success) {
+        // Don't leave unauthenticated plaintext behind.
+        for (size_t i = 0; i < count; ++i) {
+            eraseBuffer(segs[i].out, segs[i].len);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Decrypt one buffer with a context whose cipher and key schedule have already been set up by
+ * EVP_DecryptInit_ex. Only the IV and expected tag are (re)initialized here, so the key schedule
+ * is shared across consecutive calls with the same context.
+ */
+static bool AES_gcm_decrypt_with_ctx(EVP_CIPHER_CTX* ctx, const uint8_t* in, uint8_t* out,
+                                     size_t len, const uint8_t* iv, const uint8_t* tag) {
+    if (!EVP_DecryptInit_ex(ctx, nullptr /* cipher */, nullptr /* engine */, nullptr /* key */,
+                            iv)) {
+        return false;
+    }
+    EVP_CIPHER_CTX_set_padding(ctx, 0 /* no padding needed with GCM */);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, kGcmTagLength, const_cast<uint8_t*>(tag));
 
     std::vector<uint8_t> out_tmp(len);
     ArrayEraser out_eraser(out_tmp.data(), len);
     uint8_t* out_pos = out_tmp.data();
     int out_len;
 
-    EVP_DecryptUpdate(ctx.get(), out_pos, &out_len, in, len);
+    EVP_DecryptUpdate(ctx, out_pos, &out_len, in, len);
     out_pos += out_len;
-    if (!EVP_DecryptFinal_ex(ctx.get(), out_pos, &out_len)) {
+    if (!EVP_DecryptFinal_ex(ctx, out_pos, &out_len)) {
         ALOGE("Failed to decrypt blob; ciphertext or tag is likely corrupted");
         return false;
     }
@@ -146,6 +342,45 @@ bool AES_gcm_decrypt(const uint8_t* in, uint8_t* out, size_t len, const uint8_t*
     return true;
 }
 
+/*
+ * Decrypt 'len' data at 'in' with AES-GCM, using 128-bit or 256-bit key at 'key', 96-bit IV at
+ * 'iv', checking 128-bit tag at 'tag' and writing plaintext to 'out'(which may be the same
+ * location as 'in').
+ */
+bool AES_gcm_decrypt(const uint8_t* in, uint8_t* out, size_t len, const uint8_t* key,
+                     size_t key_size, const uint8_t* iv, const uint8_t* tag) {
+
+    EVP_CIPHER_CTX* ctx = getCachedGcmCtx(false /* encrypt */, key, key_size);
+    if (!ctx) {
+        return false;
+    }
+
+    return AES_gcm_decrypt_with_ctx(ctx, in, out, len, iv, tag);
+}
+
+/*
+ * Decrypt 'count' independent buffers described by 'bufs' with the same 128-bit or 256-bit key,
+ * running the cipher and key-schedule setup only once for the whole batch. Returns the number of
+ * buffers decrypted successfully; processing stops at the first failure, so the return value
+ * identifies the buffer whose ciphertext or tag was rejected.
+ */
+size_t AES_gcm_decrypt_batch(const AES_gcm_io* bufs, size_t count, const uint8_t* key,
+                             size_t key_size) {
+
+    EVP_CIPHER_CTX* ctx = getCachedGcmCtx(false /* encrypt */, key, key_size);
+    if (!ctx) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!AES_gcm_decrypt_with_ctx(ctx, bufs[i].in, bufs[i].out, bufs[i].len, bufs[i].iv,
+                                      bufs[i].tag)) {
+            return i;
+        }
+    }
+    return count;
+}
+
 // Copied from system/security/keystore/keymaster_enforcement.cpp.
 
 class EvpMdCtx {
@@ -159,7 +394,70 @@ class EvpMdCtx {
     EVP_MD_CTX ctx_;
 };
 
+namespace {
+
+/**
+ * A bounded cache of recently computed key ids. The enforcement layer recomputes the id of the
+ * same multi-kilobyte blob on every operation, so steady-state traffic would otherwise hash the
+ * blob over and over. Entries are keyed by a fingerprint digest over the blob's length and its
+ * first and last bytes; key blobs are AEAD ciphertexts with random IVs, so blobs agreeing on
+ * length and both ends are the same blob for all practical purposes.
+ *
+ * Lookups are lock free: each slot carries a sequence counter that is odd while a writer
+ * updates it and bumped again when the write completes, so a reader that raced a writer sees
+ * a changed (or odd) counter and skips the slot instead of trusting torn data. Writers only
+ * run on cache misses, which pay the full blob hash anyway, and serialize on a mutex.
+ */
+constexpr size_t kKeyIdFingerprintBytes = 32;
+constexpr size_t kKeyIdCacheCapacity = 32;
+
+struct KeyIdCacheEntry {
+    std::atomic<uint32_t> seq{0};  // 0 = never written, odd = write in progress
+    uint8_t fingerprint[SHA256_DIGEST_LENGTH];
+    km_id_t id;
+};
+
+std::mutex keyIdCacheWriteMutex;
+KeyIdCacheEntry keyIdCache[kKeyIdCacheCapacity];
+size_t keyIdCacheNextVictim = 0;  // guarded by keyIdCacheWriteMutex
+
+void keyIdFingerprint(uint8_t* fingerprint, const uint8_t* key_blob, size_t len) {
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    uint64_t len64 = len;
+    SHA256_Update(&ctx, &len64, sizeof(len64));
+    size_t head = len < kKeyIdFingerprintBytes ? len : kKeyIdFingerprintBytes;
+    SHA256_Update(&ctx, key_blob, head);
+    if (len > kKeyIdFingerprintBytes) {
+        size_t tail = len - kKeyIdFingerprintBytes;
+        if (tail > kKeyIdFingerprintBytes) tail = kKeyIdFingerprintBytes;
+        SHA256_Update(&ctx, key_blob + len - tail, tail);
+    }
+    SHA256_Final(fingerprint, &ctx);
+}
+
+}  // namespace
+
 bool CreateKeyId(const uint8_t* key_blob, size_t len, km_id_t* out_id) {
+    uint8_t fingerprint[SHA256_DIGEST_LENGTH];
+    keyIdFingerprint(fingerprint, key_blob, len);
+
+    for (const auto& entry : keyIdCache) {
+        uint32_t seqBefore = entry.seq.load(std::memory_order_acquire);
+        if (seqBefore == 0 || (seqBefore & 1)) continue;  // empty or mid-write
+        uint8_t cachedFingerprint[SHA256_DIGEST_LENGTH];
+        memcpy(cachedFingerprint, entry.fingerprint, sizeof(cachedFingerprint));
+        km_id_t cachedId = entry.id;
+        // Re-check the sequence counter after copying the slot; a change means a
+        // writer raced us and the copy may be torn, so it must be discarded.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry.seq.load(std::memory_order_relaxed) != seqBefore) continue;
+        if (memcmp(cachedFingerprint, fingerprint, sizeof(cachedFingerprint)) == 0) {
+            *out_id = cachedId;
+            return true;
+        }
+    }
+
     EvpMdCtx ctx;
 
     uint8_t hash[EVP_MAX_MD_SIZE];
@@ -169,6 +467,15 @@ bool CreateKeyId(const uint8_t* key_blob, size_t len, km_id_t* out_id) {
         EVP_DigestFinal_ex(ctx.get(), hash, &hash_len)) {
         assert(hash_len >= sizeof(*out_id));
         memcpy(out_id, hash, sizeof(*out_id));
+
+        std::lock_guard<std::mutex> lock(keyIdCacheWriteMutex);
+        KeyIdCacheEntry& victim = keyIdCache[keyIdCacheNextVictim];
+        keyIdCacheNextVictim = (keyIdCacheNextVictim + 1) % kKeyIdCacheCapacity;
+        victim.seq.fetch_add(1, std::memory_order_relaxed);  // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(victim.fingerprint, fingerprint, sizeof(fingerprint));
+        victim.id = *out_id;
+        victim.seq.fetch_add(1, std::memory_order_release);  // even again: publish
         return true;
     }
 
@@ -181,6 +488,90 @@ static constexpr size_t SALT_SIZE = 16;
 
 // Copied from system/security/keystore/user_state.cpp.
 
+namespace {
+
+/**
+ * A small TTL-bounded cache of recent PBKDF2 derivations. The super-key unlock path derives the
+ * same (password, salt) combination several times within one authentication sequence, and at
+ * 8192 rounds each derivation is user-visible latency. Entries are keyed by a SHA-256 digest
+ * over the derivation inputs and erased when they expire, when they are evicted, and at process
+ * exit.
+ */
+struct PbkdfCacheEntry {
+    uint8_t id[SHA256_DIGEST_LENGTH];
+    uint8_t key[kAes256KeySizeBytes];
+    size_t key_len = 0;  // 0 means the slot is empty.
+    std::chrono::steady_clock::time_point expiry;
+};
+
+constexpr size_t kPbkdfCacheCapacity = 4;
+constexpr auto kPbkdfCacheTtl = std::chrono::seconds(15);
+
+std::mutex pbkdfCacheMutex;
+PbkdfCacheEntry pbkdfCache[kPbkdfCacheCapacity];
+size_t pbkdfCacheNextVictim = 0;
+
+void pbkdfCacheId(uint8_t* id, size_t key_len, const char* pw, size_t pw_len, const uint8_t* salt,
+                  size_t saltSize) {
+    // Length-prefix each field so field boundaries are unambiguous.
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    uint64_t len = key_len;
+    SHA256_Update(&ctx, &len, sizeof(len));
+    len = pw_len;
+    SHA256_Update(&ctx, &len, sizeof(len));
+    SHA256_Update(&ctx, pw, pw_len);
+    len = saltSize;
+    SHA256_Update(&ctx, &len, sizeof(len));
+    SHA256_Update(&ctx, salt, saltSize);
+    SHA256_Final(id, &ctx);
+}
+
+void pbkdfCacheEraseEntry(PbkdfCacheEntry* entry) {
+    eraseBuffer(entry->key, sizeof(entry->key));
+    entry->key_len = 0;
+}
+
+bool pbkdfCacheLookup(const uint8_t* id, uint8_t* key, size_t key_len) {
+    std::lock_guard<std::mutex> lock(pbkdfCacheMutex);
+    auto now = std::chrono::steady_clock::now();
+    for (auto& entry : pbkdfCache) {
+        if (entry.key_len == 0) continue;
+        if (entry.expiry <= now) {
+            pbkdfCacheEraseEntry(&entry);
+            continue;
+        }
+        if (entry.key_len == key_len && CRYPTO_memcmp(entry.id, id, sizeof(entry.id)) == 0) {
+            memcpy(key, entry.key, key_len);
+            return true;
+        }
+    }
+    return false;
+}
+
+void pbkdfCacheInsert(const uint8_t* id, const uint8_t* key, size_t key_len) {
+    if (key_len > sizeof(PbkdfCacheEntry{}.key)) return;
+    std::lock_guard<std::mutex> lock(pbkdfCacheMutex);
+    PbkdfCacheEntry* victim = nullptr;
+    for (auto& entry : pbkdfCache) {
+        if (entry.key_len == 0) {
+            victim = &entry;
+            break;
+        }
+    }
+    if (victim == nullptr) {
+        victim = &pbkdfCache[pbkdfCacheNextVictim];
+        pbkdfCacheNextVictim = (pbkdfCacheNextVictim + 1) % kPbkdfCacheCapacity;
+        pbkdfCacheEraseEntry(victim);
+    }
+    memcpy(victim->id, id, sizeof(victim->id));
+    memcpy(victim->key, key, key_len);
+    victim->key_len = key_len;
+    victim->expiry = std::chrono::steady_clock::now() + kPbkdfCacheTtl;
+}
+
+}  // namespace
+
 void generateKeyFromPassword(uint8_t* key, size_t key_len, const char* pw, size_t pw_len,
                              const uint8_t* salt) {
     size_t saltSize;
@@ -193,6 +584,12 @@ void generateKeyFromPassword(uint8_t* key, size_t key_len, const char* pw, size_
         saltSize = sizeof("keystore");
     }
 
+    uint8_t id[SHA256_DIGEST_LENGTH];
+    pbkdfCacheId(id, key_len, pw, pw_len, salt, saltSize);
+    if (pbkdfCacheLookup(id, key, key_len)) {
+        return;
+    }
+
     const EVP_MD* digest = EVP_sha256();
 
     // SHA1 was used prior to increasing the key size
@@ -201,6 +598,8 @@ void generateKeyFromPassword(uint8_t* key, size_t key_len, const char* pw, size_
     }
 
     PKCS5_PBKDF2_HMAC(pw, pw_len, salt, saltSize, 8192, digest, key_len, key);
+
+    pbkdfCacheInsert(id, key, key_len);
 }
 
 // New code.
@@ -219,23 +618,115 @@ bool HKDFExpand(uint8_t* out_key, size_t out_len, const uint8_t* prk, size_t prk
     return result == 1;
 }
 
+bool HKDFExtractAndExpand(uint8_t* out_key, size_t out_len, const uint8_t* secret,
+                          size_t secret_len, const uint8_t* salt, size_t salt_len,
+                          const uint8_t* info, size_t info_len) {
+    const EVP_MD* digest = EVP_sha256();
+    auto result = HKDF(out_key, out_len, digest, secret, secret_len, salt, salt_len, info,
+                       info_len);
+    return result == 1;
+}
+
+bool HKDFDeriveMulti(const HKDF_out* outs, size_t count, const uint8_t* secret, size_t secret_len,
+                     const uint8_t* salt, size_t salt_len) {
+    const EVP_MD* digest = EVP_sha256();
+    uint8_t prk[EVP_MAX_MD_SIZE];
+    size_t prk_len;
+    ArrayEraser prk_eraser(prk, sizeof(prk));
+    if (!HKDF_extract(prk, &prk_len, digest, secret, secret_len, salt, salt_len)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!HKDF_expand(outs[i].out_key, outs[i].out_len, digest, prk, prk_len, outs[i].info,
+                         outs[i].info_len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Returns the shared curve group used by all the EC helpers below. BoringSSL hands out the same
+ * static group for a named curve, so memoizing it saves the per-call lookup without any
+ * lifetime concerns; it is never freed.
+ */
+static const EC_GROUP* ecGroup() {
+    static const EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp521r1);
+    return group;
+}
+
 int ECDHComputeKey(void* out, const EC_POINT* pub_key, const EC_KEY* priv_key) {
     return ECDH_compute_key(out, EC_MAX_BYTES, pub_key, priv_key, nullptr);
 }
 
-EC_KEY* ECKEYGenerateKey() {
+size_t ECDHComputeKeyBatch(uint8_t* out, size_t* out_lens, const EC_POINT* const* pub_keys,
+                           size_t count, const EC_KEY* priv_key) {
+    for (size_t i = 0; i < count; ++i) {
+        int result =
+            ECDH_compute_key(out + i * EC_MAX_BYTES, EC_MAX_BYTES, pub_keys[i], priv_key, nullptr);
+        if (result < 0) {
+            return i;
+        }
+        out_lens[i] = result;
+    }
+    return count;
+}
+
+static EC_KEY* generateKeyOnGroup() {
     EC_KEY* key = EC_KEY_new();
-    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp521r1);
-    EC_KEY_set_group(key, group);
+    EC_KEY_set_group(key, ecGroup());
     auto result = EC_KEY_generate_key(key);
     if (result == 0) {
-        EC_GROUP_free(group);
         EC_KEY_free(key);
         return nullptr;
     }
     return key;
 }
 
+// A small pool of pregenerated ephemeral keys, refilled by ECKEYPregenerate ahead of a
+// presentation burst and drained by ECKEYGenerateKey. Keys handed out become owned by the
+// caller exactly as if they had been generated inline.
+static constexpr size_t kEcKeyPoolCapacity = 8;
+static std::mutex ecKeyPoolMutex;
+static std::vector<EC_KEY*> ecKeyPool;
+
+bool ECKEYPregenerate(size_t count) {
+    if (count > kEcKeyPoolCapacity) {
+        count = kEcKeyPoolCapacity;
+    }
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(ecKeyPoolMutex);
+            if (ecKeyPool.size() >= count) {
+                return true;
+            }
+        }
+        // Generate outside the lock so concurrent consumers are not blocked.
+        EC_KEY* key = generateKeyOnGroup();
+        if (key == nullptr) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(ecKeyPoolMutex);
+        if (ecKeyPool.size() >= kEcKeyPoolCapacity) {
+            EC_KEY_free(key);
+            return true;
+        }
+        ecKeyPool.push_back(key);
+    }
+}
+
+EC_KEY* ECKEYGenerateKey() {
+    {
+        std::lock_guard<std::mutex> lock(ecKeyPoolMutex);
+        if (!ecKeyPool.empty()) {
+            EC_KEY* key = ecKeyPool.back();
+            ecKeyPool.pop_back();
+            return key;
+        }
+    }
+    return generateKeyOnGroup();
+}
+
 size_t ECKEYMarshalPrivateKey(const EC_KEY* priv_key, uint8_t* buf, size_t len) {
     CBB cbb;
     size_t out_len;
@@ -251,9 +742,7 @@ size_t ECKEYMarshalPrivateKey(const EC_KEY* priv_key, uint8_t* buf, size_t len)
 EC_KEY* ECKEYParsePrivateKey(const uint8_t* buf, size_t len) {
     CBS cbs;
     CBS_init(&cbs, buf, len);
-    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp521r1);
-    auto result = EC_KEY_parse_private_key(&cbs, group);
-    EC_GROUP_free(group);
+    auto result = EC_KEY_parse_private_key(&cbs, ecGroup());
     if (result != nullptr && CBS_len(&cbs) != 0) {
         EC_KEY_free(result);
         return nullptr;
@@ -262,18 +751,14 @@ EC_KEY* ECKEYParsePrivateKey(const uint8_t* buf, size_t len) {
 }
 
 size_t ECPOINTPoint2Oct(const EC_POINT* point, uint8_t* buf, size_t len) {
-    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp521r1);
     point_conversion_form_t form = POINT_CONVERSION_UNCOMPRESSED;
-    auto result = EC_POINT_point2oct(group, point, form, buf, len, nullptr);
-    EC_GROUP_free(group);
-    return result;
+    return EC_POINT_point2oct(ecGroup(), point, form, buf, len, nullptr);
 }
 
 EC_POINT* ECPOINTOct2Point(const uint8_t* buf, size_t len) {
-    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp521r1);
+    const EC_GROUP* group = ecGroup();
     EC_POINT* point = EC_POINT_new(group);
     auto result = EC_POINT_oct2point(group, point, buf, len, nullptr);
-    EC_GROUP_free(group);
     if (result == 0) {
         EC_POINT_free(point);
         return nullptr;
@@ -288,34 +773,59 @@ int extractSubjectFromCertificate(const uint8_t* cert_buf, size_t cert_len, uint
         return 0;
     }
 
-    const uint8_t* p = cert_buf;
-    bssl::UniquePtr<X509> cert(d2i_X509(nullptr /* Allocate X509 struct */, &p, cert_len));
-    if (!cert) {
+    // Walk the DER directly to the subject field rather than running d2i_X509,
+    // which would allocate the full extension and SPKI structure tree just to
+    // have most of it thrown away. The subject is already DER inside the
+    // buffer, so once located it only needs to be copied out, not re-encoded.
+    //
+    //   Certificate ::= SEQUENCE { tbsCertificate TBSCertificate, ... }
+    //   TBSCertificate ::= SEQUENCE {
+    //       version [0] EXPLICIT Version OPTIONAL,
+    //       serialNumber        INTEGER,
+    //       signature           AlgorithmIdentifier,
+    //       issuer              Name,
+    //       validity            Validity,
+    //       subject             Name,
+    //       ... }
+    CBS cbs, cert, tbs, subject;
+    CBS_init(&cbs, cert_buf, cert_len);
+    if (!CBS_get_asn1(&cbs, &cert, CBS_ASN1_SEQUENCE) ||
+        !CBS_get_asn1(&cert, &tbs, CBS_ASN1_SEQUENCE)) {
         ALOGE("extractSubjectFromCertificate: failed to parse certificate");
         return 0;
     }
-
-    X509_NAME* subject = X509_get_subject_name(cert.get());
-    if (!subject) {
+    constexpr unsigned kVersionTag =
+        CBS_ASN1_CONSTRUCTED | CBS_ASN1_CONTEXT_SPECIFIC | 0;
+    if (CBS_peek_asn1_tag(&tbs, kVersionTag) &&
+        !CBS_get_asn1(&tbs, nullptr /* skip */, kVersionTag)) {
+        ALOGE("extractSubjectFromCertificate: failed to parse certificate");
+        return 0;
+    }
+    if (!CBS_get_asn1(&tbs, nullptr /* serialNumber */, CBS_ASN1_INTEGER) ||
+        !CBS_get_asn1(&tbs, nullptr /* signature */, CBS_ASN1_SEQUENCE) ||
+        !CBS_get_asn1(&tbs, nullptr /* issuer */, CBS_ASN1_SEQUENCE) ||
+        !CBS_get_asn1(&tbs, nullptr /* validity */, CBS_ASN1_SEQUENCE) ||
+        // Keep the element header: the caller gets the complete DER-encoded Name.
+        !CBS_get_asn1_element(&tbs, &subject, CBS_ASN1_SEQUENCE)) {
         ALOGE("extractSubjectFromCertificate: failed to retrieve subject name");
         return 0;
     }
 
-    int subject_len = i2d_X509_NAME(subject, nullptr /* Don't copy the data */);
-    if (subject_len < 0) {
-        ALOGE("extractSubjectFromCertificate: error obtaining encoded subject name length");
+    size_t subject_len = CBS_len(&subject);
+    if (subject_len > INT_MAX) {
+        ALOGE("extractSubjectFromCertificate: subject field implausibly large");
         return 0;
     }
 
     if (subject_len > subject_buf_len) {
         // Return the subject length, negated, so the caller knows how much
         // buffer space is required.
-        ALOGI("extractSubjectFromCertificate: needed %d bytes for subject, caller provided %zu",
+        ALOGI("extractSubjectFromCertificate: needed %zu bytes for subject, caller provided %zu",
               subject_len, subject_buf_len);
-        return -subject_len;
+        return -static_cast<int>(subject_len);
     }
 
     // subject_buf has enough space.
-    uint8_t* tmp = subject_buf;
-    return i2d_X509_NAME(subject, &tmp);
+    memcpy(subject_buf, CBS_data(&subject), subject_len);
+    return static_cast<int>(subject_len);
 }
@@ -29,6 +29,48 @@ extern "C" {
                        const uint8_t* key, size_t key_size, const uint8_t* iv,
                        const uint8_t* tag);
 
+  // Describes one AES-GCM buffer for the batch functions below. `tag` is
+  // written by AES_gcm_encrypt_batch and read by AES_gcm_decrypt_batch.
+  typedef struct AES_gcm_io {
+      const uint8_t* in;
+      uint8_t* out;
+      size_t len;
+      const uint8_t* iv;
+      uint8_t* tag;
+  } AES_gcm_io;
+
+  // Encrypt or decrypt `count` independent buffers with the same key, setting
+  // up the AES key schedule only once for the whole batch. Buffers are
+  // processed in order; the return value is the number of buffers processed
+  // successfully, so a return value < count identifies the failing entry.
+  size_t AES_gcm_encrypt_batch(const AES_gcm_io* bufs, size_t count,
+                               const uint8_t* key, size_t key_size);
+  size_t AES_gcm_decrypt_batch(const AES_gcm_io* bufs, size_t count,
+                               const uint8_t* key, size_t key_size);
+
+  // One segment of a scatter-gather AES-GCM message. `out` may equal `in` for
+  // in-place operation.
+  typedef struct AES_gcm_segment {
+      const uint8_t* in;
+      uint8_t* out;
+      size_t len;
+  } AES_gcm_segment;
+
+  // Encrypt or decrypt one message made up of `count` discontiguous segments
+  // under a single IV and tag, writing each segment's output directly to its
+  // `out` pointer so callers need not coalesce the message into one buffer.
+  //
+  // Unlike AES_gcm_decrypt, AES_gcm_decrypt_iov writes plaintext to the caller
+  // segments before the tag has been verified; on tag mismatch it erases the
+  // output segments and returns false, and callers must not peek at the output
+  // buffers from another thread while the call is in flight.
+  bool AES_gcm_encrypt_iov(const AES_gcm_segment* segs, size_t count,
+                           const uint8_t* key, size_t key_size, const uint8_t* iv,
+                           uint8_t* tag);
+  bool AES_gcm_decrypt_iov(const AES_gcm_segment* segs, size_t count,
+                           const uint8_t* key, size_t key_size, const uint8_t* iv,
+                           const uint8_t* tag);
+
   // Copied from system/security/keystore/keymaster_enforcement.h.
   typedef uint64_t km_id_t;
 
@@ -48,13 +90,48 @@ extern "C" {
                   const uint8_t *prk, size_t prk_len,
                   const uint8_t *info, size_t info_len);
 
+  // One-shot extract+expand with a single HMAC context lifecycle, for callers
+  // that never need the intermediate PRK.
+  bool HKDFExtractAndExpand(uint8_t *out_key, size_t out_len,
+                            const uint8_t *secret, size_t secret_len,
+                            const uint8_t *salt, size_t salt_len,
+                            const uint8_t *info, size_t info_len);
+
+  // One output key of HKDFDeriveMulti.
+  typedef struct HKDF_out {
+      uint8_t* out_key;
+      size_t out_len;
+      const uint8_t* info;
+      size_t info_len;
+  } HKDF_out;
+
+  // Derives `count` output keys from one (secret, salt) pair, running the
+  // extract step once and expanding each output with its own info string.
+  bool HKDFDeriveMulti(const HKDF_out *outs, size_t count,
+                       const uint8_t *secret, size_t secret_len,
+                       const uint8_t *salt, size_t salt_len);
+
   // We define this as field_elem_size.
   static const size_t EC_MAX_BYTES = 32;
 
   int ECDHComputeKey(void *out, const EC_POINT *pub_key, const EC_KEY *priv_key);
 
+  // Compute `count` agreements between one private key and many public keys,
+  // sharing the curve setup across the batch. `out` must have room for
+  // EC_MAX_BYTES bytes per agreement, written at that stride; the length of
+  // each result is stored in `out_lens`. Returns the number of agreements
+  // completed; processing stops at the first failure.
+  size_t ECDHComputeKeyBatch(uint8_t *out, size_t *out_lens,
+                             const EC_POINT *const *pub_keys, size_t count,
+                             const EC_KEY *priv_key);
+
   EC_KEY* ECKEYGenerateKey();
 
+  // Fill the pool of pregenerated ephemeral keys consumed by
+  // ECKEYGenerateKey, so a burst of agreements does not pay key generation
+  // inline. Returns false if generation failed before the pool was full.
+  bool ECKEYPregenerate(size_t count);
+
   size_t ECKEYMarshalPrivateKey(const EC_KEY *priv_key, uint8_t *buf, size_t len);
 
   EC_KEY* ECKEYParsePrivateKey(const uint8_t *buf, size_t len);
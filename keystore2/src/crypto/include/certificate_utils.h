@@ -168,6 +168,35 @@ CertUtilsError signCertWith(X509* certificate,
                             std::function<std::vector<uint8_t>(const uint8_t*, size_t)> sign,
                             Algo algo, Padding padding, Digest digest);
 
+/**
+ * Signs a batch of certificates with one (algo, padding, digest) triplet and one `sign` callback,
+ * fanning the per-certificate digest-and-sign work across worker threads. The calling thread
+ * participates, so small batches cost no more than the equivalent loop over signCertWith.
+ * IMPORTANT: The `sign` callback is invoked concurrently from several threads and must be
+ * thread-safe; see signCertWith for the callback's contract.
+ *
+ * @param certificates X509 certificate structures to be signed; entries must not be null.
+ * @param sign Callback function used to digest and sign each DER encoded to-be-signed certificate.
+ * @param algo Algorithm specifier used to encode the signing algorithm id of the certificates.
+ * @param padding Padding specifier used to encode the signing algorithm id of the certificates.
+ * @param digest Digest specifier used to encode the signing algorithm id of the certificates.
+ * @return one CertUtilsError per certificate, in the same order as the input.
+ */
+std::vector<CertUtilsError>
+signCertBatchWith(const std::vector<X509*>& certificates,
+                  std::function<std::vector<uint8_t>(const uint8_t*, size_t)> sign, Algo algo,
+                  Padding padding, Digest digest);
+
+/**
+ * Generates the DER representation of the given signed X509 certificate structure, appending it
+ * to the caller-provided buffer. Existing buffer contents are preserved, so a certificate chain
+ * can be encoded back to back into one buffer, and the buffer's capacity is reused across calls.
+ * @param certificate
+ * @param buffer receives the DER encoded certificate.
+ * @return CertUtilsError::Ok on success.
+ */
+CertUtilsError encodeCertInto(X509* certificate, std::vector<uint8_t>* buffer);
+
 /**
  * Generates the DER representation of the given signed X509 certificate structure.
  * @param certificate
@@ -22,7 +22,8 @@ use keystore2_crypto_bindgen::{
     extractSubjectFromCertificate, generateKeyFromPassword, randomBytes, AES_gcm_decrypt,
     AES_gcm_encrypt, ECDHComputeKey, ECKEYGenerateKey, ECKEYMarshalPrivateKey,
     ECKEYParsePrivateKey, ECPOINTOct2Point, ECPOINTPoint2Oct, EC_KEY_free, EC_KEY_get0_public_key,
-    EC_POINT_free, HKDFExpand, HKDFExtract, EC_KEY, EC_MAX_BYTES, EC_POINT, EVP_MAX_MD_SIZE,
+    EC_POINT_free, HKDFExpand, HKDFExtract, HKDFExtractAndExpand, EC_KEY, EC_MAX_BYTES, EC_POINT,
+    EVP_MAX_MD_SIZE,
 };
 use std::convert::TryFrom;
 use std::convert::TryInto;
@@ -249,6 +250,37 @@ pub fn hkdf_extract(secret: &[u8], salt: &[u8]) -> Result<ZVec, Error> {
     Ok(buf)
 }
 
+/// Performs HKDF extract and expand in one call, without materializing the
+/// intermediate pseudorandom key. Equivalent to
+/// `hkdf_expand(out_len, &hkdf_extract(secret, salt)?, info)` but with a
+/// single FFI crossing and one HMAC context lifecycle.
+pub fn hkdf_extract_and_expand(
+    out_len: usize,
+    secret: &[u8],
+    salt: &[u8],
+    info: &[u8],
+) -> Result<ZVec, Error> {
+    let mut buf = ZVec::new(out_len)?;
+    // Safety: HKDFExtractAndExpand writes out_len bytes to the buffer.
+    // Secret, salt, and info point to valid buffers.
+    let result = unsafe {
+        HKDFExtractAndExpand(
+            buf.as_mut_ptr(),
+            out_len,
+            secret.as_ptr(),
+            secret.len(),
+            salt.as_ptr(),
+            salt.len(),
+            info.as_ptr(),
+            info.len(),
+        )
+    };
+    if !result {
+        return Err(Error::HKDFExpandFailed);
+    }
+    Ok(buf)
+}
+
 /// Calls the boringssl HKDF_expand function.
 pub fn hkdf_expand(out_len: usize, prk: &[u8], info: &[u8]) -> Result<ZVec, Error> {
     let mut buf = ZVec::new(out_len)?;
@@ -462,7 +494,9 @@ mod tests {
 
     use super::*;
     use keystore2_crypto_bindgen::{
-        generateKeyFromPassword, AES_gcm_decrypt, AES_gcm_encrypt, CreateKeyId,
+        generateKeyFromPassword, AES_gcm_decrypt, AES_gcm_decrypt_batch, AES_gcm_decrypt_iov,
+        AES_gcm_encrypt, AES_gcm_encrypt_batch, AES_gcm_encrypt_iov, AES_gcm_io, AES_gcm_segment,
+        CreateKeyId,
     };
 
     #[test]
@@ -509,6 +543,80 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_encrypt_decrypt_batch() {
+        const COUNT: usize = 4;
+        let input: Vec<Vec<u8>> = (0..COUNT).map(|i| vec![i as u8; 16]).collect();
+        let mut out = vec![vec![0; 16]; COUNT];
+        let mut out2 = vec![vec![0; 16]; COUNT];
+        let key = vec![0; 16];
+        let ivs: Vec<Vec<u8>> = (0..COUNT).map(|i| vec![i as u8; 12]).collect();
+        let mut tags = vec![vec![0; 16]; COUNT];
+        unsafe {
+            let mut bufs: Vec<AES_gcm_io> = (0..COUNT)
+                .map(|i| AES_gcm_io {
+                    in_: input[i].as_ptr(),
+                    out: out[i].as_mut_ptr(),
+                    len: 16,
+                    iv: ivs[i].as_ptr(),
+                    tag: tags[i].as_mut_ptr(),
+                })
+                .collect();
+            let res = AES_gcm_encrypt_batch(bufs.as_ptr(), COUNT, key.as_ptr(), 16);
+            assert_eq!(res, COUNT);
+            for i in 0..COUNT {
+                assert_ne!(out[i], input[i]);
+                bufs[i].in_ = out[i].as_ptr();
+                bufs[i].out = out2[i].as_mut_ptr();
+            }
+            let res = AES_gcm_decrypt_batch(bufs.as_ptr(), COUNT, key.as_ptr(), 16);
+            assert_eq!(res, COUNT);
+            for i in 0..COUNT {
+                assert_eq!(out2[i], input[i]);
+            }
+        }
+    }
+
+    #[test]
+    fn test_encrypt_decrypt_iov() {
+        // Two discontiguous segments, decrypted back in place.
+        let header = vec![1; 8];
+        let payload = vec![2; 24];
+        let mut out_header = vec![0; 8];
+        let mut out_payload = vec![0; 24];
+        let key = vec![0; 16];
+        let iv = vec![0; 12];
+        let mut tag = vec![0; 16];
+        unsafe {
+            let segs = [
+                AES_gcm_segment { in_: header.as_ptr(), out: out_header.as_mut_ptr(), len: 8 },
+                AES_gcm_segment { in_: payload.as_ptr(), out: out_payload.as_mut_ptr(), len: 24 },
+            ];
+            let res =
+                AES_gcm_encrypt_iov(segs.as_ptr(), 2, key.as_ptr(), 16, iv.as_ptr(), tag.as_mut_ptr());
+            assert!(res);
+            assert_ne!(out_header, header);
+            assert_ne!(out_payload, payload);
+            let segs = [
+                AES_gcm_segment {
+                    in_: out_header.as_ptr(),
+                    out: out_header.as_mut_ptr(),
+                    len: 8,
+                },
+                AES_gcm_segment {
+                    in_: out_payload.as_ptr(),
+                    out: out_payload.as_mut_ptr(),
+                    len: 24,
+                },
+            ];
+            let res =
+                AES_gcm_decrypt_iov(segs.as_ptr(), 2, key.as_ptr(), 16, iv.as_ptr(), tag.as_ptr());
+            assert!(res);
+            assert_eq!(out_header, header);
+            assert_eq!(out_payload, payload);
+        }
+    }
+
     #[test]
     fn test_create_key_id() {
         let blob = vec![0; 16];
@@ -531,6 +639,22 @@ mod tests {
         assert_ne!(key, vec![0; 16]);
     }
 
+    #[test]
+    fn test_parse_subject_from_certificate() {
+        // Minimal TBSCertificate skeleton: version, serial, signature
+        // algorithm, issuer, and validity, followed by the subject Name —
+        // here a SEQUENCE containing one NULL, which must come back verbatim.
+        let cert: &[u8] = &[
+            0x30, 0x14, 0x30, 0x12, 0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x01, 0x01, 0x30, 0x00,
+            0x30, 0x00, 0x30, 0x00, 0x30, 0x02, 0x05, 0x00,
+        ];
+        let subject = parse_subject_from_certificate(cert).unwrap();
+        assert_eq!(subject, vec![0x30, 0x02, 0x05, 0x00]);
+
+        // Truncated input must fail, not panic.
+        assert!(parse_subject_from_certificate(&cert[..10]).is_err());
+    }
+
     #[test]
     fn test_hkdf() {
         let result = hkdf_extract(&[0; 16], &[0; 16]);
@@ -542,6 +666,48 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_hkdf_extract_and_expand() {
+        // The one-shot API must match the result of separate extract and expand calls.
+        let (secret, salt, info) = (&[1; 16][..], &[2; 16][..], &[3; 8][..]);
+        let prk = hkdf_extract(secret, salt).unwrap();
+        let expanded = hkdf_expand(32, &prk, info).unwrap();
+        let one_shot = hkdf_extract_and_expand(32, secret, salt, info).unwrap();
+        assert_eq!(&one_shot[..], &expanded[..]);
+    }
+
+    #[test]
+    fn test_ecdh_batch() -> Result<(), Error> {
+        use keystore2_crypto_bindgen::{ECDHComputeKeyBatch, ECKEYPregenerate};
+
+        // Pregenerated pool keys must behave like inline-generated ones.
+        assert!(unsafe { ECKEYPregenerate(2) });
+
+        let priv_key = ec_key_generate_key()?;
+        let peers: Vec<ECKey> =
+            (0..3).map(|_| ec_key_generate_key()).collect::<Result<_, _>>()?;
+
+        let max_bytes = EC_MAX_BYTES as usize;
+        let mut out = vec![0; 3 * max_bytes];
+        let mut out_lens = vec![0; 3];
+        let pubs: Vec<*const EC_POINT> = peers
+            .iter()
+            .map(|peer| ec_key_get0_public_key(peer).get_point() as *const EC_POINT)
+            .collect();
+        // Safety: out has EC_MAX_BYTES bytes per agreement and out_lens one
+        // slot per agreement; all keys are valid objects kept alive above.
+        let res = unsafe {
+            ECDHComputeKeyBatch(out.as_mut_ptr(), out_lens.as_mut_ptr(), pubs.as_ptr(), 3, priv_key.0)
+        };
+        assert_eq!(res, 3);
+
+        for (i, peer) in peers.iter().enumerate() {
+            let single = ecdh_compute_key(ec_key_get0_public_key(peer).get_point(), &priv_key)?;
+            assert_eq!(&out[i * max_bytes..i * max_bytes + out_lens[i]], &single[..]);
+        }
+        Ok(())
+    }
+
     #[test]
     fn test_ec() -> Result<(), Error> {
         let priv0 = ec_key_generate_key()?;
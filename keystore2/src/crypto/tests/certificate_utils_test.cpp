@@ -316,6 +316,64 @@ TEST_P(CertificateUtilsWithRsa, CertSigningWithCallbackRsa) {
     ASSERT_TRUE(X509_verify(decoded_cert.get(), decoded_pkey.get()));
 }
 
+TEST(CertSigningBatch, SignsAndVerifiesEveryCertificate) {
+    EVP_PKEY_CTX_Ptr pkey_ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL));
+    ASSERT_TRUE((bool)pkey_ctx);
+    ASSERT_TRUE(EVP_PKEY_keygen_init(pkey_ctx.get()));
+    ASSERT_TRUE(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pkey_ctx.get(), NID_X9_62_prime256v1));
+
+    EVP_PKEY* pkey_ptr = nullptr;
+    ASSERT_TRUE(EVP_PKEY_keygen(pkey_ctx.get(), &pkey_ptr));
+    EVP_PKEY_Ptr pkey(pkey_ptr);
+    ASSERT_TRUE(pkey);
+
+    uint64_t now_ms = (uint64_t)time(nullptr) * 1000;
+
+    constexpr size_t kBatchSize = 8;
+    std::vector<X509_Ptr> certs;
+    std::vector<X509*> cert_ptrs;
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        auto certV = makeCert(pkey.get(), std::nullopt, std::nullopt, now_ms - kValidity,
+                              now_ms + kValidity, true /* subject key id extension */, std::nullopt,
+                              std::nullopt);
+        ASSERT_TRUE(std::holds_alternative<X509_Ptr>(certV));
+        certs.push_back(std::move(std::get<X509_Ptr>(certV)));
+        ASSERT_TRUE(!setIssuer(certs.back().get(), certs.back().get(), true));
+        cert_ptrs.push_back(certs.back().get());
+    }
+
+    // The callback is invoked concurrently, so it must only touch its own locals and the
+    // (read-only) signing key.
+    auto results = signCertBatchWith(
+        cert_ptrs,
+        [&](const uint8_t* data, size_t len) {
+            bssl::ScopedEVP_MD_CTX sign_ctx;
+            EXPECT_TRUE(
+                EVP_DigestSignInit(sign_ctx.get(), nullptr, EVP_sha256(), nullptr, pkey.get()));
+
+            std::vector<uint8_t> sig_buf(512);
+            size_t sig_len = 512;
+            EVP_DigestSign(sign_ctx.get(), sig_buf.data(), &sig_len, data, len);
+            sig_buf.resize(sig_len);
+            return sig_buf;
+        },
+        Algo::ECDSA, Padding::Ignored, Digest::SHA256);
+
+    ASSERT_EQ(results.size(), kBatchSize);
+    for (size_t i = 0; i < kBatchSize; ++i) {
+        ASSERT_TRUE(!results[i]);
+
+        auto encCertV = encodeCert(cert_ptrs[i]);
+        ASSERT_TRUE(std::holds_alternative<std::vector<uint8_t>>(encCertV));
+        auto& encCert = std::get<1>(encCertV);
+
+        const uint8_t* p = encCert.data();
+        X509_Ptr decoded_cert(d2i_X509(nullptr, &p, (long)encCert.size()));
+        EVP_PKEY_Ptr decoded_pkey(X509_get_pubkey(decoded_cert.get()));
+        ASSERT_TRUE(X509_verify(decoded_cert.get(), decoded_pkey.get()));
+    }
+}
+
 TEST(TimeStringTests, toTimeStringTest) {
     // Two test vectors that need to result in UTCTime
     ASSERT_EQ(std::string(toTimeString(1622758591000)->data()), std::string("210603221631Z"));
@@ -3259,6 +3259,21 @@ impl KeystoreDB {
         self.perboot.find_auth_token_entry(p).map(|entry| (entry, self.get_last_off_body()))
     }
 
+    /// Find the newest auth token matching the given predicate among the tokens
+    /// indexed under the given SIDs, without scanning the whole token table.
+    pub fn find_auth_token_entry_for_sids<F>(
+        &self,
+        sids: &[i64],
+        p: F,
+    ) -> Option<(AuthTokenEntry, MonotonicRawTime)>
+    where
+        F: Fn(&AuthTokenEntry) -> bool,
+    {
+        self.perboot
+            .find_auth_token_entry_for_sids(sids, p)
+            .map(|entry| (entry, self.get_last_off_body()))
+    }
+
     /// Insert last_off_body into the metadata table at the initialization of auth token table
     pub fn insert_last_off_body(&self, last_off_body: MonotonicRawTime) {
         self.perboot.set_last_off_body(last_off_body)
@@ -20,12 +20,12 @@ use android_hardware_security_keymint::aidl::android::hardware::security::keymin
     HardwareAuthToken::HardwareAuthToken, HardwareAuthenticatorType::HardwareAuthenticatorType,
 };
 use lazy_static::lazy_static;
-use std::collections::HashSet;
+use std::collections::{HashMap, HashSet};
 use std::sync::atomic::{AtomicI64, Ordering};
 use std::sync::Arc;
 use std::sync::RwLock;
 
-#[derive(PartialEq, PartialOrd, Ord, Eq, Hash)]
+#[derive(Clone, Copy, PartialEq, PartialOrd, Ord, Eq, Hash)]
 struct AuthTokenId {
     user_id: i64,
     auth_id: i64,
@@ -42,26 +42,15 @@ impl AuthTokenId {
     }
 }
 
-//Implements Eq/Hash to only operate on the AuthTokenId portion
-//of the AuthTokenEntry. This allows a HashSet to DTRT.
-#[derive(Clone)]
-struct AuthTokenEntryWrap(AuthTokenEntry);
-
-impl std::hash::Hash for AuthTokenEntryWrap {
-    fn hash<H: std::hash::Hasher>(&self, state: &mut H) {
-        AuthTokenId::from_auth_token(&self.0.auth_token).hash(state)
-    }
-}
-
-impl PartialEq<AuthTokenEntryWrap> for AuthTokenEntryWrap {
-    fn eq(&self, other: &AuthTokenEntryWrap) -> bool {
-        AuthTokenId::from_auth_token(&self.0.auth_token)
-            == AuthTokenId::from_auth_token(&other.0.auth_token)
-    }
+/// Primary token store plus a secondary index from SID to the tokens carrying
+/// it as user or authenticator id, so SID-directed lookups only visit that
+/// SID's tokens instead of scanning the whole table.
+#[derive(Default)]
+struct AuthTokenStore {
+    entries: HashMap<AuthTokenId, AuthTokenEntry>,
+    by_sid: HashMap<i64, HashSet<AuthTokenId>>,
 }
 
-impl Eq for AuthTokenEntryWrap {}
-
 /// Per-boot state structure. Currently only used to track auth tokens and
 /// last-off-body.
 #[derive(Default)]
@@ -69,7 +58,7 @@ pub struct PerbootDB {
     // We can use a .unwrap() discipline on this lock, because only panicking
     // while holding a .write() lock will poison it. The only write usage is
     // an insert call which inserts a pre-constructed pair.
-    auth_tokens: RwLock<HashSet<AuthTokenEntryWrap>>,
+    auth_tokens: RwLock<AuthTokenStore>,
     // Ordering::Relaxed is appropriate for accessing this atomic, since it
     // does not currently need to be synchronized with anything else.
     last_off_body: AtomicI64,
@@ -89,7 +78,15 @@ impl PerbootDB {
     /// Add a new auth token + timestamp to the database, replacing any which
     /// match all of user_id, auth_id, and auth_type.
     pub fn insert_auth_token_entry(&self, entry: AuthTokenEntry) {
-        self.auth_tokens.write().unwrap().replace(AuthTokenEntryWrap(entry));
+        let mut store = self.auth_tokens.write().unwrap();
+        let id = AuthTokenId::from_auth_token(&entry.auth_token);
+        if store.entries.insert(id, entry).is_none() {
+            // A new (user_id, auth_id, auth_type) triple; index it under both of
+            // its SIDs. A replacement keeps the same triple, so the index
+            // already holds it.
+            store.by_sid.entry(id.user_id).or_default().insert(id);
+            store.by_sid.entry(id.auth_id).or_default().insert(id);
+        }
     }
     /// Locate an auth token entry which matches the predicate with the most
     /// recent update time.
@@ -97,10 +94,24 @@ impl PerbootDB {
         &self,
         p: P,
     ) -> Option<AuthTokenEntry> {
-        let reader = self.auth_tokens.read().unwrap();
-        let mut matches: Vec<_> = reader.iter().filter(|x| p(&x.0)).collect();
-        matches.sort_by_key(|x| x.0.time_received);
-        matches.last().map(|x| x.0.clone())
+        let store = self.auth_tokens.read().unwrap();
+        store.entries.values().filter(|x| p(x)).max_by_key(|x| x.time_received).cloned()
+    }
+    /// Like find_auth_token_entry, but only visits the tokens indexed under the
+    /// given SIDs (as user or authenticator id) instead of the whole table.
+    pub fn find_auth_token_entry_for_sids<P: Fn(&AuthTokenEntry) -> bool>(
+        &self,
+        sids: &[i64],
+        p: P,
+    ) -> Option<AuthTokenEntry> {
+        let store = self.auth_tokens.read().unwrap();
+        sids.iter()
+            .filter_map(|sid| store.by_sid.get(sid))
+            .flatten()
+            .filter_map(|id| store.entries.get(id))
+            .filter(|x| p(x))
+            .max_by_key(|x| x.time_received)
+            .cloned()
     }
     /// Get the last time the device was off the user's body
     pub fn get_last_off_body(&self) -> MonotonicRawTime {
@@ -112,11 +123,11 @@ impl PerbootDB {
     }
     /// Return how many auth tokens are currently tracked.
     pub fn auth_tokens_len(&self) -> usize {
-        self.auth_tokens.read().unwrap().len()
+        self.auth_tokens.read().unwrap().entries.len()
     }
     #[cfg(test)]
     /// For testing, return all auth tokens currently tracked.
     pub fn get_all_auth_token_entries(&self) -> Vec<AuthTokenEntry> {
-        self.auth_tokens.read().unwrap().iter().cloned().map(|x| x.0).collect()
+        self.auth_tokens.read().unwrap().entries.values().cloned().collect()
     }
 }
@@ -632,13 +632,18 @@ impl Enforcements {
         let need_auth_token = timeout_bound || unlocked_device_required;
 
         let hat_and_last_off_body = if need_auth_token {
-            let hat_and_last_off_body = Self::find_auth_token(|hat: &AuthTokenEntry| {
+            let hat_and_last_off_body =
                 if let (Some(auth_type), true) = (user_auth_type, timeout_bound) {
-                    hat.satisfies(&user_secure_ids, auth_type)
+                    // Only tokens carrying one of the key's SIDs can match, so
+                    // restrict the lookup to the tokens indexed under them.
+                    Self::find_auth_token_for_sids(&user_secure_ids, |hat: &AuthTokenEntry| {
+                        hat.satisfies(&user_secure_ids, auth_type)
+                    })
+                } else if unlocked_device_required {
+                    Self::find_auth_token(|_| true)
                 } else {
-                    unlocked_device_required
-                }
-            });
+                    None
+                };
             Some(
                 hat_and_last_off_body
                     .ok_or(Error::Km(Ec::KEY_USER_NOT_AUTHENTICATED))
@@ -706,6 +711,13 @@ impl Enforcements {
         DB.with(|db| db.borrow().find_auth_token_entry(p))
     }
 
+    fn find_auth_token_for_sids<F>(sids: &[i64], p: F) -> Option<(AuthTokenEntry, MonotonicRawTime)>
+    where
+        F: Fn(&AuthTokenEntry) -> bool,
+    {
+        DB.with(|db| db.borrow().find_auth_token_entry_for_sids(sids, p))
+    }
+
     /// Checks if the time now since epoch is greater than (or equal, if is_given_time_inclusive is
     /// set) the given time (in milliseconds)
     fn is_given_time_passed(given_time: i64, is_given_time_inclusive: bool) -> bool {
@@ -815,7 +827,7 @@ impl Enforcements {
         let auth_type = HardwareAuthenticatorType::ANY;
         let sids: Vec<i64> = vec![secure_user_id];
         // Filter the matching auth tokens by challenge
-        let result = Self::find_auth_token(|hat: &AuthTokenEntry| {
+        let result = Self::find_auth_token_for_sids(&sids, |hat: &AuthTokenEntry| {
             (challenge == hat.challenge()) && hat.satisfies(&sids, auth_type)
         });
 
@@ -825,14 +837,15 @@ impl Enforcements {
             // Filter the matching auth tokens by age.
             if auth_token_max_age_millis != 0 {
                 let now_in_millis = MonotonicRawTime::now();
-                let result = Self::find_auth_token(|auth_token_entry: &AuthTokenEntry| {
-                    let token_valid = now_in_millis
-                        .checked_sub(&auth_token_entry.time_received())
-                        .map_or(false, |token_age_in_millis| {
-                            auth_token_max_age_millis > token_age_in_millis.milliseconds()
-                        });
-                    token_valid && auth_token_entry.satisfies(&sids, auth_type)
-                });
+                let result =
+                    Self::find_auth_token_for_sids(&sids, |auth_token_entry: &AuthTokenEntry| {
+                        let token_valid = now_in_millis
+                            .checked_sub(&auth_token_entry.time_received())
+                            .map_or(false, |token_age_in_millis| {
+                                auth_token_max_age_millis > token_age_in_millis.milliseconds()
+                            });
+                        token_valid && auth_token_entry.satisfies(&sids, auth_type)
+                    });
 
                 if let Some((auth_token_entry, _)) = result {
                     auth_token_entry.take_auth_token()
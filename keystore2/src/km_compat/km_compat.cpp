@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_HAL
+
 #include "km_compat.h"
 
 #include "km_compat_type_conversion.h"
@@ -31,8 +33,13 @@
 #include <keymasterV4_1/Keymaster.h>
 #include <keymasterV4_1/Keymaster3.h>
 #include <keymasterV4_1/Keymaster4.h>
+#include <openssl/sha.h>
+#include <utils/Trace.h>
 
+#include <atomic>
+#include <bitset>
 #include <chrono>
+#include <future>
 
 #include "certificate_utils.h"
 
@@ -61,80 +68,102 @@ using std::chrono::duration_cast;
 
 // Utility functions
 
+// Parameter classification.
+//
+// The per-tag membership tests below run for every parameter of every key
+// creation request, so membership is precomputed into bitsets indexed by the
+// tag number (the low 28 bits of the tag; the upper 4 encode the type).
+
+constexpr uint32_t kTagNumberMask = 0x0FFFFFFF;
+constexpr size_t kMaxTagNumber = 2048;
+
+static std::bitset<kMaxTagNumber> makeTagBitset(std::initializer_list<Tag> tags) {
+    std::bitset<kMaxTagNumber> result;
+    for (Tag tag : tags) {
+        result.set(static_cast<uint32_t>(tag) & kTagNumberMask);
+    }
+    return result;
+}
+
+static bool testTagBit(const std::bitset<kMaxTagNumber>& bits, Tag tag) {
+    uint32_t tagNumber = static_cast<uint32_t>(tag) & kTagNumberMask;
+    return tagNumber < kMaxTagNumber && bits.test(tagNumber);
+}
+
+// Tags that may be passed to attestKey.
+static const std::bitset<kMaxTagNumber> kAttestationParameterBits = makeTagBitset({
+    Tag::APPLICATION_ID,
+    Tag::APPLICATION_DATA,
+    Tag::ATTESTATION_CHALLENGE,
+    Tag::ATTESTATION_APPLICATION_ID,
+    Tag::ATTESTATION_ID_BRAND,
+    Tag::ATTESTATION_ID_DEVICE,
+    Tag::ATTESTATION_ID_PRODUCT,
+    Tag::ATTESTATION_ID_SERIAL,
+    Tag::ATTESTATION_ID_IMEI,
+    Tag::ATTESTATION_ID_MEID,
+    Tag::ATTESTATION_ID_MANUFACTURER,
+    Tag::ATTESTATION_ID_MODEL,
+    Tag::CERTIFICATE_SERIAL,
+    Tag::CERTIFICATE_SUBJECT,
+    Tag::CERTIFICATE_NOT_BEFORE,
+    Tag::CERTIFICATE_NOT_AFTER,
+    Tag::INCLUDE_UNIQUE_ID,
+    Tag::DEVICE_UNIQUE_ATTESTATION,
+});
+
+// Tags that may be passed to generate/importKey.
+static const std::bitset<kMaxTagNumber> kKeyCreationParameterBits = makeTagBitset({
+    Tag::APPLICATION_ID,
+    Tag::APPLICATION_DATA,
+    Tag::CERTIFICATE_SERIAL,
+    Tag::CERTIFICATE_SUBJECT,
+    Tag::CERTIFICATE_NOT_BEFORE,
+    Tag::CERTIFICATE_NOT_AFTER,
+    Tag::PURPOSE,
+    Tag::ALGORITHM,
+    Tag::KEY_SIZE,
+    Tag::BLOCK_MODE,
+    Tag::DIGEST,
+    Tag::PADDING,
+    Tag::CALLER_NONCE,
+    Tag::MIN_MAC_LENGTH,
+    Tag::EC_CURVE,
+    Tag::RSA_PUBLIC_EXPONENT,
+    Tag::RSA_OAEP_MGF_DIGEST,
+    Tag::BOOTLOADER_ONLY,
+    Tag::ROLLBACK_RESISTANCE,
+    Tag::EARLY_BOOT_ONLY,
+    Tag::ACTIVE_DATETIME,
+    Tag::ORIGINATION_EXPIRE_DATETIME,
+    Tag::USAGE_EXPIRE_DATETIME,
+    Tag::MIN_SECONDS_BETWEEN_OPS,
+    Tag::MAX_USES_PER_BOOT,
+    Tag::USAGE_COUNT_LIMIT,
+    Tag::USER_ID,
+    Tag::USER_SECURE_ID,
+    Tag::NO_AUTH_REQUIRED,
+    Tag::USER_AUTH_TYPE,
+    Tag::AUTH_TIMEOUT,
+    Tag::ALLOW_WHILE_ON_BODY,
+    Tag::TRUSTED_USER_PRESENCE_REQUIRED,
+    Tag::TRUSTED_CONFIRMATION_REQUIRED,
+    Tag::UNLOCKED_DEVICE_REQUIRED,
+    Tag::CREATION_DATETIME,
+    Tag::UNIQUE_ID,
+    Tag::IDENTITY_CREDENTIAL_KEY,
+    Tag::STORAGE_KEY,
+    Tag::MAC_LENGTH,
+});
+
 // Returns true if this parameter may be passed to attestKey.
 bool isAttestationParameter(const KMV1::KeyParameter& param) {
-    switch (param.tag) {
-    case Tag::APPLICATION_ID:
-    case Tag::APPLICATION_DATA:
-    case Tag::ATTESTATION_CHALLENGE:
-    case Tag::ATTESTATION_APPLICATION_ID:
-    case Tag::ATTESTATION_ID_BRAND:
-    case Tag::ATTESTATION_ID_DEVICE:
-    case Tag::ATTESTATION_ID_PRODUCT:
-    case Tag::ATTESTATION_ID_SERIAL:
-    case Tag::ATTESTATION_ID_IMEI:
-    case Tag::ATTESTATION_ID_MEID:
-    case Tag::ATTESTATION_ID_MANUFACTURER:
-    case Tag::ATTESTATION_ID_MODEL:
-    case Tag::CERTIFICATE_SERIAL:
-    case Tag::CERTIFICATE_SUBJECT:
-    case Tag::CERTIFICATE_NOT_BEFORE:
-    case Tag::CERTIFICATE_NOT_AFTER:
-    case Tag::INCLUDE_UNIQUE_ID:
-    case Tag::DEVICE_UNIQUE_ATTESTATION:
-        return true;
-    default:
-        return false;
-    }
+    return testTagBit(kAttestationParameterBits, param.tag);
 }
 
 // Returns true if this parameter may be passed to generate/importKey.
 bool isKeyCreationParameter(const KMV1::KeyParameter& param) {
-    switch (param.tag) {
-    case Tag::APPLICATION_ID:
-    case Tag::APPLICATION_DATA:
-    case Tag::CERTIFICATE_SERIAL:
-    case Tag::CERTIFICATE_SUBJECT:
-    case Tag::CERTIFICATE_NOT_BEFORE:
-    case Tag::CERTIFICATE_NOT_AFTER:
-    case Tag::PURPOSE:
-    case Tag::ALGORITHM:
-    case Tag::KEY_SIZE:
-    case Tag::BLOCK_MODE:
-    case Tag::DIGEST:
-    case Tag::PADDING:
-    case Tag::CALLER_NONCE:
-    case Tag::MIN_MAC_LENGTH:
-    case Tag::EC_CURVE:
-    case Tag::RSA_PUBLIC_EXPONENT:
-    case Tag::RSA_OAEP_MGF_DIGEST:
-    case Tag::BOOTLOADER_ONLY:
-    case Tag::ROLLBACK_RESISTANCE:
-    case Tag::EARLY_BOOT_ONLY:
-    case Tag::ACTIVE_DATETIME:
-    case Tag::ORIGINATION_EXPIRE_DATETIME:
-    case Tag::USAGE_EXPIRE_DATETIME:
-    case Tag::MIN_SECONDS_BETWEEN_OPS:
-    case Tag::MAX_USES_PER_BOOT:
-    case Tag::USAGE_COUNT_LIMIT:
-    case Tag::USER_ID:
-    case Tag::USER_SECURE_ID:
-    case Tag::NO_AUTH_REQUIRED:
-    case Tag::USER_AUTH_TYPE:
-    case Tag::AUTH_TIMEOUT:
-    case Tag::ALLOW_WHILE_ON_BODY:
-    case Tag::TRUSTED_USER_PRESENCE_REQUIRED:
-    case Tag::TRUSTED_CONFIRMATION_REQUIRED:
-    case Tag::UNLOCKED_DEVICE_REQUIRED:
-    case Tag::CREATION_DATETIME:
-    case Tag::UNIQUE_ID:
-    case Tag::IDENTITY_CREDENTIAL_KEY:
-    case Tag::STORAGE_KEY:
-    case Tag::MAC_LENGTH:
-        return true;
-    default:
-        return false;
-    }
+    return testTagBit(kKeyCreationParameterBits, param.tag);
 }
 
 // Size of prefix for blobs, see keyBlobPrefix().
@@ -166,6 +195,15 @@ std::vector<uint8_t> keyBlobPrefix(const std::vector<uint8_t>& blob, bool isSoft
     return result;
 }
 
+// Rvalue overload: prefixes the blob in place instead of building a fresh
+// vector, for callers that are done with the unprefixed blob.
+std::vector<uint8_t> keyBlobPrefix(std::vector<uint8_t>&& blob, bool isSoftKeyMint) {
+    blob.insert(blob.begin(), kKeyBlobPrefixSize, 0);
+    std::copy(kKeyBlobMagic, kKeyBlobMagic + sizeof kKeyBlobMagic, blob.begin());
+    blob[kKeyBlobPrefixSize - 1] = isSoftKeyMint ? 1 : 0;
+    return std::move(blob);
+}
+
 // Helper for prefixedKeyBlobRemovePrefix() and prefixedKeyBlobIsSoftKeyMint().
 //
 // First bool is whether there's a valid prefix. If there is, the second bool is
@@ -200,6 +238,33 @@ std::vector<uint8_t> prefixedKeyBlobRemovePrefix(const std::vector<uint8_t>& pre
     return std::vector<uint8_t>(prefixedBlob.begin() + kKeyBlobPrefixSize, prefixedBlob.end());
 }
 
+// Wraps a caller-owned buffer in a non-owning hidl_vec so that handing it to
+// the HAL does not copy it. hwbinder maps the bytes straight into the shared
+// transaction buffer, so this is as close to a shared-memory handoff as the
+// hidl_vec-based Keymaster ABI permits. The view must not outlive |data|.
+static hidl_vec<uint8_t> viewOf(const std::vector<uint8_t>& data) {
+    hidl_vec<uint8_t> result;
+    result.setToExternal(const_cast<uint8_t*>(data.data()), data.size());
+    return result;
+}
+
+// Non-owning variant of prefixedKeyBlobRemovePrefix(). Returns a hidl_vec that
+// merely points into the passed-in blob, past the prefix if one is present, so
+// handing a blob to the legacy HAL does not copy it. The returned view must not
+// outlive |prefixedBlob|.
+//
+hidl_vec<uint8_t> prefixedKeyBlobRemovePrefixView(const std::vector<uint8_t>& prefixedBlob) {
+    const uint8_t* data = prefixedBlob.data();
+    size_t size = prefixedBlob.size();
+    if (prefixedKeyBlobParsePrefix(prefixedBlob).first) {
+        data += kKeyBlobPrefixSize;
+        size -= kKeyBlobPrefixSize;
+    }
+    hidl_vec<uint8_t> result;
+    result.setToExternal(const_cast<uint8_t*>(data), size);
+    return result;
+}
+
 // Returns true if the blob's origin is soft-KeyMint, false otherwise or if there
 // is no prefix on the passed-in blob.
 //
@@ -315,8 +380,10 @@ processLegacyCharacteristics(KeyMintSecurityLevel securityLevel,
         LOG(WARNING) << "Unexpected hardware enforced parameters.";
     }
 
+    std::vector<KeyCharacteristics> result;
     if (kmEnforcedOnly) {
-        return {kmEnforced};
+        result.push_back(std::move(kmEnforced));
+        return result;
     }
 
     KeyCharacteristics keystoreEnforced{KeyMintSecurityLevel::KEYSTORE, {}};
@@ -330,10 +397,15 @@ processLegacyCharacteristics(KeyMintSecurityLevel securityLevel,
     // Add all parameters that we know can be enforced by keystore but not by the legacy backend.
     auto unsupported_requested = extractNewAndKeystoreEnforceableParams(genParams);
     keystoreEnforced.authorizations.insert(keystoreEnforced.authorizations.end(),
-                                           std::begin(unsupported_requested),
-                                           std::end(unsupported_requested));
-
-    return {kmEnforced, keystoreEnforced};
+                                           std::make_move_iterator(unsupported_requested.begin()),
+                                           std::make_move_iterator(unsupported_requested.end()));
+
+    // Build the result by moving: the characteristics carry every parameter,
+    // including blob values, and returning them via an initializer list would
+    // copy each one.
+    result.push_back(std::move(kmEnforced));
+    result.push_back(std::move(keystoreEnforced));
+    return result;
 }
 
 static V4_0_KeyFormat convertKeyFormatToLegacy(const KeyFormat& kf) {
@@ -384,57 +456,242 @@ convertSharedSecretParametersToLegacy(const std::vector<SharedSecretParameters>&
     return ssps;
 }
 
+BlobCacheDigest blobCacheDigest(const std::vector<uint8_t>& keyBlob,
+                                const std::vector<uint8_t>& appId,
+                                const std::vector<uint8_t>& appData) {
+    // Hash the lengths along with the data so that moving bytes between the
+    // blob, appId, and appData fields can never produce the same digest.
+    BlobCacheDigest result;
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    auto hashField = [&](const std::vector<uint8_t>& field) {
+        uint64_t size = field.size();
+        SHA256_Update(&ctx, &size, sizeof(size));
+        SHA256_Update(&ctx, field.data(), field.size());
+    };
+    hashField(keyBlob);
+    hashField(appId);
+    hashField(appData);
+    SHA256_Final(result.data(), &ctx);
+    return result;
+}
+
+// How long a begin() call is willing to wait for an operation slot to be
+// freed before giving up with TOO_MANY_OPERATIONS. Operations are typically
+// short-lived, so briefly queueing smooths over bursts of concurrent begin()
+// calls that would otherwise bubble busy errors up to every caller.
+static const auto kSlotWaitTimeout = 1s;
+
+// How long an operation may sit without any client interaction before the
+// pruner considers it abandoned and may abort it to free its slot. Well above
+// any legitimate pause between update() calls; operations pinned this long
+// almost always belong to clients that crashed without aborting.
+static const auto kIdleOperationTimeout = 90s;
+
+// Once the pruning registry reaches this size, registering a new operation
+// first sweeps out entries whose operations are already gone, so the registry
+// cannot grow without bound in processes that never exhaust their slots.
+static const size_t kRegistrySweepThreshold = 64;
+
 void OperationSlots::setNumFreeSlots(uint8_t numFreeSlots) {
     std::lock_guard<std::mutex> lock(mNumFreeSlotsMutex);
     mNumFreeSlots = numFreeSlots;
+    mSlotFreed.notify_all();
 }
 
 bool OperationSlots::claimSlot() {
-    std::lock_guard<std::mutex> lock(mNumFreeSlotsMutex);
-    if (mNumFreeSlots > 0) {
-        mNumFreeSlots--;
-        return true;
+    std::unique_lock<std::mutex> lock(mNumFreeSlotsMutex);
+    if (mNumFreeSlots == 0) {
+        // All slots are pinned; before settling in to wait, try to reclaim
+        // one from an operation its client abandoned.
+        lock.unlock();
+        pruneIdleOperation();
+        lock.lock();
+    }
+    if (!mSlotFreed.wait_for(lock, kSlotWaitTimeout, [&] { return mNumFreeSlots > 0; })) {
+        return false;
     }
-    return false;
+    mNumFreeSlots--;
+    return true;
 }
 
 void OperationSlots::freeSlot() {
     std::lock_guard<std::mutex> lock(mNumFreeSlotsMutex);
     mNumFreeSlots++;
+    mSlotFreed.notify_one();
+}
+
+void OperationSlots::registerOperation(const std::shared_ptr<KeyMintOperation>& op) {
+    std::lock_guard<std::mutex> lock(mRegistryMutex);
+    if (mActiveOperations.size() >= kRegistrySweepThreshold) {
+        for (auto it = mActiveOperations.begin(); it != mActiveOperations.end();) {
+            it = it->second.expired() ? mActiveOperations.erase(it) : std::next(it);
+        }
+    }
+    mActiveOperations[op.get()] = op;
+}
+
+void OperationSlots::pruneIdleOperation() {
+    std::shared_ptr<KeyMintOperation> victim;
+    auto victimLastUsage = std::chrono::steady_clock::time_point::max();
+    {
+        std::lock_guard<std::mutex> lock(mRegistryMutex);
+        for (auto it = mActiveOperations.begin(); it != mActiveOperations.end();) {
+            auto op = it->second.lock();
+            if (!op || !op->holdsSlot()) {
+                it = mActiveOperations.erase(it);
+                continue;
+            }
+            if (op->lastUsage() < victimLastUsage) {
+                victimLastUsage = op->lastUsage();
+                victim = std::move(op);
+            }
+            ++it;
+        }
+    }
+    if (!victim || std::chrono::steady_clock::now() - victimLastUsage < kIdleOperationTimeout) {
+        return;
+    }
+    // The abort must run outside the registry lock: it frees the slot, and a
+    // racing client call on the victim may take the same locks.
+    LOG(WARNING) << "Aborting keymaster operation idle for "
+                 << std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::steady_clock::now() - victimLastUsage)
+                        .count()
+                 << "s to free an operation slot";
+    victim->abort();
 }
 
 void OperationSlot::freeSlot() {
-    if (mIsActive) {
+    // exchange() so a pruner abort racing the client's own finish/abort
+    // returns the slot exactly once.
+    if (mIsActive.exchange(false)) {
         mOperationSlots->freeSlot();
-        mIsActive = false;
     }
 }
 
 // KeyMintDevice implementation
 
 ScopedAStatus KeyMintDevice::getHardwareInfo(KeyMintHardwareInfo* _aidl_return) {
-    auto result = mDevice->halVersion();
-    _aidl_return->versionNumber = result.majorVersion * 10 + result.minorVersion;
-    securityLevel_ = convert(result.securityLevel);
-    _aidl_return->securityLevel = securityLevel_;
-    _aidl_return->keyMintName = result.keymasterName;
-    _aidl_return->keyMintAuthorName = result.authorName;
-    _aidl_return->timestampTokenRequired = securityLevel_ == KMV1::SecurityLevel::STRONGBOX;
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mHardwareInfoMutex);
+    if (!mHardwareInfo) {
+        auto result = mDevice->halVersion();
+        KeyMintHardwareInfo info;
+        info.versionNumber = result.majorVersion * 10 + result.minorVersion;
+        securityLevel_ = convert(result.securityLevel);
+        info.securityLevel = securityLevel_;
+        info.keyMintName = result.keymasterName;
+        info.keyMintAuthorName = result.authorName;
+        info.timestampTokenRequired = securityLevel_ == KMV1::SecurityLevel::STRONGBOX;
+        mHardwareInfo = std::move(info);
+    }
+    *_aidl_return = *mHardwareInfo;
     return ScopedAStatus::ok();
 }
 
+// Entropy contributions below this size are batched up in-process before
+// being mixed into the HAL's RNG, so frequent callers contributing a few
+// bytes at a time do not each pay a HAL round-trip. Mixing entropy is not
+// latency sensitive; deferring a contribution only delays when it takes
+// effect, it never weakens the pool.
+static const size_t kEntropyFlushThreshold = 512;
+
+// Keymaster 4.x rejects addRngEntropy inputs larger than 2 KiB.
+static const size_t kMaxEntropyChunkSize = 2 * 1024;
+
 ScopedAStatus KeyMintDevice::addRngEntropy(const std::vector<uint8_t>& in_data) {
-    auto result = mDevice->addRngEntropy(in_data);
-    if (!result.isOk()) {
-        LOG(ERROR) << __func__ << " transaction failed. " << result.description();
-        return convertErrorCode(KMV1::ErrorCode::UNKNOWN_ERROR);
+    ATRACE_CALL();
+    if (in_data.empty()) {
+        return convertErrorCode(KMV1::ErrorCode::OK);
     }
-    return convertErrorCode(result);
+
+    std::lock_guard<std::mutex> lock(mEntropyBufferMutex);
+    mEntropyBuffer.insert(mEntropyBuffer.end(), in_data.begin(), in_data.end());
+    if (mEntropyBuffer.size() < kEntropyFlushThreshold) {
+        return convertErrorCode(KMV1::ErrorCode::OK);
+    }
+
+    // Flush the batch, honoring the HAL's per-call input-size limit. The
+    // buffer is consumed even if a chunk fails: entropy that may already have
+    // been mixed in must not be replayed.
+    KMV1::ErrorCode errorCode = KMV1::ErrorCode::OK;
+    for (size_t pos = 0; pos < mEntropyBuffer.size() && errorCode == KMV1::ErrorCode::OK;
+         pos += kMaxEntropyChunkSize) {
+        size_t chunkSize = std::min(mEntropyBuffer.size() - pos, kMaxEntropyChunkSize);
+        hidl_vec<uint8_t> chunk;
+        chunk.setToExternal(mEntropyBuffer.data() + pos, chunkSize);
+        auto result = mDevice->addRngEntropy(chunk);
+        if (!result.isOk()) {
+            LOG(ERROR) << __func__ << " transaction failed. " << result.description();
+            errorCode = KMV1::ErrorCode::UNKNOWN_ERROR;
+        } else {
+            errorCode = convert(static_cast<V4_0_ErrorCode>(result));
+        }
+    }
+    mEntropyBuffer.clear();
+    mEntropyBuffer.shrink_to_fit();
+    return convertErrorCode(errorCode);
+}
+
+// Ephemeral P-256 signing keys for getCertificate()'s fallback path.
+//
+// When a generated key cannot self-sign its certificate, the certificate is
+// signed with a freshly generated ephemeral EC key. That keygen is pure CPU
+// work with no dependency on the HAL result, so generateKey() kicks it off
+// before issuing the HAL round-trip and the fallback path collects it
+// afterwards, overlapping the two instead of running them back to back.
+
+static keystore::EVP_PKEY_Ptr generateEphemeralEcKey() {
+    keystore::EVP_PKEY_CTX_Ptr pkey_ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL));
+    EVP_PKEY_keygen_init(pkey_ctx.get());
+    EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pkey_ctx.get(), NID_X9_62_prime256v1);
+    EVP_PKEY* pkey_ptr = nullptr;
+    EVP_PKEY_keygen(pkey_ctx.get(), &pkey_ptr);
+    return keystore::EVP_PKEY_Ptr(pkey_ptr);
+}
+
+static std::mutex ephemeralKeyFutureMutex;
+static std::future<keystore::EVP_PKEY_Ptr> ephemeralKeyFuture;
+
+// Starts generating an ephemeral signing key in the background, unless one is
+// already being generated.
+static void preGenerateEphemeralEcKey() {
+    std::lock_guard<std::mutex> lock(ephemeralKeyFutureMutex);
+    if (!ephemeralKeyFuture.valid()) {
+        ephemeralKeyFuture = std::async(std::launch::async, generateEphemeralEcKey);
+    }
+}
+
+// Returns a pre-generated ephemeral signing key if one was started, otherwise
+// generates one inline.
+static keystore::EVP_PKEY_Ptr takeEphemeralEcKey() {
+    std::future<keystore::EVP_PKEY_Ptr> future;
+    {
+        std::lock_guard<std::mutex> lock(ephemeralKeyFutureMutex);
+        if (ephemeralKeyFuture.valid()) {
+            future = std::move(ephemeralKeyFuture);
+        }
+    }
+    if (future.valid()) {
+        return future.get();
+    }
+    return generateEphemeralEcKey();
 }
 
 ScopedAStatus KeyMintDevice::generateKey(const std::vector<KeyParameter>& inKeyParams,
                                          const std::optional<AttestationKey>& in_attestationKey,
                                          KeyCreationResult* out_creationResult) {
+    return mDispatcher.dispatch([&] {
+        return generateKeyInternal(inKeyParams, in_attestationKey, out_creationResult);
+    });
+}
+
+ScopedAStatus
+KeyMintDevice::generateKeyInternal(const std::vector<KeyParameter>& inKeyParams,
+                                   const std::optional<AttestationKey>& in_attestationKey,
+                                   KeyCreationResult* out_creationResult) {
+    ATRACE_CALL();
 
     // Since KeyMaster doesn't support ECDH, route all key creation requests to
     // soft-KeyMint if and only an ECDH key is requested.
@@ -450,14 +707,27 @@ ScopedAStatus KeyMintDevice::generateKey(const std::vector<KeyParameter>& inKeyP
         if (keyParam.tag == Tag::PURPOSE &&
             keyParam.value.get<KeyParameterValue::Tag::keyPurpose>() == KeyPurpose::AGREE_KEY) {
             auto ret =
-                softKeyMintDevice_->generateKey(inKeyParams, in_attestationKey, out_creationResult);
+                softKeyMintDevice()->generateKey(inKeyParams, in_attestationKey, out_creationResult);
             if (ret.isOk()) {
-                out_creationResult->keyBlob = keyBlobPrefix(out_creationResult->keyBlob, true);
+                out_creationResult->keyBlob =
+                    keyBlobPrefix(std::move(out_creationResult->keyBlob), true);
             }
             return ret;
         }
     }
 
+    // Asymmetric keys get a certificate, which may need an ephemeral signing
+    // key; start generating one while the HAL call is in flight.
+    for (const auto& keyParam : inKeyParams) {
+        if (keyParam.tag == Tag::ALGORITHM) {
+            auto algorithm = keyParam.value.get<KeyParameterValue::Tag::algorithm>();
+            if (algorithm == Algorithm::RSA || algorithm == Algorithm::EC) {
+                preGenerateEphemeralEcKey();
+            }
+            break;
+        }
+    }
+
     auto legacyKeyGenParams = convertKeyParametersToLegacy(extractGenerationParams(inKeyParams));
     KMV1::ErrorCode errorCode;
     auto result = mDevice->generateKey(
@@ -479,7 +749,7 @@ ScopedAStatus KeyMintDevice::generateKey(const std::vector<KeyParameter>& inKeyP
             // We return OK in successful cases that do not generate a certificate.
             if (code != KMV1::ErrorCode::OK) {
                 errorCode = code;
-                deleteKey(out_creationResult->keyBlob);
+                deleteKeyInternal(out_creationResult->keyBlob);
             }
         } else {
             out_creationResult->certificateChain = std::get<std::vector<Certificate>>(cert);
@@ -491,12 +761,24 @@ ScopedAStatus KeyMintDevice::generateKey(const std::vector<KeyParameter>& inKeyP
 ScopedAStatus KeyMintDevice::importKey(const std::vector<KeyParameter>& inKeyParams,
                                        KeyFormat in_inKeyFormat,
                                        const std::vector<uint8_t>& in_inKeyData,
-                                       const std::optional<AttestationKey>& /* in_attestationKey */,
+                                       const std::optional<AttestationKey>& in_attestationKey,
                                        KeyCreationResult* out_creationResult) {
+    return mDispatcher.dispatch([&] {
+        return importKeyInternal(inKeyParams, in_inKeyFormat, in_inKeyData, in_attestationKey,
+                                 out_creationResult);
+    });
+}
+
+ScopedAStatus
+KeyMintDevice::importKeyInternal(const std::vector<KeyParameter>& inKeyParams,
+                                 KeyFormat in_inKeyFormat, const std::vector<uint8_t>& in_inKeyData,
+                                 const std::optional<AttestationKey>& /* in_attestationKey */,
+                                 KeyCreationResult* out_creationResult) {
+    ATRACE_CALL();
     auto legacyKeyGENParams = convertKeyParametersToLegacy(extractGenerationParams(inKeyParams));
     auto legacyKeyFormat = convertKeyFormatToLegacy(in_inKeyFormat);
     KMV1::ErrorCode errorCode;
-    auto result = mDevice->importKey(legacyKeyGENParams, legacyKeyFormat, in_inKeyData,
+    auto result = mDevice->importKey(legacyKeyGENParams, legacyKeyFormat, viewOf(in_inKeyData),
                                      [&](V4_0_ErrorCode error, const hidl_vec<uint8_t>& keyBlob,
                                          const V4_0_KeyCharacteristics& keyCharacteristics) {
                                          errorCode = convert(error);
@@ -517,7 +799,7 @@ ScopedAStatus KeyMintDevice::importKey(const std::vector<KeyParameter>& inKeyPar
             // We return OK in successful cases that do not generate a certificate.
             if (code != KMV1::ErrorCode::OK) {
                 errorCode = code;
-                deleteKey(out_creationResult->keyBlob);
+                deleteKeyInternal(out_creationResult->keyBlob);
             }
         } else {
             out_creationResult->certificateChain = std::get<std::vector<Certificate>>(cert);
@@ -533,10 +815,24 @@ KeyMintDevice::importWrappedKey(const std::vector<uint8_t>& in_inWrappedKeyData,
                                 const std::vector<KeyParameter>& in_inUnwrappingParams,
                                 int64_t in_inPasswordSid, int64_t in_inBiometricSid,
                                 KeyCreationResult* out_creationResult) {
+    return mDispatcher.dispatch([&] {
+        return importWrappedKeyInternal(in_inWrappedKeyData, in_inPrefixedWrappingKeyBlob,
+                                        in_inMaskingKey, in_inUnwrappingParams, in_inPasswordSid,
+                                        in_inBiometricSid, out_creationResult);
+    });
+}
+
+ScopedAStatus KeyMintDevice::importWrappedKeyInternal(
+    const std::vector<uint8_t>& in_inWrappedKeyData,
+    const std::vector<uint8_t>& in_inPrefixedWrappingKeyBlob,
+    const std::vector<uint8_t>& in_inMaskingKey,
+    const std::vector<KeyParameter>& in_inUnwrappingParams, int64_t in_inPasswordSid,
+    int64_t in_inBiometricSid, KeyCreationResult* out_creationResult) {
+    ATRACE_CALL();
     const std::vector<uint8_t>& wrappingKeyBlob =
         prefixedKeyBlobRemovePrefix(in_inPrefixedWrappingKeyBlob);
     if (prefixedKeyBlobIsSoftKeyMint(in_inPrefixedWrappingKeyBlob)) {
-        return softKeyMintDevice_->importWrappedKey(
+        return softKeyMintDevice()->importWrappedKey(
             in_inWrappedKeyData, wrappingKeyBlob, in_inMaskingKey, in_inUnwrappingParams,
             in_inPasswordSid, in_inBiometricSid, out_creationResult);
     }
@@ -544,7 +840,8 @@ KeyMintDevice::importWrappedKey(const std::vector<uint8_t>& in_inWrappedKeyData,
     auto legacyUnwrappingParams = convertKeyParametersToLegacy(in_inUnwrappingParams);
     KMV1::ErrorCode errorCode;
     auto result = mDevice->importWrappedKey(
-        in_inWrappedKeyData, wrappingKeyBlob, in_inMaskingKey, legacyUnwrappingParams,
+        viewOf(in_inWrappedKeyData), viewOf(wrappingKeyBlob), viewOf(in_inMaskingKey),
+        legacyUnwrappingParams,
         in_inPasswordSid, in_inBiometricSid,
         [&](V4_0_ErrorCode error, const hidl_vec<uint8_t>& keyBlob,
             const V4_0_KeyCharacteristics& keyCharacteristics) {
@@ -563,11 +860,39 @@ KeyMintDevice::importWrappedKey(const std::vector<uint8_t>& in_inWrappedKeyData,
 ScopedAStatus KeyMintDevice::upgradeKey(const std::vector<uint8_t>& in_inKeyBlobToUpgrade,
                                         const std::vector<KeyParameter>& in_inUpgradeParams,
                                         std::vector<uint8_t>* _aidl_return) {
+    return mDispatcher.dispatch([&] {
+        return upgradeKeyInternal(in_inKeyBlobToUpgrade, in_inUpgradeParams, _aidl_return);
+    });
+}
+
+ScopedAStatus KeyMintDevice::upgradeKeyInternal(const std::vector<uint8_t>& in_inKeyBlobToUpgrade,
+                                                const std::vector<KeyParameter>& in_inUpgradeParams,
+                                                std::vector<uint8_t>* _aidl_return) {
+    ATRACE_CALL();
+    // Upgrading the same blob with the same parameters is idempotent, so if
+    // several callers hold the same stale blob (or one caller retries before
+    // persisting the new blob) the HAL only needs to be asked once.
+    std::vector<uint8_t> appId;
+    std::vector<uint8_t> appData;
+    for (const auto& param : in_inUpgradeParams) {
+        if (param.tag == Tag::APPLICATION_ID) {
+            appId = param.value.get<KeyParameterValue::Tag::blob>();
+        } else if (param.tag == Tag::APPLICATION_DATA) {
+            appData = param.value.get<KeyParameterValue::Tag::blob>();
+        }
+    }
+    auto cacheKey = blobCacheDigest(in_inKeyBlobToUpgrade, appId, appData);
+    if (auto cached = mUpgradedKeyBlobCache.get(cacheKey)) {
+        *_aidl_return = std::move(*cached);
+        return convertErrorCode(KMV1::ErrorCode::OK);
+    }
+
     auto legacyUpgradeParams = convertKeyParametersToLegacy(in_inUpgradeParams);
     V4_0_ErrorCode errorCode;
 
     auto result =
-        mDevice->upgradeKey(prefixedKeyBlobRemovePrefix(in_inKeyBlobToUpgrade), legacyUpgradeParams,
+        mDevice->upgradeKey(prefixedKeyBlobRemovePrefixView(in_inKeyBlobToUpgrade),
+                            legacyUpgradeParams,
                             [&](V4_0_ErrorCode error, const hidl_vec<uint8_t>& upgradedKeyBlob) {
                                 errorCode = error;
                                 *_aidl_return = keyBlobPrefix(upgradedKeyBlob, false);
@@ -576,16 +901,23 @@ ScopedAStatus KeyMintDevice::upgradeKey(const std::vector<uint8_t>& in_inKeyBlob
         LOG(ERROR) << __func__ << " transaction failed. " << result.description();
         return convertErrorCode(KMV1::ErrorCode::UNKNOWN_ERROR);
     }
+    if (errorCode == V4_0_ErrorCode::OK) {
+        mUpgradedKeyBlobCache.put(cacheKey, *_aidl_return);
+    }
     return convertErrorCode(errorCode);
 }
 
 ScopedAStatus KeyMintDevice::deleteKey(const std::vector<uint8_t>& prefixedKeyBlob) {
-    const std::vector<uint8_t>& keyBlob = prefixedKeyBlobRemovePrefix(prefixedKeyBlob);
+    return mDispatcher.dispatch([&] { return deleteKeyInternal(prefixedKeyBlob); });
+}
+
+ScopedAStatus KeyMintDevice::deleteKeyInternal(const std::vector<uint8_t>& prefixedKeyBlob) {
+    ATRACE_CALL();
     if (prefixedKeyBlobIsSoftKeyMint(prefixedKeyBlob)) {
-        return softKeyMintDevice_->deleteKey(keyBlob);
+        return softKeyMintDevice()->deleteKey(prefixedKeyBlobRemovePrefix(prefixedKeyBlob));
     }
 
-    auto result = mDevice->deleteKey(keyBlob);
+    auto result = mDevice->deleteKey(prefixedKeyBlobRemovePrefixView(prefixedKeyBlob));
     if (!result.isOk()) {
         LOG(ERROR) << __func__ << " transaction failed. " << result.description();
         return convertErrorCode(KMV1::ErrorCode::UNKNOWN_ERROR);
@@ -593,8 +925,72 @@ ScopedAStatus KeyMintDevice::deleteKey(const std::vector<uint8_t>& prefixedKeyBl
     return convertErrorCode(result);
 }
 
+ScopedAStatus KeyMintDevice::deleteKeys(const std::vector<std::vector<uint8_t>>& prefixedKeyBlobs) {
+    ATRACE_CALL();
+
+    std::vector<const std::vector<uint8_t>*> hardwareBlobs;
+    std::vector<const std::vector<uint8_t>*> softwareBlobs;
+    for (const auto& prefixedKeyBlob : prefixedKeyBlobs) {
+        if (prefixedKeyBlobIsSoftKeyMint(prefixedKeyBlob)) {
+            softwareBlobs.push_back(&prefixedKeyBlob);
+        } else {
+            hardwareBlobs.push_back(&prefixedKeyBlob);
+        }
+    }
+
+    // The hardware deletes dominate (one HAL round-trip each), so run them on
+    // a worker while the soft-KeyMint deletes proceed on this thread.
+    auto hardwareResult = std::async(std::launch::async, [&]() {
+        KMV1::ErrorCode errorCode = KMV1::ErrorCode::OK;
+        for (const auto* prefixedKeyBlob : hardwareBlobs) {
+            auto result = mDevice->deleteKey(prefixedKeyBlobRemovePrefixView(*prefixedKeyBlob));
+            if (!result.isOk()) {
+                LOG(ERROR) << __func__ << " transaction failed. " << result.description();
+                if (errorCode == KMV1::ErrorCode::OK) errorCode = KMV1::ErrorCode::UNKNOWN_ERROR;
+            } else if (static_cast<V4_0_ErrorCode>(result) != V4_0_ErrorCode::OK &&
+                       errorCode == KMV1::ErrorCode::OK) {
+                errorCode = convert(static_cast<V4_0_ErrorCode>(result));
+            }
+        }
+        return errorCode;
+    });
+
+    KMV1::ErrorCode errorCode = KMV1::ErrorCode::OK;
+    for (const auto* prefixedKeyBlob : softwareBlobs) {
+        auto status = softKeyMintDevice()->deleteKey(prefixedKeyBlobRemovePrefix(*prefixedKeyBlob));
+        if (!status.isOk() && errorCode == KMV1::ErrorCode::OK) {
+            errorCode = toErrorCode(status);
+        }
+    }
+
+    auto hardwareErrorCode = hardwareResult.get();
+    if (errorCode == KMV1::ErrorCode::OK) {
+        errorCode = hardwareErrorCode;
+    }
+    return convertErrorCode(errorCode);
+}
+
 ScopedAStatus KeyMintDevice::deleteAllKeys() {
+    return mDispatcher.dispatch([&] { return deleteAllKeysInternal(); });
+}
+
+ScopedAStatus KeyMintDevice::deleteAllKeysInternal() {
+    ATRACE_CALL();
+    // If the soft-KeyMint fallback was ever instantiated it may hold keys of
+    // its own; wipe it concurrently with the hardware round-trip.
+    std::future<ScopedAStatus> softResult;
+    if (softKeyMintDevice_) {
+        softResult = std::async(std::launch::async,
+                                [this]() { return softKeyMintDevice_->deleteAllKeys(); });
+    }
+
     auto result = mDevice->deleteAllKeys();
+    if (softResult.valid()) {
+        auto status = softResult.get();
+        if (!status.isOk()) {
+            LOG(WARNING) << __func__ << " soft-KeyMint deleteAllKeys failed.";
+        }
+    }
     if (!result.isOk()) {
         LOG(ERROR) << __func__ << " transaction failed. " << result.description();
         return convertErrorCode(KMV1::ErrorCode::UNKNOWN_ERROR);
@@ -613,14 +1009,25 @@ ScopedAStatus KeyMintDevice::begin(KeyPurpose in_inPurpose,
                                    const std::vector<KeyParameter>& in_inParams,
                                    const std::optional<HardwareAuthToken>& in_inAuthToken,
                                    BeginResult* _aidl_return) {
+    return mDispatcher.dispatch([&] {
+        return beginInternal(in_inPurpose, prefixedKeyBlob, in_inParams, in_inAuthToken,
+                             _aidl_return);
+    });
+}
+
+ScopedAStatus KeyMintDevice::beginInternal(KeyPurpose in_inPurpose,
+                                           const std::vector<uint8_t>& prefixedKeyBlob,
+                                           const std::vector<KeyParameter>& in_inParams,
+                                           const std::optional<HardwareAuthToken>& in_inAuthToken,
+                                           BeginResult* _aidl_return) {
+    ATRACE_CALL();
     if (!mOperationSlots.claimSlot()) {
         return convertErrorCode(V4_0_ErrorCode::TOO_MANY_OPERATIONS);
     }
 
-    const std::vector<uint8_t>& in_inKeyBlob = prefixedKeyBlobRemovePrefix(prefixedKeyBlob);
     if (prefixedKeyBlobIsSoftKeyMint(prefixedKeyBlob)) {
-        return softKeyMintDevice_->begin(in_inPurpose, in_inKeyBlob, in_inParams, in_inAuthToken,
-                                         _aidl_return);
+        return softKeyMintDevice()->begin(in_inPurpose, prefixedKeyBlobRemovePrefix(prefixedKeyBlob),
+                                         in_inParams, in_inAuthToken, _aidl_return);
     }
 
     auto legacyPurpose =
@@ -629,14 +1036,19 @@ ScopedAStatus KeyMintDevice::begin(KeyPurpose in_inPurpose,
     auto legacyAuthToken = convertAuthTokenToLegacy(in_inAuthToken);
     KMV1::ErrorCode errorCode;
     auto result = mDevice->begin(
-        legacyPurpose, in_inKeyBlob, legacyParams, legacyAuthToken,
+        legacyPurpose, prefixedKeyBlobRemovePrefixView(prefixedKeyBlob), legacyParams,
+        legacyAuthToken,
         [&](V4_0_ErrorCode error, const hidl_vec<V4_0_KeyParameter>& outParams,
             uint64_t operationHandle) {
             errorCode = convert(error);
             _aidl_return->challenge = operationHandle;
             _aidl_return->params = convertKeyParametersFromLegacy(outParams);
-            _aidl_return->operation = ndk::SharedRefBase::make<KeyMintOperation>(
+            auto operation = ndk::SharedRefBase::make<KeyMintOperation>(
                 mDevice, operationHandle, &mOperationSlots, error == V4_0_ErrorCode::OK);
+            if (error == V4_0_ErrorCode::OK) {
+                mOperationSlots.registerOperation(operation);
+            }
+            _aidl_return->operation = std::move(operation);
         });
     if (!result.isOk()) {
         LOG(ERROR) << __func__ << " transaction failed. " << result.description();
@@ -674,6 +1086,7 @@ ScopedAStatus KeyMintDevice::earlyBootEnded() {
 ScopedAStatus
 KeyMintDevice::convertStorageKeyToEphemeral(const std::vector<uint8_t>& prefixedStorageKeyBlob,
                                             std::vector<uint8_t>* ephemeralKeyBlob) {
+    ATRACE_CALL();
     KMV1::ErrorCode km_error;
 
     /*
@@ -713,11 +1126,20 @@ KeyMintDevice::convertStorageKeyToEphemeral(const std::vector<uint8_t>& prefixed
 ScopedAStatus KeyMintDevice::getKeyCharacteristics(
     const std::vector<uint8_t>& prefixedKeyBlob, const std::vector<uint8_t>& appId,
     const std::vector<uint8_t>& appData, std::vector<KeyCharacteristics>* keyCharacteristics) {
+    ATRACE_CALL();
     auto [strippedKeyBlob, isSoftware] = dissectPrefixedKeyBlob(prefixedKeyBlob);
     if (isSoftware) {
-        return softKeyMintDevice_->getKeyCharacteristics(strippedKeyBlob, appId, appData,
+        return softKeyMintDevice()->getKeyCharacteristics(strippedKeyBlob, appId, appData,
                                                          keyCharacteristics);
     } else {
+        // Key characteristics are immutable for a given blob, so repeated
+        // queries can be answered from memory without a HAL round-trip.
+        auto cacheKey = blobCacheDigest(prefixedKeyBlob, appId, appData);
+        if (auto cached = mKeyCharacteristicsCache.get(cacheKey)) {
+            *keyCharacteristics = std::move(*cached);
+            return convertErrorCode(KMV1::ErrorCode::OK);
+        }
+
         KMV1::ErrorCode km_error;
         auto ret = mDevice->getKeyCharacteristics(
             strippedKeyBlob, appId, appData,
@@ -735,22 +1157,76 @@ ScopedAStatus KeyMintDevice::getKeyCharacteristics(
         if (km_error != KMV1::ErrorCode::OK) {
             LOG(ERROR) << __func__
                        << " getKeyCharacteristics failed with code: " << toString(km_error);
+        } else {
+            mKeyCharacteristicsCache.put(cacheKey, *keyCharacteristics);
         }
 
         return convertErrorCode(km_error);
     }
 }
 
+// Maximum payload forwarded to the legacy HAL per update() round-trip. V4.x
+// Keymaster implementations impose hard input-size limits well below the
+// binder transaction ceiling; chunking here lets callers pass arbitrarily
+// large buffers while each HAL call stays within those limits.
+static const size_t kUpdateChunkSize = 32 * 1024;
+
+void KeyMintDevice::getKeyCharacteristicsBatch(
+    const std::vector<KeyCharacteristicsRequest>& requests,
+    std::vector<KeyCharacteristicsBatchResult>* results) {
+    ATRACE_CALL();
+    results->clear();
+    results->resize(requests.size());
+
+    // Fan the queries out over a few workers. Each query is independent, and
+    // repeated blobs are served from the characteristics cache, so the
+    // speedup comes from overlapping the HAL round-trips of the misses.
+    // Keymaster HALs serialize at some depth, so a small worker count
+    // captures most of the available overlap.
+    constexpr size_t kMaxWorkers = 3;
+    size_t numWorkers = std::min(kMaxWorkers, requests.size());
+    std::atomic<size_t> nextIndex(0);
+
+    auto work = [&]() {
+        for (size_t i = nextIndex.fetch_add(1); i < requests.size(); i = nextIndex.fetch_add(1)) {
+            const auto& request = requests[i];
+            auto& result = (*results)[i];
+            auto status = getKeyCharacteristics(request.prefixedKeyBlob, request.appId,
+                                                request.appData, &result.characteristics);
+            result.error = status.isOk() ? KMV1::ErrorCode::OK : toErrorCode(status);
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    for (size_t i = 1; i < numWorkers; ++i) {
+        workers.push_back(std::async(std::launch::async, work));
+    }
+    if (numWorkers > 0) {
+        work();
+    }
+    for (auto& worker : workers) {
+        worker.get();
+    }
+}
+
 ScopedAStatus KeyMintOperation::updateAad(const std::vector<uint8_t>& input,
                                           const std::optional<HardwareAuthToken>& optAuthToken,
                                           const std::optional<TimeStampToken>& optTimeStampToken) {
+    ATRACE_CALL();
+    touch();
     V4_0_HardwareAuthToken authToken = convertAuthTokenToLegacy(optAuthToken);
     V4_0_VerificationToken verificationToken = convertTimestampTokenToLegacy(optTimeStampToken);
 
+    // Wrap the AAD in a non-owning blob parameter: makeKeyParameter() would
+    // copy the whole buffer just to tag it, and AAD for AEAD bulk operations
+    // can be as large as the payload itself.
+    hidl_vec<V4_0_KeyParameter> aadParams(1);
+    aadParams[0].tag = V4_0::TAG_ASSOCIATED_DATA;
+    aadParams[0].blob.setToExternal(const_cast<uint8_t*>(input.data()), input.size());
+
     KMV1::ErrorCode errorCode;
     auto result = mDevice->update(
-        mOperationHandle, {V4_0::makeKeyParameter(V4_0::TAG_ASSOCIATED_DATA, input)}, {}, authToken,
-        verificationToken,
+        mOperationHandle, aadParams, {}, authToken, verificationToken,
         [&](V4_0_ErrorCode error, auto, auto, auto) { errorCode = convert(error); });
 
     if (!result.isOk()) {
@@ -780,19 +1256,34 @@ ScopedAStatus KeyMintOperation::update(const std::vector<uint8_t>& input_raw,
                                        const std::optional<HardwareAuthToken>& optAuthToken,
                                        const std::optional<TimeStampToken>& optTimeStampToken,
                                        std::vector<uint8_t>* out_output) {
+    ATRACE_CALL();
+    touch();
     V4_0_HardwareAuthToken authToken = convertAuthTokenToLegacy(optAuthToken);
     V4_0_VerificationToken verificationToken = convertTimestampTokenToLegacy(optTimeStampToken);
 
     size_t inputPos = 0;
     *out_output = {};
     KMV1::ErrorCode errorCode = KMV1::ErrorCode::OK;
-    auto input = getExtendedUpdateBuffer(input_raw);
+    const auto& input = getExtendedUpdateBuffer(input_raw);
+
+    // For block ciphers the output is roughly as large as the input; reserving
+    // up front avoids repeated reallocation while the chunks stream back.
+    out_output->reserve(input.size());
 
     while (inputPos < input.size() && errorCode == KMV1::ErrorCode::OK) {
+        // Issue bounded chunks so that arbitrarily large inputs stay below the
+        // HAL's input-size limits, and hand each chunk to the HAL as a
+        // non-owning view into the input buffer. The previous code constructed
+        // a fresh hidl_vec holding everything from inputPos to the end on each
+        // round-trip, which copied the tail of the input O(n/chunk) times.
+        size_t chunkSize = std::min(input.size() - inputPos, kUpdateChunkSize);
+        hidl_vec<uint8_t> chunk;
+        chunk.setToExternal(const_cast<uint8_t*>(input.data()) + inputPos, chunkSize);
+
         uint32_t consumed = 0;
         auto result =
-            mDevice->update(mOperationHandle, {} /* inParams */,
-                            {input.begin() + inputPos, input.end()}, authToken, verificationToken,
+            mDevice->update(mOperationHandle, {} /* inParams */, chunk, authToken,
+                            verificationToken,
                             [&](V4_0_ErrorCode error, uint32_t inputConsumed, auto /* outParams */,
                                 const hidl_vec<uint8_t>& output) {
                                 errorCode = convert(error);
@@ -809,7 +1300,13 @@ ScopedAStatus KeyMintOperation::update(const std::vector<uint8_t>& input_raw,
             // Some very old KM implementations do not buffer sub blocks in certain block modes,
             // instead, the simply return consumed == 0. So we buffer the input here in the
             // hope that we complete the bock in a future call to update.
-            setUpdateBuffer({input.begin() + inputPos, input.end()});
+            if (&input == &mUpdateBuffer) {
+                // The unconsumed tail already lives in the carry buffer; drop
+                // the consumed prefix in place instead of rebuilding it.
+                mUpdateBuffer.erase(mUpdateBuffer.begin(), mUpdateBuffer.begin() + inputPos);
+            } else {
+                setUpdateBuffer({input.begin() + inputPos, input.end()});
+            }
             return convertErrorCode(errorCode);
         }
         inputPos += consumed;
@@ -827,9 +1324,14 @@ KeyMintOperation::finish(const std::optional<std::vector<uint8_t>>& in_input,
                          const std::optional<TimeStampToken>& in_timeStampToken,
                          const std::optional<std::vector<uint8_t>>& in_confirmationToken,
                          std::vector<uint8_t>* out_output) {
-    auto input_raw = in_input.value_or(std::vector<uint8_t>());
-    auto input = getExtendedUpdateBuffer(input_raw);
-    auto signature = in_signature.value_or(std::vector<uint8_t>());
+    ATRACE_CALL();
+    touch();
+    // Bind to the caller's buffers instead of copying them: value_or()
+    // returns by value, which duplicated the full finish payload.
+    static const std::vector<uint8_t> kEmptyVector;
+    const std::vector<uint8_t>& input_raw = in_input ? *in_input : kEmptyVector;
+    const auto& input = getExtendedUpdateBuffer(input_raw);
+    const std::vector<uint8_t>& signature = in_signature ? *in_signature : kEmptyVector;
     V4_0_HardwareAuthToken authToken = convertAuthTokenToLegacy(in_authToken);
     V4_0_VerificationToken verificationToken = convertTimestampTokenToLegacy(in_timeStampToken);
 
@@ -840,7 +1342,7 @@ KeyMintOperation::finish(const std::optional<std::vector<uint8_t>>& in_input,
 
     KMV1::ErrorCode errorCode;
     auto result = mDevice->finish(
-        mOperationHandle, inParams, input, signature, authToken, verificationToken,
+        mOperationHandle, inParams, viewOf(input), viewOf(signature), authToken, verificationToken,
         [&](V4_0_ErrorCode error, auto /* outParams */, const hidl_vec<uint8_t>& output) {
             errorCode = convert(error);
             *out_output = output;
@@ -855,6 +1357,7 @@ KeyMintOperation::finish(const std::optional<std::vector<uint8_t>>& in_input,
 }
 
 ScopedAStatus KeyMintOperation::abort() {
+    ATRACE_CALL();
     auto result = mDevice->abort(mOperationHandle);
     mOperationSlot.freeSlot();
     if (!result.isOk()) {
@@ -1118,8 +1621,11 @@ KeyMintDevice::signCertificate(const std::vector<KeyParameter>& keyParams,
                 kps.push_back(KMV1::makeKeyParameter(KMV1::TAG_PADDING, origPadding));
             }
             BeginResult beginResult;
-            auto error =
-                begin(KeyPurpose::SIGN, prefixedKeyBlob, kps, HardwareAuthToken(), &beginResult);
+            // Certificate signing already runs on this level's executor, so
+            // it must use the non-dispatching begin or it would deadlock
+            // waiting on its own queue.
+            auto error = beginInternal(KeyPurpose::SIGN, prefixedKeyBlob, kps, HardwareAuthToken(),
+                                       &beginResult);
             if (!error.isOk()) {
                 errorCode = toErrorCode(error);
                 return std::vector<uint8_t>();
@@ -1221,29 +1727,25 @@ KeyMintDevice::getCertificate(const std::vector<KeyParameter>& keyParams,
     if (!(canSelfSign && noAuthRequired)
         // or if self signing fails for any other reason,
         || signCertificate(keyParams, keyBlob, &*cert).has_value()) {
-        // we sign with ephemeral key.
-        keystore::EVP_PKEY_CTX_Ptr pkey_ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL));
-        EVP_PKEY_keygen_init(pkey_ctx.get());
-        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pkey_ctx.get(), NID_X9_62_prime256v1);
-        EVP_PKEY* pkey_ptr = nullptr;
-        EVP_PKEY_keygen(pkey_ctx.get(), &pkey_ptr);
-        error = keystore::signCert(&*cert, pkey_ptr);
+        // we sign with ephemeral key, preferably one pre-generated while the
+        // HAL call was in flight.
+        keystore::EVP_PKEY_Ptr pkey = takeEphemeralEcKey();
+        error = keystore::signCert(&*cert, pkey.get());
         if (error) {
             LOG(ERROR) << __func__ << ": signCert failed.";
             return KMV1::ErrorCode::UNKNOWN_ERROR;
         }
     }
 
-    // encodeCert
-    auto encodedCertOrError = keystore::encodeCert(&*cert);
-    if (std::holds_alternative<keystore::CertUtilsError>(encodedCertOrError)) {
+    // encodeCert directly into the parcelable's storage.
+    Certificate certificate;
+    if (keystore::encodeCertInto(&*cert, &certificate.encodedCertificate)) {
         LOG(ERROR) << __func__ << ": encodeCert failed.";
         return KMV1::ErrorCode::UNKNOWN_ERROR;
     }
 
-    Certificate certificate{.encodedCertificate =
-                                std::get<std::vector<uint8_t>>(encodedCertOrError)};
-    std::vector certificates = {certificate};
+    std::vector<Certificate> certificates;
+    certificates.push_back(std::move(certificate));
     return certificates;
 }
 
@@ -1360,15 +1862,85 @@ void KeyMintDevice::setNumFreeSlots(uint8_t numFreeSlots) {
 
 // Constructors and helpers.
 
+// One long-running HAL call should not back up the level that carries nearly
+// all traffic, so TRUSTED_ENVIRONMENT gets two executors; STRONGBOX and the
+// software fallback are serial devices in practice and get one.
+static size_t executorCountForLevel(KeyMintSecurityLevel securityLevel) {
+    return securityLevel == KeyMintSecurityLevel::TRUSTED_ENVIRONMENT ? 2 : 1;
+}
+
+LevelDispatcher::LevelDispatcher(KeyMintSecurityLevel securityLevel) {
+    size_t count = executorCountForLevel(securityLevel);
+    mExecutors.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        mExecutors.emplace_back([this] { workerLoop(); });
+    }
+}
+
+LevelDispatcher::~LevelDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mShutdown = true;
+    }
+    mWorkReady.notify_all();
+    for (auto& executor : mExecutors) {
+        executor.join();
+    }
+}
+
+size_t LevelDispatcher::queueDepth() const {
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    return mQueue.size();
+}
+
+void LevelDispatcher::enqueue(std::function<void()>&& work) {
+    std::unique_lock<std::mutex> lock(mQueueMutex);
+    if (mQueue.size() >= kMaxQueueDepth) {
+        LOG(WARNING) << "KeyMint dispatch queue full (" << mQueue.size()
+                     << " waiting); blocking until the level catches up.";
+        mQueueNotFull.wait(lock, [this] { return mQueue.size() < kMaxQueueDepth; });
+    }
+    mQueue.push_back(std::move(work));
+    lock.unlock();
+    mWorkReady.notify_one();
+}
+
+void LevelDispatcher::workerLoop() {
+    for (;;) {
+        std::function<void()> work;
+        {
+            std::unique_lock<std::mutex> lock(mQueueMutex);
+            mWorkReady.wait(lock, [this] { return mShutdown || !mQueue.empty(); });
+            if (mQueue.empty()) {
+                // Shut down only once drained, so every caller blocked in
+                // dispatch() still gets its result.
+                return;
+            }
+            work = std::move(mQueue.front());
+            mQueue.pop_front();
+        }
+        mQueueNotFull.notify_one();
+        work();
+    }
+}
+
 KeyMintDevice::KeyMintDevice(sp<Keymaster> device, KeyMintSecurityLevel securityLevel)
-    : mDevice(device), securityLevel_(securityLevel) {
+    : mDevice(device), securityLevel_(securityLevel), mDispatcher(securityLevel) {
     if (securityLevel == KeyMintSecurityLevel::STRONGBOX) {
         setNumFreeSlots(3);
     } else {
         setNumFreeSlots(15);
     }
+}
 
-    softKeyMintDevice_.reset(CreateKeyMintDevice(KeyMintSecurityLevel::SOFTWARE));
+const std::shared_ptr<IKeyMintDevice>& KeyMintDevice::softKeyMintDevice() {
+    // Constructed on first use: the soft-KeyMint fallback only serves ECDH
+    // keys and previously created software blobs, so most devices never need
+    // it and should not pay for building it with every KeyMintDevice.
+    std::call_once(softKeyMintDeviceFlag_, [&]() {
+        softKeyMintDevice_.reset(CreateKeyMintDevice(KeyMintSecurityLevel::SOFTWARE));
+    });
+    return softKeyMintDevice_;
 }
 
 sp<Keymaster> getDevice(KeyMintSecurityLevel securityLevel) {
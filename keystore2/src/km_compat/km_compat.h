@@ -23,8 +23,22 @@
 #include <aidl/android/hardware/security/sharedsecret/BnSharedSecret.h>
 #include <aidl/android/security/compat/BnKeystoreCompatService.h>
 #include <keymasterV4_1/Keymaster4.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include "certificate_utils.h"
 
@@ -50,15 +64,147 @@ using ::aidl::android::security::compat::BnKeystoreCompatService;
 using ::android::hardware::keymaster::V4_1::support::Keymaster;
 using ::ndk::ScopedAStatus;
 
+class KeyMintOperation;
+
 class OperationSlots {
   private:
     uint8_t mNumFreeSlots;
     std::mutex mNumFreeSlotsMutex;
+    std::condition_variable mSlotFreed;
+
+    // Live operations holding a slot, so that the pruner can find and abort
+    // the ones their clients abandoned. Entries are weak: an operation that
+    // was destroyed or already gave up its slot is swept out lazily.
+    std::mutex mRegistryMutex;
+    std::unordered_map<KeyMintOperation*, std::weak_ptr<KeyMintOperation>> mActiveOperations;
+
+    // Aborts the longest-idle registered operation if it has been idle beyond
+    // the pruning threshold, freeing its slot for a new begin() call.
+    void pruneIdleOperation();
 
   public:
     void setNumFreeSlots(uint8_t numFreeSlots);
+    // Claims a slot, waiting a bounded amount of time for one to be freed if
+    // they are all in use. When all slots are taken, an operation abandoned
+    // by its client (idle beyond the pruning threshold) is proactively
+    // aborted to make room. Returns false if no slot became available in
+    // time.
     bool claimSlot();
     void freeSlot();
+    // Makes an operation visible to the idle pruner.
+    void registerOperation(const std::shared_ptr<KeyMintOperation>& op);
+};
+
+// Cache key used by the LRU caches below: a SHA-256 digest over a key blob
+// and the APPLICATION_ID/APPLICATION_DATA parameters that scope it.
+using BlobCacheDigest = std::array<uint8_t, 32>;
+
+// Computes the cache digest for the given blob and app id/data.
+BlobCacheDigest blobCacheDigest(const std::vector<uint8_t>& keyBlob,
+                                const std::vector<uint8_t>& appId,
+                                const std::vector<uint8_t>& appData);
+
+// A bounded, digest-keyed LRU cache. Results of idempotent HAL queries for a
+// given blob (key characteristics, upgraded blobs) can be served from memory
+// instead of paying a HAL round-trip per query.
+template <typename Value> class BlobDigestLruCache {
+  public:
+    // Returns the cached value for the given digest or std::nullopt on a miss.
+    std::optional<Value> get(const BlobCacheDigest& digest) {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        auto i = mIndex.find(digest);
+        if (i == mIndex.end()) {
+            return std::nullopt;
+        }
+        // Move the entry to the front so that it is the last to be evicted.
+        mEntries.splice(mEntries.begin(), mEntries, i->second);
+        return i->second->second;
+    }
+
+    // Inserts the given value, evicting the least recently used entry if the
+    // cache is full.
+    void put(const BlobCacheDigest& digest, const Value& value) {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        auto i = mIndex.find(digest);
+        if (i != mIndex.end()) {
+            i->second->second = value;
+            mEntries.splice(mEntries.begin(), mEntries, i->second);
+            return;
+        }
+        if (mEntries.size() >= kCapacity) {
+            mIndex.erase(mEntries.back().first);
+            mEntries.pop_back();
+        }
+        mEntries.emplace_front(digest, value);
+        mIndex.emplace(digest, mEntries.begin());
+    }
+
+  private:
+    // Sized generously enough to cover a key enumeration pass while keeping
+    // the worst-case footprint small.
+    static constexpr size_t kCapacity = 100;
+
+    struct DigestHasher {
+        size_t operator()(const BlobCacheDigest& digest) const {
+            size_t result;
+            std::memcpy(&result, digest.data(), sizeof(result));
+            return result;
+        }
+    };
+
+    std::mutex mCacheMutex;
+    // Most recently used entries are at the front of the list.
+    std::list<std::pair<BlobCacheDigest, Value>> mEntries;
+    std::unordered_map<BlobCacheDigest, typename std::list<std::pair<BlobCacheDigest, Value>>::iterator,
+                       DigestHasher>
+        mIndex;
+};
+
+using KeyCharacteristicsCache = BlobDigestLruCache<std::vector<KeyCharacteristics>>;
+using UpgradedKeyBlobCache = BlobDigestLruCache<std::vector<uint8_t>>;
+
+// A bounded per-security-level dispatch queue. Each KeyMintDevice owns one:
+// binder threads enqueue the HAL-bound work and wait for its result while the
+// level's own executor threads make the actual HAL calls. A stalled level (a
+// StrongBox applet garbage-collecting, say) then queues up behind its own
+// executors instead of occupying one binder thread per in-flight call, and
+// TRUSTED_ENVIRONMENT traffic keeps flowing on its own executors. The queue
+// is bounded - enqueueing blocks once the bound is hit, backpressuring
+// callers of the stalled level without changing any error semantics - and its
+// depth is observable through queueDepth().
+class LevelDispatcher {
+  public:
+    explicit LevelDispatcher(KeyMintSecurityLevel securityLevel);
+    ~LevelDispatcher();
+
+    // Runs |work| on one of this level's executor threads and returns its
+    // result, blocking the calling thread until the work has run.
+    template <typename Work> auto dispatch(Work work) -> decltype(work()) {
+        std::packaged_task<decltype(work())()> task(std::move(work));
+        auto result = task.get_future();
+        // Capturing |task| by reference is safe: result.get() does not return
+        // before the executor has finished running it.
+        enqueue([&task] { task(); });
+        return result.get();
+    }
+
+    // Number of work items enqueued but not yet picked up by an executor.
+    size_t queueDepth() const;
+
+  private:
+    // Enqueued work beyond this bound blocks the enqueueing thread until an
+    // executor catches up, bounding how much work a stalled level can pile up.
+    static constexpr size_t kMaxQueueDepth = 16;
+
+    void enqueue(std::function<void()>&& work);
+    void workerLoop();
+
+    mutable std::mutex mQueueMutex;
+    std::condition_variable mWorkReady;
+    std::condition_variable mQueueNotFull;
+    std::deque<std::function<void()>> mQueue;
+    bool mShutdown = false;
+    std::vector<std::thread> mExecutors;
 };
 
 // An abstraction for a single operation slot.
@@ -67,14 +213,16 @@ class OperationSlots {
 class OperationSlot {
   private:
     OperationSlots* mOperationSlots;
-    bool mIsActive;
+    // Atomic because the idle pruner's abort() may race the client's own
+    // finish/abort for the same slot.
+    std::atomic<bool> mIsActive;
 
   public:
     OperationSlot(OperationSlots* slots, bool isActive)
         : mOperationSlots(slots), mIsActive(isActive) {}
 
     void freeSlot();
-    bool hasSlot() { return mIsActive; }
+    bool hasSlot() { return mIsActive.load(std::memory_order_relaxed); }
 };
 
 class KeyMintDevice : public aidl::android::hardware::security::keymint::BnKeyMintDevice {
@@ -123,6 +271,34 @@ class KeyMintDevice : public aidl::android::hardware::security::keymint::BnKeyMi
                           const std::vector<uint8_t>& appId, const std::vector<uint8_t>& appData,
                           std::vector<KeyCharacteristics>* keyCharacteristics) override;
 
+    // A single query of a batched getKeyCharacteristics call.
+    struct KeyCharacteristicsRequest {
+        std::vector<uint8_t> prefixedKeyBlob;
+        std::vector<uint8_t> appId;
+        std::vector<uint8_t> appData;
+    };
+
+    // Per-blob result of a batched getKeyCharacteristics call.
+    struct KeyCharacteristicsBatchResult {
+        KMV1_ErrorCode error;
+        std::vector<KeyCharacteristics> characteristics;
+    };
+
+    // Resolves characteristics for a batch of blobs, fanning the HAL queries
+    // out over a small number of workers instead of paying one serial
+    // round-trip per blob. Results are returned in request order. Not part of
+    // the AIDL interface (which is frozen); in-process callers enumerating
+    // large namespaces use this.
+    void getKeyCharacteristicsBatch(const std::vector<KeyCharacteristicsRequest>& requests,
+                                    std::vector<KeyCharacteristicsBatchResult>* results);
+
+    // Deletes a batch of keys in one call. The soft-KeyMint blobs are deleted
+    // on the calling thread while the hardware blobs are deleted on a worker,
+    // and per-blob errors are collapsed into the first failure. Not part of
+    // the AIDL interface (which is frozen); callers inside the process use
+    // this to avoid one binder-dispatch per blob.
+    ScopedAStatus deleteKeys(const std::vector<std::vector<uint8_t>>& prefixedKeyBlobs);
+
     // These are public to allow testing code to use them directly.
     // This class should not be used publicly anyway.
     std::variant<std::vector<Certificate>, KMV1_ErrorCode>
@@ -133,9 +309,66 @@ class KeyMintDevice : public aidl::android::hardware::security::keymint::BnKeyMi
   private:
     std::optional<KMV1_ErrorCode> signCertificate(const std::vector<KeyParameter>& keyParams,
                                                   const std::vector<uint8_t>& keyBlob, X509* cert);
+
+    // Non-dispatching implementations of the AIDL entry points above. The
+    // public methods route through mDispatcher; code already running on an
+    // executor (e.g. certificate signing inside generateKey) must call these
+    // directly or a single-executor level would deadlock on its own queue.
+    ScopedAStatus generateKeyInternal(const std::vector<KeyParameter>& inKeyParams,
+                                      const std::optional<AttestationKey>& in_attestationKey,
+                                      KeyCreationResult* out_creationResult);
+    ScopedAStatus importKeyInternal(const std::vector<KeyParameter>& inKeyParams,
+                                    KeyFormat in_inKeyFormat,
+                                    const std::vector<uint8_t>& in_inKeyData,
+                                    const std::optional<AttestationKey>& in_attestationKey,
+                                    KeyCreationResult* out_creationResult);
+    ScopedAStatus importWrappedKeyInternal(const std::vector<uint8_t>& in_inWrappedKeyData,
+                                           const std::vector<uint8_t>& in_inPrefixedWrappingKeyBlob,
+                                           const std::vector<uint8_t>& in_inMaskingKey,
+                                           const std::vector<KeyParameter>& in_inUnwrappingParams,
+                                           int64_t in_inPasswordSid, int64_t in_inBiometricSid,
+                                           KeyCreationResult* out_creationResult);
+    ScopedAStatus upgradeKeyInternal(const std::vector<uint8_t>& in_inKeyBlobToUpgrade,
+                                     const std::vector<KeyParameter>& in_inUpgradeParams,
+                                     std::vector<uint8_t>* _aidl_return);
+    ScopedAStatus deleteKeyInternal(const std::vector<uint8_t>& prefixedKeyBlob);
+    ScopedAStatus deleteAllKeysInternal();
+    ScopedAStatus beginInternal(KeyPurpose in_inPurpose,
+                                const std::vector<uint8_t>& prefixedKeyBlob,
+                                const std::vector<KeyParameter>& in_inParams,
+                                const std::optional<HardwareAuthToken>& in_inAuthToken,
+                                BeginResult* _aidl_return);
+
     KeyMintSecurityLevel securityLevel_;
 
-    // Software-based KeyMint device used to implement ECDH.
+    // Serializes this level's HAL-bound work onto the level's own executor
+    // threads, isolating a stalled level from the shared binder threadpool.
+    LevelDispatcher mDispatcher;
+
+    // Serves repeated characteristics queries for the same blob from memory.
+    KeyCharacteristicsCache mKeyCharacteristicsCache;
+
+    // Remembers the result of upgrading a blob, so that callers which race to
+    // upgrade the same key (or retry before persisting the new blob) do not
+    // each pay an upgradeKey round-trip.
+    UpgradedKeyBlobCache mUpgradedKeyBlobCache;
+
+    // Accumulates small addRngEntropy contributions until enough bytes are
+    // batched up to be worth a HAL round-trip.
+    std::mutex mEntropyBufferMutex;
+    std::vector<uint8_t> mEntropyBuffer;
+
+    // The hardware info never changes for the lifetime of the device, so it
+    // is fetched once and memoized.
+    std::mutex mHardwareInfoMutex;
+    std::optional<KeyMintHardwareInfo> mHardwareInfo;
+
+    // Returns the software-based KeyMint device used to implement ECDH,
+    // constructing it on first use. Most devices never touch the soft-KeyMint
+    // paths, so the fallback is not built eagerly.
+    const std::shared_ptr<IKeyMintDevice>& softKeyMintDevice();
+
+    std::once_flag softKeyMintDeviceFlag_;
     std::shared_ptr<IKeyMintDevice> softKeyMintDevice_;
 };
 
@@ -143,9 +376,23 @@ class KeyMintOperation : public aidl::android::hardware::security::keymint::BnKe
   public:
     KeyMintOperation(::android::sp<Keymaster> device, uint64_t operationHandle,
                      OperationSlots* slots, bool isActive)
-        : mDevice(device), mOperationHandle(operationHandle), mOperationSlot(slots, isActive) {}
+        : mDevice(device), mOperationHandle(operationHandle), mOperationSlot(slots, isActive) {
+        touch();
+    }
     ~KeyMintOperation();
 
+    // Stamps the operation as just used. Called on every client interaction,
+    // so idle age measures time since the client last made progress.
+    void touch() {
+        mLastUsageNanos.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                              std::memory_order_relaxed);
+    }
+    std::chrono::steady_clock::time_point lastUsage() const {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(mLastUsageNanos.load(std::memory_order_relaxed)));
+    }
+    bool holdsSlot() { return mOperationSlot.hasSlot(); }
+
     ScopedAStatus updateAad(const std::vector<uint8_t>& input,
                             const std::optional<HardwareAuthToken>& authToken,
                             const std::optional<TimeStampToken>& timestampToken) override;
@@ -182,6 +429,7 @@ class KeyMintOperation : public aidl::android::hardware::security::keymint::BnKe
     ::android::sp<Keymaster> mDevice;
     uint64_t mOperationHandle;
     OperationSlot mOperationSlot;
+    std::atomic<int64_t> mLastUsageNanos;
 };
 
 class SharedSecret : public aidl::android::hardware::security::sharedsecret::BnSharedSecret {
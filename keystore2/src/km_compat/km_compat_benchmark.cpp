@@ -0,0 +1,126 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "km_compat.h"
+#include "km_compat_type_conversion.h"
+#include <keymint_support/keymint_tags.h>
+
+// Microbenchmarks for the CPU-bound pieces of the km_compat layer: key blob
+// prefix handling, the blob digest used by the in-process caches, and
+// KeyParameter conversion between the KeyMint and Keymaster 4.x types.
+// HAL-dependent paths are deliberately not benchmarked here; their cost is
+// dominated by the HAL round-trip.
+
+using ::android::hardware::hidl_vec;
+
+// Defined in km_compat.cpp.
+std::vector<uint8_t> keyBlobPrefix(const std::vector<uint8_t>& blob, bool isSoftKeyMint);
+std::vector<uint8_t> keyBlobPrefix(std::vector<uint8_t>&& blob, bool isSoftKeyMint);
+std::vector<uint8_t> prefixedKeyBlobRemovePrefix(const std::vector<uint8_t>& prefixedBlob);
+hidl_vec<uint8_t> prefixedKeyBlobRemovePrefixView(const std::vector<uint8_t>& prefixedBlob);
+
+static std::vector<uint8_t> makeBlob(size_t size) {
+    std::vector<uint8_t> blob(size);
+    for (size_t i = 0; i < size; ++i) {
+        blob[i] = static_cast<uint8_t>(i);
+    }
+    return blob;
+}
+
+static void BM_KeyBlobPrefix(benchmark::State& state) {
+    auto blob = makeBlob(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(keyBlobPrefix(blob, false));
+    }
+}
+BENCHMARK(BM_KeyBlobPrefix)->Arg(512)->Arg(4 * 1024)->Arg(64 * 1024);
+
+static void BM_KeyBlobPrefixInPlace(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto blob = makeBlob(state.range(0));
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(keyBlobPrefix(std::move(blob), false));
+    }
+}
+BENCHMARK(BM_KeyBlobPrefixInPlace)->Arg(512)->Arg(4 * 1024)->Arg(64 * 1024);
+
+static void BM_PrefixedKeyBlobRemovePrefix(benchmark::State& state) {
+    auto prefixed = keyBlobPrefix(makeBlob(state.range(0)), false);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prefixedKeyBlobRemovePrefix(prefixed));
+    }
+}
+BENCHMARK(BM_PrefixedKeyBlobRemovePrefix)->Arg(512)->Arg(4 * 1024)->Arg(64 * 1024);
+
+static void BM_PrefixedKeyBlobRemovePrefixView(benchmark::State& state) {
+    auto prefixed = keyBlobPrefix(makeBlob(state.range(0)), false);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prefixedKeyBlobRemovePrefixView(prefixed));
+    }
+}
+BENCHMARK(BM_PrefixedKeyBlobRemovePrefixView)->Arg(512)->Arg(4 * 1024)->Arg(64 * 1024);
+
+static void BM_BlobCacheDigest(benchmark::State& state) {
+    auto blob = makeBlob(state.range(0));
+    auto appId = makeBlob(16);
+    auto appData = makeBlob(16);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(blobCacheDigest(blob, appId, appData));
+    }
+}
+BENCHMARK(BM_BlobCacheDigest)->Arg(512)->Arg(4 * 1024)->Arg(64 * 1024);
+
+static std::vector<KMV1::KeyParameter> makeKeyMintParams() {
+    return {
+        KMV1::makeKeyParameter(KMV1::TAG_ALGORITHM, KMV1::Algorithm::AES),
+        KMV1::makeKeyParameter(KMV1::TAG_KEY_SIZE, 256),
+        KMV1::makeKeyParameter(KMV1::TAG_BLOCK_MODE, KMV1::BlockMode::GCM),
+        KMV1::makeKeyParameter(KMV1::TAG_PADDING, KMV1::PaddingMode::NONE),
+        KMV1::makeKeyParameter(KMV1::TAG_MIN_MAC_LENGTH, 128),
+        KMV1::makeKeyParameter(KMV1::TAG_NO_AUTH_REQUIRED, true),
+        KMV1::makeKeyParameter(KMV1::TAG_PURPOSE, KMV1::KeyPurpose::ENCRYPT),
+        KMV1::makeKeyParameter(KMV1::TAG_PURPOSE, KMV1::KeyPurpose::DECRYPT),
+        KMV1::makeKeyParameter(KMV1::TAG_APPLICATION_ID, std::vector<uint8_t>(32, 0xaa)),
+    };
+}
+
+static void BM_ConvertKeyParameterToLegacy(benchmark::State& state) {
+    auto params = makeKeyMintParams();
+    for (auto _ : state) {
+        for (const auto& param : params) {
+            benchmark::DoNotOptimize(convertKeyParameterToLegacy(param));
+        }
+    }
+}
+BENCHMARK(BM_ConvertKeyParameterToLegacy);
+
+static void BM_ConvertKeyParameterFromLegacy(benchmark::State& state) {
+    std::vector<V4_0::KeyParameter> legacyParams;
+    for (const auto& param : makeKeyMintParams()) {
+        legacyParams.push_back(convertKeyParameterToLegacy(param));
+    }
+    for (auto _ : state) {
+        for (const auto& param : legacyParams) {
+            benchmark::DoNotOptimize(convertKeyParameterFromLegacy(param));
+        }
+    }
+}
+BENCHMARK(BM_ConvertKeyParameterFromLegacy);
+
+BENCHMARK_MAIN();
@@ -24,7 +24,12 @@ namespace V4_0 = ::android::hardware::keymaster::V4_0;
 namespace V4_1 = ::android::hardware::keymaster::V4_1;
 namespace KMV1 = ::aidl::android::hardware::security::keymint;
 
-static KMV1::ErrorCode convert(V4_0::ErrorCode error) {
+// The scalar enum converters below are constexpr so that conversions of
+// compile-time-known values (e.g. the fixed tags used when assembling
+// parameter lists) fold away entirely. For runtime values the switches
+// compile down to lookup tables; there is no per-call dispatch cost.
+
+static constexpr KMV1::ErrorCode convert(V4_0::ErrorCode error) {
     switch (error) {
     case V4_0::ErrorCode::OK:
         return KMV1::ErrorCode::OK;
@@ -177,7 +182,7 @@ static KMV1::ErrorCode convert(V4_0::ErrorCode error) {
     }
 }
 
-static std::optional<V4_0::KeyPurpose> convert(KMV1::KeyPurpose p) {
+static constexpr std::optional<V4_0::KeyPurpose> convert(KMV1::KeyPurpose p) {
     switch (p) {
     case KMV1::KeyPurpose::ENCRYPT:
         return V4_0::KeyPurpose::ENCRYPT;
@@ -195,7 +200,7 @@ static std::optional<V4_0::KeyPurpose> convert(KMV1::KeyPurpose p) {
     }
 }
 
-static KMV1::KeyPurpose convert(V4_0::KeyPurpose p) {
+static constexpr KMV1::KeyPurpose convert(V4_0::KeyPurpose p) {
     switch (p) {
     case V4_0::KeyPurpose::ENCRYPT:
         return KMV1::KeyPurpose::ENCRYPT;
@@ -210,7 +215,7 @@ static KMV1::KeyPurpose convert(V4_0::KeyPurpose p) {
     }
 }
 
-static V4_0::Algorithm convert(KMV1::Algorithm a) {
+static constexpr V4_0::Algorithm convert(KMV1::Algorithm a) {
     switch (a) {
     case KMV1::Algorithm::RSA:
         return V4_0::Algorithm::RSA;
@@ -225,7 +230,7 @@ static V4_0::Algorithm convert(KMV1::Algorithm a) {
     }
 }
 
-static KMV1::Algorithm convert(V4_0::Algorithm a) {
+static constexpr KMV1::Algorithm convert(V4_0::Algorithm a) {
     switch (a) {
     case V4_0::Algorithm::RSA:
         return KMV1::Algorithm::RSA;
@@ -240,7 +245,7 @@ static KMV1::Algorithm convert(V4_0::Algorithm a) {
     }
 }
 
-static V4_0::Digest convert(KMV1::Digest d) {
+static constexpr V4_0::Digest convert(KMV1::Digest d) {
     switch (d) {
     case KMV1::Digest::NONE:
         return V4_0::Digest::NONE;
@@ -259,7 +264,7 @@ static V4_0::Digest convert(KMV1::Digest d) {
     }
 }
 
-static KMV1::Digest convert(V4_0::Digest d) {
+static constexpr KMV1::Digest convert(V4_0::Digest d) {
     switch (d) {
     case V4_0::Digest::NONE:
         return KMV1::Digest::NONE;
@@ -278,7 +283,7 @@ static KMV1::Digest convert(V4_0::Digest d) {
     }
 }
 
-static V4_0::EcCurve convert(KMV1::EcCurve e) {
+static constexpr V4_0::EcCurve convert(KMV1::EcCurve e) {
     switch (e) {
     case KMV1::EcCurve::P_224:
         return V4_0::EcCurve::P_224;
@@ -291,7 +296,7 @@ static V4_0::EcCurve convert(KMV1::EcCurve e) {
     }
 }
 
-static KMV1::EcCurve convert(V4_0::EcCurve e) {
+static constexpr KMV1::EcCurve convert(V4_0::EcCurve e) {
     switch (e) {
     case V4_0::EcCurve::P_224:
         return KMV1::EcCurve::P_224;
@@ -304,7 +309,7 @@ static KMV1::EcCurve convert(V4_0::EcCurve e) {
     }
 }
 
-static V4_0::BlockMode convert(KMV1::BlockMode b) {
+static constexpr V4_0::BlockMode convert(KMV1::BlockMode b) {
     switch (b) {
     case KMV1::BlockMode::ECB:
         return V4_0::BlockMode::ECB;
@@ -317,7 +322,7 @@ static V4_0::BlockMode convert(KMV1::BlockMode b) {
     }
 }
 
-static KMV1::BlockMode convert(V4_0::BlockMode b) {
+static constexpr KMV1::BlockMode convert(V4_0::BlockMode b) {
     switch (b) {
     case V4_0::BlockMode::ECB:
         return KMV1::BlockMode::ECB;
@@ -330,7 +335,7 @@ static KMV1::BlockMode convert(V4_0::BlockMode b) {
     }
 }
 
-static V4_0::PaddingMode convert(KMV1::PaddingMode p) {
+static constexpr V4_0::PaddingMode convert(KMV1::PaddingMode p) {
     switch (p) {
     case KMV1::PaddingMode::NONE:
         return V4_0::PaddingMode::NONE;
@@ -347,7 +352,7 @@ static V4_0::PaddingMode convert(KMV1::PaddingMode p) {
     }
 }
 
-static KMV1::PaddingMode convert(V4_0::PaddingMode p) {
+static constexpr KMV1::PaddingMode convert(V4_0::PaddingMode p) {
     switch (p) {
     case V4_0::PaddingMode::NONE:
         return KMV1::PaddingMode::NONE;
@@ -364,7 +369,7 @@ static KMV1::PaddingMode convert(V4_0::PaddingMode p) {
     }
 }
 
-static V4_0::HardwareAuthenticatorType convert(KMV1::HardwareAuthenticatorType h) {
+static constexpr V4_0::HardwareAuthenticatorType convert(KMV1::HardwareAuthenticatorType h) {
     uint32_t result = 0;
     uint32_t hat = static_cast<uint32_t>(h);
     if (hat & static_cast<uint32_t>(KMV1::HardwareAuthenticatorType::PASSWORD)) {
@@ -376,7 +381,7 @@ static V4_0::HardwareAuthenticatorType convert(KMV1::HardwareAuthenticatorType h
     return static_cast<V4_0::HardwareAuthenticatorType>(result);
 }
 
-static KMV1::HardwareAuthenticatorType convert(V4_0::HardwareAuthenticatorType h) {
+static constexpr KMV1::HardwareAuthenticatorType convert(V4_0::HardwareAuthenticatorType h) {
     uint32_t result = 0;
     if ((uint32_t)h & (uint32_t)V4_0::HardwareAuthenticatorType::PASSWORD) {
         result |= (uint32_t)KMV1::HardwareAuthenticatorType::PASSWORD;
@@ -387,7 +392,7 @@ static KMV1::HardwareAuthenticatorType convert(V4_0::HardwareAuthenticatorType h
     return static_cast<KMV1::HardwareAuthenticatorType>(result);
 }
 
-static V4_0::SecurityLevel convert(KMV1::SecurityLevel s) {
+static constexpr V4_0::SecurityLevel convert(KMV1::SecurityLevel s) {
     switch (s) {
     case KMV1::SecurityLevel::SOFTWARE:
         return V4_0::SecurityLevel::SOFTWARE;
@@ -400,7 +405,7 @@ static V4_0::SecurityLevel convert(KMV1::SecurityLevel s) {
     }
 }
 
-static KMV1::SecurityLevel convert(V4_0::SecurityLevel s) {
+static constexpr KMV1::SecurityLevel convert(V4_0::SecurityLevel s) {
     switch (s) {
     case V4_0::SecurityLevel::SOFTWARE:
         return KMV1::SecurityLevel::SOFTWARE;
@@ -411,7 +416,7 @@ static KMV1::SecurityLevel convert(V4_0::SecurityLevel s) {
     }
 }
 
-static V4_0::KeyOrigin convert(KMV1::KeyOrigin o) {
+static constexpr V4_0::KeyOrigin convert(KMV1::KeyOrigin o) {
     switch (o) {
     case KMV1::KeyOrigin::GENERATED:
         return V4_0::KeyOrigin::GENERATED;
@@ -426,7 +431,7 @@ static V4_0::KeyOrigin convert(KMV1::KeyOrigin o) {
     }
 }
 
-static KMV1::KeyOrigin convert(V4_0::KeyOrigin o) {
+static constexpr KMV1::KeyOrigin convert(V4_0::KeyOrigin o) {
     switch (o) {
     case V4_0::KeyOrigin::GENERATED:
         return KMV1::KeyOrigin::GENERATED;
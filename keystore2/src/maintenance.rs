@@ -127,6 +127,12 @@ impl Maintenance {
         // Permission check. Must return on error. Do not touch the '?'.
         check_keystore_permission(KeystorePerm::clear_uid()).context("In clear_namespace.")?;
 
+        // This is driven by package changes (e.g. an app being removed), so the
+        // cached attestation application id for the uid is no longer valid.
+        if domain == Domain::APP {
+            keystore2_aaid::invalidate_aaid(nspace as u32);
+        }
+
         LEGACY_IMPORTER
             .bulk_delete_uid(domain, nspace)
             .context("In clear_namespace: Trying to delete legacy keys.")?;
@@ -1028,9 +1028,10 @@ impl SuperKeyManager {
             let km_dev: KeyMintDevice = KeyMintDevice::get(SecurityLevel::TRUSTED_ENVIRONMENT)
                 .context("In try_unlock_user_with_biometric: KeyMintDevice::get failed")?;
             for sid in &biometric.sids {
-                if let Some((auth_token_entry, _)) = db.find_auth_token_entry(|entry| {
-                    entry.auth_token().userId == *sid || entry.auth_token().authenticatorId == *sid
-                }) {
+                // The SID index covers exactly this match (user or authenticator id).
+                if let Some((auth_token_entry, _)) =
+                    db.find_auth_token_entry_for_sids(&[*sid], |_| true)
+                {
                     let res: Result<(Arc<SuperKey>, Arc<SuperKey>)> = (|| {
                         let slb = biometric.screen_lock_bound.decrypt(
                             db,
@@ -16,9 +16,20 @@
 
 #include "vintf.hpp"
 
+#include <map>
+#include <mutex>
+#include <tuple>
+
 #include <vintf/HalManifest.h>
 #include <vintf/VintfObject.h>
 
+// The device manifest is immutable for the life of the process, so the
+// instance set for a given (package, version, interface) query never changes.
+// The instance queries below are made whenever keystore2 routes a security
+// level or enumerates KeyMint instances, and libvintf re-walks its manifest
+// structures on each call, so the answers are memoized here.
+static std::mutex gCacheMutex;
+
 // Converts a set<string> into a C-style array of C strings.
 static char** convert(const std::set<std::string>& names) {
     char** ret = new char*[names.size()];
@@ -45,19 +56,39 @@ char** getHalNamesAndVersions(size_t* len) {
 
 char** getHidlInstances(size_t* len, const char* package, size_t major_version,
                         size_t minor_version, const char* interfaceName) {
-    android::vintf::Version version(major_version, minor_version);
-    auto manifest = android::vintf::VintfObject::GetDeviceHalManifest();
-    const auto names = manifest->getHidlInstances(package, version, interfaceName);
-    *len = names.size();
-    return convert(names);
+    using Key = std::tuple<std::string, size_t, size_t, std::string>;
+    static std::map<Key, std::set<std::string>> cache;
+
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    Key key(package, major_version, minor_version, interfaceName);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        android::vintf::Version version(major_version, minor_version);
+        auto manifest = android::vintf::VintfObject::GetDeviceHalManifest();
+        it = cache.emplace(std::move(key), manifest->getHidlInstances(package, version,
+                                                                      interfaceName))
+                 .first;
+    }
+    *len = it->second.size();
+    return convert(it->second);
 }
 
 char** getAidlInstances(size_t* len, const char* package, size_t version,
                         const char* interfaceName) {
-    auto manifest = android::vintf::VintfObject::GetDeviceHalManifest();
-    const auto names = manifest->getAidlInstances(package, version, interfaceName);
-    *len = names.size();
-    return convert(names);
+    using Key = std::tuple<std::string, size_t, std::string>;
+    static std::map<Key, std::set<std::string>> cache;
+
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    Key key(package, version, interfaceName);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        auto manifest = android::vintf::VintfObject::GetDeviceHalManifest();
+        it = cache.emplace(std::move(key), manifest->getAidlInstances(package, version,
+                                                                      interfaceName))
+                 .first;
+    }
+    *len = it->second.size();
+    return convert(it->second);
 }
 
 void freeNames(char** names, size_t len) {
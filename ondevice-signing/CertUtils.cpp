@@ -24,6 +24,8 @@
 #include <openssl/x509v3.h>
 
 #include <fcntl.h>
+#include <map>
+#include <mutex>
 #include <vector>
 
 #include "KeyConstants.h"
@@ -214,7 +216,7 @@ Result<std::vector<uint8_t>> extractPublicKeyFromX509(const std::string& path) {
     return extractPublicKey(X509_get_pubkey(cert));
 }
 
-Result<std::vector<uint8_t>> createPkcs7(const std::vector<uint8_t>& signed_digest) {
+static Result<std::vector<uint8_t>> buildPkcs7(const std::vector<uint8_t>& signed_digest) {
     CBB out, outer_seq, wrapped_seq, seq, digest_algos_set, digest_algo, null;
     CBB content_info, issuer_and_serial, signer_infos, signer_info, sign_algo, signature;
     uint8_t *pkcs7_data, *name_der;
@@ -269,3 +271,37 @@ Result<std::vector<uint8_t>> createPkcs7(const std::vector<uint8_t>& signed_dige
 
     return std::vector<uint8_t>(&pkcs7_data[0], &pkcs7_data[pkcs7_data_len]);
 }
+
+Result<std::vector<uint8_t>> createPkcs7(const std::vector<uint8_t>& signed_digest) {
+    // Everything in the PKCS7 container except the embedded signature is
+    // constant, and for a fixed signature size so are all the DER length
+    // prefixes. The signature is the last element of the DER output, so the
+    // container is a constant prefix followed by the signature bytes: build
+    // it once per signature size, cache the prefix, and assemble subsequent
+    // containers by appending the new signature. addFilesToVerityRecursive
+    // calls this for every artifact, possibly from multiple threads.
+    static std::mutex prefixMutex;
+    static std::map<size_t, std::vector<uint8_t>> prefixBySigSize;
+
+    {
+        std::lock_guard<std::mutex> lock(prefixMutex);
+        auto cached = prefixBySigSize.find(signed_digest.size());
+        if (cached != prefixBySigSize.end()) {
+            std::vector<uint8_t> pkcs7;
+            pkcs7.reserve(cached->second.size() + signed_digest.size());
+            pkcs7.insert(pkcs7.end(), cached->second.begin(), cached->second.end());
+            pkcs7.insert(pkcs7.end(), signed_digest.begin(), signed_digest.end());
+            return pkcs7;
+        }
+    }
+
+    auto pkcs7 = buildPkcs7(signed_digest);
+    if (!pkcs7.ok()) {
+        return pkcs7;
+    }
+
+    std::lock_guard<std::mutex> lock(prefixMutex);
+    prefixBySigSize[signed_digest.size()] =
+        std::vector<uint8_t>(pkcs7->begin(), pkcs7->end() - signed_digest.size());
+    return pkcs7;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+
+// Hex encoding shared by the digest-map construction in odsign_main.cpp and
+// the fs-verity digest formatting in VerityUtils.cpp. Both run inside the
+// per-artifact loop of the boot-critical verification phase, so instead of a
+// stringstream per digest this is a 256-entry table lookup writing straight
+// into a preallocated string: one two-byte store per input byte, a loop the
+// compiler can unroll and vectorize for whichever architecture it targets.
+
+// Appends the lowercase hex encoding of |data| to |*out|, resizing it once.
+inline void appendHex(std::span<const uint8_t> data, std::string* out) {
+    static constexpr const char kDigits[] = "0123456789abcdef";
+    static const std::array<std::array<char, 2>, 256> kTable = [] {
+        std::array<std::array<char, 2>, 256> table{};
+        for (size_t value = 0; value < table.size(); ++value) {
+            table[value] = {kDigits[value >> 4], kDigits[value & 0xf]};
+        }
+        return table;
+    }();
+    const size_t start = out->size();
+    out->resize(start + 2 * data.size());
+    char* dst = out->data() + start;
+    for (size_t i = 0; i < data.size(); ++i) {
+        std::memcpy(dst + 2 * i, kTable[data[i]].data(), 2);
+    }
+}
+
+// Returns the lowercase hex encoding of |data|.
+inline std::string toHex(std::span<const uint8_t> data) {
+    std::string out;
+    appendHex(data, &out);
+    return out;
+}
@@ -18,7 +18,7 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
-#include <binder/IServiceManager.h>
+#include <binderproxy/CppProxyCache.h>
 
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -28,9 +28,6 @@
 #include "KeyConstants.h"
 #include "KeystoreKey.h"
 
-using android::defaultServiceManager;
-using android::IServiceManager;
-using android::sp;
 using android::String16;
 
 using android::hardware::security::keymint::Algorithm;
@@ -145,15 +142,12 @@ Result<std::vector<uint8_t>> KeystoreKey::createKey() {
 }
 
 bool KeystoreKey::initialize() {
-    sp<IServiceManager> sm = defaultServiceManager();
-    if (sm == nullptr) {
-        return false;
-    }
-    auto service = sm->getService(String16("android.system.keystore2.IKeystoreService/default"));
-    if (service == nullptr) {
-        return false;
-    }
-    mService = interface_cast<android::system::keystore2::IKeystoreService>(service);
+    // The shared proxy cache keeps the keystore2 proxy across the repeated
+    // initialize() calls getInstance() makes, and re-resolves it with backoff
+    // if keystore2 restarts.
+    static android::binderproxy::CppProxyCache<android::system::keystore2::IKeystoreService>
+        keystoreCache("android.system.keystore2.IKeystoreService/default");
+    mService = keystoreCache.get();
     if (mService == nullptr) {
         return false;
     }
@@ -321,6 +315,15 @@ Result<std::string> KeystoreKey::sign(const std::string& message) const {
     return std::string{signature.value().begin(), signature.value().end()};
 }
 
+Result<std::string> KeystoreKey::hmacSign(const std::string& message) const {
+    return mHmacKey.sign(message);
+}
+
+Result<void> KeystoreKey::hmacVerify(const std::string& message,
+                                     const std::string& signature) const {
+    return mHmacKey.verify(message, signature);
+}
+
 Result<std::vector<uint8_t>> KeystoreKey::getPublicKey() const {
     return mPublicKey;
 }
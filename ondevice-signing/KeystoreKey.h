@@ -41,6 +41,9 @@ class KeystoreKey : public SigningKey {
 
     virtual android::base::Result<std::string> sign(const std::string& message) const;
     virtual android::base::Result<std::vector<uint8_t>> getPublicKey() const;
+    virtual android::base::Result<std::string> hmacSign(const std::string& message) const;
+    virtual android::base::Result<void> hmacVerify(const std::string& message,
+                                                   const std::string& signature) const;
 
   private:
     KeystoreKey();
@@ -26,4 +26,15 @@ class SigningKey {
     virtual android::base::Result<std::string> sign(const std::string& message) const = 0;
     /* Retrieve the associated public key */
     virtual android::base::Result<std::vector<uint8_t>> getPublicKey() const = 0;
+    /* MAC a message with an associated symmetric key, if the implementation has
+     * one. Unsupported by default; callers are expected to fall back to the
+     * asymmetric signature. */
+    virtual android::base::Result<std::string> hmacSign(const std::string& /*message*/) const {
+        return android::base::Error() << "HMAC is not supported by this key.";
+    }
+    /* Verify a MAC produced by hmacSign */
+    virtual android::base::Result<void> hmacVerify(const std::string& /*message*/,
+                                                   const std::string& /*signature*/) const {
+        return android::base::Error() << "HMAC is not supported by this key.";
+    }
 };
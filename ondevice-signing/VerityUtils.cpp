@@ -14,13 +14,18 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <filesystem>
 #include <map>
 #include <span>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #include <fcntl.h>
 #include <linux/fs.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -31,6 +36,7 @@
 #include <linux/fsverity.h>
 
 #include "CertUtils.h"
+#include "HexUtils.h"
 #include "SigningKey.h"
 
 #define FS_VERITY_MAX_DIGEST_SIZE 64
@@ -57,20 +63,28 @@ struct fsverity_signed_digest {
     __u8 digest[];
 };
 
-static std::string toHex(std::span<uint8_t> data) {
-    std::stringstream ss;
-    for (auto it = data.begin(); it != data.end(); ++it) {
-        ss << std::setfill('0') << std::setw(2) << std::hex << static_cast<unsigned>(*it);
-    }
-    return ss.str();
-}
-
 static int read_callback(void* file, void* buf, size_t count) {
     int* fd = (int*)file;
     if (TEMP_FAILURE_RETRY(read(*fd, buf, count)) < 0) return errno ? -errno : -EIO;
     return 0;
 }
 
+// State for read_mapped_callback: a read-only mapping of the file and the
+// position libfsverity has consumed up to.
+struct MappedRange {
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+};
+
+static int read_mapped_callback(void* file, void* buf, size_t count) {
+    MappedRange* range = (MappedRange*)file;
+    if (count > range->size - range->offset) return -EIO;
+    memcpy(buf, range->data + range->offset, count);
+    range->offset += count;
+    return 0;
+}
+
 Result<std::vector<uint8_t>> createDigest(const std::string& path) {
     struct stat filestat;
     unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
@@ -89,8 +103,26 @@ Result<std::vector<uint8_t>> createDigest(const std::string& path) {
         .block_size = 4096,
     };
 
+    // Map the file instead of read()ing it: libfsverity pulls the contents
+    // in block-sized chunks through the callback, and with a mapping each
+    // pull is a copy from the page cache rather than a syscall, with
+    // madvise() arranging readahead so the hashing doesn't stall on I/O.
+    // Fall back to the read() path if mmap fails.
     struct libfsverity_digest* digest;
-    ret = libfsverity_compute_digest(&fd, &read_callback, &params, &digest);
+    void* addr = MAP_FAILED;
+    if (filestat.st_size > 0) {
+        addr = mmap(nullptr, filestat.st_size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    }
+    if (addr != MAP_FAILED) {
+        madvise(addr, filestat.st_size, MADV_SEQUENTIAL);
+        madvise(addr, filestat.st_size, MADV_WILLNEED);
+        MappedRange range = {static_cast<const uint8_t*>(addr),
+                             static_cast<size_t>(filestat.st_size), 0};
+        ret = libfsverity_compute_digest(&range, &read_mapped_callback, &params, &digest);
+        munmap(addr, filestat.st_size);
+    } else {
+        ret = libfsverity_compute_digest(&fd, &read_callback, &params, &digest);
+    }
     if (ret < 0) {
         return ErrnoError() << "Failed to compute fs-verity digest for " << path;
     }
@@ -172,14 +204,9 @@ Result<std::string> enableFsVerity(const std::string& path, const SigningKey& ke
     return toHex(digest.value());
 }
 
-Result<std::string> isFileInVerity(const std::string& path) {
+static Result<std::string> measureFsVerity(int fd, const std::string& path) {
     unsigned int flags;
 
-    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
-    if (fd < 0) {
-        return ErrnoError() << "Failed to open " << path;
-    }
-
     int ret = ioctl(fd, FS_IOC_GETFLAGS, &flags);
     if (ret < 0) {
         return ErrnoError() << "Failed to FS_IOC_GETFLAGS for " << path;
@@ -197,28 +224,27 @@ Result<std::string> isFileInVerity(const std::string& path) {
     return toHex({&d->digest[0], &d->digest[d->digest_size]});
 }
 
+Result<std::string> isFileInVerity(const std::string& path) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        return ErrnoError() << "Failed to open " << path;
+    }
+
+    return measureFsVerity(fd.get(), path);
+}
+
 Result<std::map<std::string, std::string>> addFilesToVerityRecursive(const std::string& path,
                                                                      const SigningKey& key) {
     std::map<std::string, std::string> digests;
     std::error_code ec;
 
+    std::vector<std::string> paths;
     auto it = std::filesystem::recursive_directory_iterator(path, ec);
     auto end = std::filesystem::recursive_directory_iterator();
 
     while (!ec && it != end) {
         if (it->is_regular_file()) {
-            auto digest = isFileInVerity(it->path());
-            if (!digest.ok()) {
-                LOG(INFO) << "Adding " << it->path() << " to fs-verity...";
-                auto result = enableFsVerity(it->path(), key);
-                if (!result.ok()) {
-                    return result.error();
-                }
-                digests[it->path()] = *result;
-            } else {
-                LOG(INFO) << it->path() << " was already in fs-verity.";
-                digests[it->path()] = *digest;
-            }
+            paths.emplace_back(it->path());
         }
         ++it;
     }
@@ -226,6 +252,46 @@ Result<std::map<std::string, std::string>> addFilesToVerityRecursive(const std::
         return Error() << "Failed to iterate " << path << ": " << ec;
     }
 
+    // The kernel builds the Merkle tree synchronously inside
+    // FS_IOC_ENABLE_VERITY, so enabling one file at a time serializes all of
+    // that hashing (plus our own digest and signing round trips) behind a
+    // single thread. Fan the per-file enablement out over a pool bounded by
+    // core count; workers claim files through a shared index and write into
+    // per-file slots, and the results are merged into the path-keyed map
+    // afterwards. Binder and the TEE handle concurrent sign requests fine.
+    std::vector<Result<std::string>> results(paths.size());
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = nextIndex.fetch_add(1)) < paths.size()) {
+            auto digest = isFileInVerity(paths[i]);
+            if (!digest.ok()) {
+                LOG(INFO) << "Adding " << paths[i] << " to fs-verity...";
+                results[i] = enableFsVerity(paths[i], key);
+            } else {
+                LOG(INFO) << paths[i] << " was already in fs-verity.";
+                results[i] = digest;
+            }
+        }
+    };
+    size_t numThreads =
+        std::min(paths.size(), size_t(std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::thread> threads;
+    for (size_t n = 1; n < numThreads; n++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!results[i].ok()) {
+            return results[i].error();
+        }
+        digests[paths[i]] = *results[i];
+    }
+
     return digests;
 }
 
@@ -233,17 +299,31 @@ Result<std::map<std::string, std::string>> verifyAllFilesInVerity(const std::str
     std::map<std::string, std::string> digests;
     std::error_code ec;
 
+    // Walk once on the calling thread, validating file types up front and
+    // caching one open descriptor per directory. The iterator visits each
+    // directory's files contiguously, so comparing against the previous
+    // parent is enough to reuse the descriptor; the workers below then
+    // openat() by name instead of re-resolving every full path.
+    std::vector<unique_fd> dirFds;
+    std::vector<std::tuple<size_t, std::string, std::string>> files;
+    std::string currentDir;
+
     auto it = std::filesystem::recursive_directory_iterator(path, ec);
     auto end = std::filesystem::recursive_directory_iterator();
 
     while (!ec && it != end) {
         if (it->is_regular_file()) {
-            // Verify the file is in fs-verity
-            auto result = isFileInVerity(it->path());
-            if (!result.ok()) {
-                return result.error();
+            std::string parent = it->path().parent_path();
+            if (dirFds.empty() || parent != currentDir) {
+                unique_fd dirFd(TEMP_FAILURE_RETRY(
+                    open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+                if (dirFd < 0) {
+                    return ErrnoError() << "Failed to open " << parent;
+                }
+                dirFds.push_back(std::move(dirFd));
+                currentDir = parent;
             }
-            digests[it->path()] = *result;
+            files.emplace_back(dirFds.size() - 1, it->path().filename(), it->path());
         } else if (it->is_directory()) {
             // These are fine to ignore
         } else if (it->is_symlink()) {
@@ -257,6 +337,42 @@ Result<std::map<std::string, std::string>> verifyAllFilesInVerity(const std::str
         return Error() << "Failed to iterate " << path << ": " << ec;
     }
 
+    // This runs on every boot for the whole artifact set; spread the
+    // FS_IOC_MEASURE_VERITY ioctls over a pool bounded by core count, the
+    // same shared-index scheme as addFilesToVerityRecursive.
+    std::vector<Result<std::string>> results(files.size());
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = nextIndex.fetch_add(1)) < files.size()) {
+            const auto& [dirIndex, name, filePath] = files[i];
+            unique_fd fd(
+                TEMP_FAILURE_RETRY(openat(dirFds[dirIndex].get(), name.c_str(), O_RDONLY | O_CLOEXEC)));
+            if (fd < 0) {
+                results[i] = ErrnoError() << "Failed to open " << filePath;
+                continue;
+            }
+            results[i] = measureFsVerity(fd.get(), filePath);
+        }
+    };
+    size_t numThreads =
+        std::min(files.size(), size_t(std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::thread> threads;
+    for (size_t n = 1; n < numThreads; n++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!results[i].ok()) {
+            return results[i].error();
+        }
+        digests[std::get<2>(files[i])] = *results[i];
+    }
+
     return digests;
 }
 
@@ -14,15 +14,18 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fcntl.h>
 #include <filesystem>
-#include <fstream>
-#include <iomanip>
+#include <future>
 #include <iostream>
-#include <iterator>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -32,6 +35,7 @@
 #include <odrefresh/odrefresh.h>
 
 #include "CertUtils.h"
+#include "HexUtils.h"
 #include "KeystoreKey.h"
 #include "VerityUtils.h"
 
@@ -48,6 +52,7 @@ const std::string kSigningKeyBlob = "/data/misc/odsign/key.blob";
 const std::string kSigningKeyCert = "/data/misc/odsign/key.cert";
 const std::string kOdsignInfo = "/data/misc/odsign/odsign.info";
 const std::string kOdsignInfoSignature = "/data/misc/odsign/odsign.info.signature";
+const std::string kOdsignInfoHmac = "/data/misc/odsign/odsign.info.hmac";
 
 const std::string kArtArtifactsDir = "/data/misc/apexdata/com.android.art/dalvik-cache";
 
@@ -66,6 +71,30 @@ static const char* kOdsignVerificationStatusError = "0";
 
 static const char* kStopServiceProp = "ctl.stop";
 
+static const char* kOdsignMetricsPropPrefix = "odsign.metrics.";
+
+// Records wall-clock durations of odsign's boot phases and exports them as
+// odsign.metrics.<phase> properties (in milliseconds), where boot analysis
+// tooling that snapshots system properties can pick them up. Capturing a
+// phase costs two steady_clock reads, so this is safe to leave enabled.
+class PhaseTimer {
+  public:
+    void record(const char* phase, std::chrono::steady_clock::duration duration) {
+        durations_.emplace_back(
+            phase, std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+    }
+
+    void publish() const {
+        for (const auto& [phase, millis] : durations_) {
+            LOG(INFO) << "odsign phase " << phase << " took " << millis << " ms";
+            SetProperty(kOdsignMetricsPropPrefix + phase, std::to_string(millis));
+        }
+    }
+
+  private:
+    std::vector<std::pair<std::string, int64_t>> durations_;
+};
+
 static int removeDirectory(const std::string& directory) {
     std::error_code ec;
     auto num_removed = std::filesystem::remove_all(directory, ec);
@@ -128,28 +157,55 @@ art::odrefresh::ExitCode compileArtifacts(bool force) {
     return static_cast<art::odrefresh::ExitCode>(exit_code);
 }
 
-static std::string toHex(const std::vector<uint8_t>& digest) {
-    std::stringstream ss;
-    for (auto it = digest.begin(); it != digest.end(); ++it) {
-        ss << std::setfill('0') << std::setw(2) << std::hex << static_cast<unsigned>(*it);
+// Maps an artifact path to its stat identity and digest, for files whose
+// digest was already computed and verified earlier in this run. The cache is
+// deliberately not persisted: trusting a stat identity across boots would let
+// an offline in-place modification (which can preserve size, mtime and inode)
+// skip the very hashing odsign exists to do. Within a single run there is no
+// such window.
+using DigestCache = std::map<std::string, std::pair<std::string, std::string>>;
+
+// Returns the stat identity of |path|: size, mtime (at nanosecond
+// granularity) and inode. A file whose identity is unchanged since it was
+// hashed earlier in this run has not been touched by odrefresh.
+static Result<std::string> statIdentity(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return ErrnoError() << "Failed to stat " << path;
     }
-    return ss.str();
+    return std::to_string(st.st_size) + ":" + std::to_string(st.st_mtim.tv_sec) + ":" +
+           std::to_string(st.st_mtim.tv_nsec) + ":" + std::to_string(st.st_ino);
 }
 
-Result<std::map<std::string, std::string>> computeDigests(const std::string& path) {
+Result<std::map<std::string, std::string>> computeDigests(const std::string& path,
+                                                          const DigestCache* cache = nullptr) {
     std::error_code ec;
     std::map<std::string, std::string> digests;
 
+    // Collect the regular files first so the hashing can be fanned out over
+    // a pool of threads; the ART artifacts total hundreds of MB and hashing
+    // them serially is one of the longest phases of a post-update boot.
+    // Files whose stat identity matches a digest verified earlier in this
+    // run (e.g. artifacts a partial odrefresh left untouched) are reused
+    // from the cache instead of being hashed again.
+    std::vector<std::string> paths;
     auto it = std::filesystem::recursive_directory_iterator(path, ec);
     auto end = std::filesystem::recursive_directory_iterator();
 
     while (!ec && it != end) {
         if (it->is_regular_file()) {
-            auto digest = createDigest(it->path());
-            if (!digest.ok()) {
-                return Error() << "Failed to compute digest for " << it->path();
+            if (cache != nullptr) {
+                auto cached = cache->find(it->path());
+                if (cached != cache->end()) {
+                    auto identity = statIdentity(it->path());
+                    if (identity.ok() && *identity == cached->second.first) {
+                        digests[it->path()] = cached->second.second;
+                        ++it;
+                        continue;
+                    }
+                }
             }
-            digests[it->path()] = toHex(*digest);
+            paths.emplace_back(it->path());
         }
         ++it;
     }
@@ -157,30 +213,69 @@ Result<std::map<std::string, std::string>> computeDigests(const std::string& pat
         return Error() << "Failed to iterate " << path << ": " << ec;
     }
 
+    // Workers claim the next unhashed file via a shared index and write their
+    // result into a slot reserved per file, so no locking is needed and an
+    // uneven mix of small and large files still balances across threads.
+    std::vector<Result<std::vector<uint8_t>>> results(paths.size());
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = nextIndex.fetch_add(1)) < paths.size()) {
+            results[i] = createDigest(paths[i]);
+        }
+    };
+    size_t numThreads =
+        std::min(paths.size(), size_t(std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::thread> threads;
+    for (size_t n = 1; n < numThreads; n++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // The map is keyed by path, so the ordering persistDigests relies on is
+    // independent of which thread hashed which file.
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!results[i].ok()) {
+            return Error() << "Failed to compute digest for " << paths[i];
+        }
+        digests[paths[i]] = toHex(*results[i]);
+    }
+
     return digests;
 }
 
-Result<void> verifyDigests(const std::map<std::string, std::string>& digests,
-                           const std::map<std::string, std::string>& trusted_digests) {
+// Checks |digests| against |trusted_digests| and returns the paths that are
+// stale: files with no trusted digest at all, or whose digest doesn't match.
+// An empty result means every file verified. Mismatches are deliberately not
+// hard errors so the caller can invalidate just the stale subset instead of
+// the whole artifact directory.
+Result<std::vector<std::string>> verifyDigests(
+    const std::map<std::string, std::string>& digests,
+    const std::map<std::string, std::string>& trusted_digests) {
+    std::vector<std::string> staleArtifacts;
     for (const auto& path_digest : digests) {
         auto path = path_digest.first;
         auto digest = path_digest.second;
         if (trusted_digests.count(path) == 0) {
-            return Error() << "Couldn't find digest for " << path;
-        }
-        if (trusted_digests.at(path) != digest) {
-            return Error() << "Digest mismatch for " << path;
+            LOG(WARNING) << "Couldn't find digest for " << path;
+            staleArtifacts.push_back(path);
+        } else if (trusted_digests.at(path) != digest) {
+            LOG(WARNING) << "Digest mismatch for " << path;
+            staleArtifacts.push_back(path);
         }
     }
 
-    // All digests matched!
-    if (digests.size() > 0) {
+    if (digests.size() > 0 && staleArtifacts.empty()) {
         LOG(INFO) << "All root hashes match.";
     }
-    return {};
+    return staleArtifacts;
 }
 
-Result<void> verifyIntegrityFsVerity(const std::map<std::string, std::string>& trusted_digests) {
+Result<std::vector<std::string>>
+verifyIntegrityFsVerity(const std::map<std::string, std::string>& trusted_digests) {
     // Just verify that the files are in verity, and get their digests
     auto result = verifyAllFilesInVerity(kArtArtifactsDir);
     if (!result.ok()) {
@@ -190,43 +285,84 @@ Result<void> verifyIntegrityFsVerity(const std::map<std::string, std::string>& t
     return verifyDigests(*result, trusted_digests);
 }
 
-Result<void> verifyIntegrityNoFsVerity(const std::map<std::string, std::string>& trusted_digests) {
+Result<std::vector<std::string>>
+verifyIntegrityNoFsVerity(const std::map<std::string, std::string>& trusted_digests,
+                          DigestCache* verifiedCache) {
     // On these devices, just compute the digests, and verify they match the ones we trust
     auto result = computeDigests(kArtArtifactsDir);
     if (!result.ok()) {
         return result.error();
     }
 
-    return verifyDigests(*result, trusted_digests);
+    auto verifyResult = verifyDigests(*result, trusted_digests);
+    if (!verifyResult.ok()) {
+        return verifyResult;
+    }
+
+    // Remember the just-verified digests along with each file's stat
+    // identity, so a later computeDigests in this run (after a partial
+    // recompile) only re-hashes the files odrefresh actually touched. The
+    // stale files are about to be removed, so only matches go in.
+    if (verifiedCache != nullptr) {
+        for (const auto& [path, digest] : *result) {
+            if (std::find(verifyResult->begin(), verifyResult->end(), path) !=
+                verifyResult->end()) {
+                continue;
+            }
+            auto identity = statIdentity(path);
+            if (identity.ok()) {
+                (*verifiedCache)[path] = {*identity, digest};
+            }
+        }
+    }
+    return verifyResult;
 }
 
 Result<OdsignInfo> getAndVerifyOdsignInfo(const SigningKey& key) {
-    std::string persistedSignature;
     OdsignInfo odsignInfo;
 
-    if (!android::base::ReadFileToString(kOdsignInfoSignature, &persistedSignature)) {
-        return ErrnoError() << "Failed to read " << kOdsignInfoSignature;
+    // Read the file once; the same bytes are both verified and parsed.
+    std::string odsign_info_str;
+    if (!android::base::ReadFileToString(kOdsignInfo, &odsign_info_str)) {
+        return ErrnoError() << "Failed to read " << kOdsignInfo;
     }
 
-    std::fstream odsign_info(kOdsignInfo, std::ios::in | std::ios::binary);
-    if (!odsign_info) {
-        return Error() << "Failed to open " << kOdsignInfo;
+    // Fast path: verify the HMAC tag persistDigests writes next to the
+    // signature. The HMAC key sits in the TEE at the same boot level as the
+    // signing key - it is what vouches for the signing public key in the
+    // first place - so a matching tag anchors trust directly in the TEE with
+    // a single symmetric keystore operation, skipping the public key chain.
+    bool verified = false;
+    std::string persistedHmac;
+    if (android::base::ReadFileToString(kOdsignInfoHmac, &persistedHmac)) {
+        auto hmacResult = key.hmacVerify(odsign_info_str, persistedHmac);
+        if (hmacResult.ok()) {
+            LOG(INFO) << kOdsignInfoHmac << " matches.";
+            verified = true;
+        } else {
+            LOG(WARNING) << kOdsignInfoHmac << " did not verify, falling back to signature: "
+                         << hmacResult.error().message();
+        }
     }
-    odsign_info.seekg(0);
-    // Verify the hash
-    std::string odsign_info_str((std::istreambuf_iterator<char>(odsign_info)),
-                                std::istreambuf_iterator<char>());
 
-    auto publicKey = key.getPublicKey();
-    auto signResult = verifySignature(odsign_info_str, persistedSignature, *publicKey);
-    if (!signResult.ok()) {
-        return Error() << kOdsignInfoSignature << " does not match.";
-    } else {
-        LOG(INFO) << kOdsignInfoSignature << " matches.";
+    if (!verified) {
+        // The RSA signature remains authoritative; files written before the
+        // HMAC tag existed (or whose tag write was interrupted) only have it.
+        std::string persistedSignature;
+        if (!android::base::ReadFileToString(kOdsignInfoSignature, &persistedSignature)) {
+            return ErrnoError() << "Failed to read " << kOdsignInfoSignature;
+        }
+
+        auto publicKey = key.getPublicKey();
+        auto signResult = verifySignature(odsign_info_str, persistedSignature, *publicKey);
+        if (!signResult.ok()) {
+            return Error() << kOdsignInfoSignature << " does not match.";
+        } else {
+            LOG(INFO) << kOdsignInfoSignature << " matches.";
+        }
     }
 
-    odsign_info.seekg(0);
-    if (!odsignInfo.ParseFromIstream(&odsign_info)) {
+    if (!odsignInfo.ParseFromString(odsign_info_str)) {
         return Error() << "Failed to parse " << kOdsignInfo;
     }
 
@@ -259,25 +395,40 @@ std::map<std::string, std::string> getTrustedDigests(const SigningKey& key) {
 Result<void> persistDigests(const std::map<std::string, std::string>& digests,
                             const SigningKey& key) {
     OdsignInfo signInfo;
-    google::protobuf::Map<std::string, std::string> proto_hashes(digests.begin(), digests.end());
+    // Fill the proto map in place instead of building a temporary
+    // google::protobuf::Map and copying every entry over.
     auto map = signInfo.mutable_file_hashes();
-    *map = proto_hashes;
+    for (const auto& [path, digest] : digests) {
+        (*map)[path] = digest;
+    }
 
-    std::fstream odsign_info(kOdsignInfo,
-                             std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
-    if (!signInfo.SerializeToOstream(&odsign_info)) {
-        return Error() << "Failed to persist root hashes in " << kOdsignInfo;
+    // Serialize once and reuse the same bytes for the file, the signature
+    // and the HMAC tag, rather than writing via a stream and reading the
+    // file back to find out what was signed.
+    std::string odsign_info_str;
+    if (!signInfo.SerializeToString(&odsign_info_str)) {
+        return Error() << "Failed to serialize " << kOdsignInfo;
+    }
+    if (!android::base::WriteStringToFile(odsign_info_str, kOdsignInfo)) {
+        return ErrnoError() << "Failed to persist root hashes in " << kOdsignInfo;
     }
 
     // Sign the signatures with our key itself, and write that to storage
-    odsign_info.seekg(0, std::ios::beg);
-    std::string odsign_info_str((std::istreambuf_iterator<char>(odsign_info)),
-                                std::istreambuf_iterator<char>());
     auto signResult = key.sign(odsign_info_str);
     if (!signResult.ok()) {
         return Error() << "Failed to sign " << kOdsignInfo;
     }
     android::base::WriteStringToFile(*signResult, kOdsignInfoSignature);
+
+    // Also tag the file with the TEE-backed HMAC key, so the next boot can
+    // take the symmetric verification fast path. Not being able to write the
+    // tag is not fatal; verification just falls back to the signature.
+    auto hmacResult = key.hmacSign(odsign_info_str);
+    if (hmacResult.ok()) {
+        android::base::WriteStringToFile(*hmacResult, kOdsignInfoHmac);
+    } else {
+        LOG(WARNING) << "Failed to HMAC " << kOdsignInfo << ": " << hmacResult.error().message();
+    }
     return {};
 }
 
@@ -295,24 +446,33 @@ static int removeArtifacts() {
     }
 }
 
-static Result<void> verifyArtifacts(const std::map<std::string, std::string>& trusted_digests,
-                                    bool supportsFsVerity) {
-    Result<void> integrityStatus;
+// Verifies the artifacts and returns the subset of paths that failed
+// verification (empty if everything matched). A hard error - e.g. the
+// directory can't be walked, or a file isn't in fs-verity at all - still
+// fails the whole set.
+static Result<std::vector<std::string>>
+verifyArtifacts(const std::map<std::string, std::string>& trusted_digests, bool supportsFsVerity,
+                DigestCache* verifiedCache) {
+    Result<std::vector<std::string>> integrityStatus;
 
     if (supportsFsVerity) {
         integrityStatus = verifyIntegrityFsVerity(trusted_digests);
     } else {
-        integrityStatus = verifyIntegrityNoFsVerity(trusted_digests);
+        integrityStatus = verifyIntegrityNoFsVerity(trusted_digests, verifiedCache);
     }
     if (!integrityStatus.ok()) {
         return Error() << integrityStatus.error().message();
     }
 
-    return {};
+    return integrityStatus;
 }
 
 int main(int /* argc */, char** /* argv */) {
-    auto errorScopeGuard = []() {
+    PhaseTimer timer;
+    auto errorScopeGuard = [&timer]() {
+        // Publish whatever phases completed; partial timings are still useful
+        // when investigating a failed boot.
+        timer.publish();
         // In case we hit any error, remove the artifacts and tell Zygote not to use anything
         removeArtifacts();
         // Tell init we don't need to use our key anymore
@@ -330,18 +490,40 @@ int main(int /* argc */, char** /* argv */) {
         return 0;
     }
 
-    auto keystoreResult = KeystoreKey::getInstance();
-    if (!keystoreResult.ok()) {
-        LOG(ERROR) << "Could not create keystore key: " << keystoreResult.error().message();
-        return -1;
-    }
-    SigningKey* key = keystoreResult.value();
+    // Initializing the keystore key means waiting for keystore2 and doing
+    // several round trips into the TEE, none of which is needed to ask
+    // odrefresh whether the artifacts are up to date. Start the key
+    // initialization in the background, run odrefresh --check concurrently,
+    // and join right before the first use of the key.
+    std::chrono::steady_clock::duration keyInitDuration{};
+    auto keystoreFuture = std::async(std::launch::async, [&keyInitDuration]() {
+        auto start = std::chrono::steady_clock::now();
+        auto result = KeystoreKey::getInstance();
+        keyInitDuration = std::chrono::steady_clock::now() - start;
+        return result;
+    });
 
     bool supportsFsVerity = access(kFsVerityProcPath, F_OK) == 0;
     if (!supportsFsVerity) {
         LOG(INFO) << "Device doesn't support fsverity. Falling back to full verification.";
     }
 
+    auto odrefreshCheckStart = std::chrono::steady_clock::now();
+    art::odrefresh::ExitCode odrefresh_status = checkArtifacts();
+    timer.record("odrefresh_check", std::chrono::steady_clock::now() - odrefreshCheckStart);
+
+    // key_wait is the time actually spent blocked here, i.e. the part of the
+    // key initialization the odrefresh check didn't hide.
+    auto keyWaitStart = std::chrono::steady_clock::now();
+    auto keystoreResult = keystoreFuture.get();
+    timer.record("key_init", keyInitDuration);
+    timer.record("key_wait", std::chrono::steady_clock::now() - keyWaitStart);
+    if (!keystoreResult.ok()) {
+        LOG(ERROR) << "Could not create keystore key: " << keystoreResult.error().message();
+        return -1;
+    }
+    SigningKey* key = keystoreResult.value();
+
     if (supportsFsVerity) {
         auto existing_cert = verifyExistingCert(*key);
         if (!existing_cert.ok()) {
@@ -365,7 +547,9 @@ int main(int /* argc */, char** /* argv */) {
         }
     }
 
-    art::odrefresh::ExitCode odrefresh_status = checkArtifacts();
+    // Digests verified earlier in this run, keyed by stat identity; lets the
+    // post-compile digest pass skip files a partial odrefresh didn't touch.
+    DigestCache verifiedDigestCache;
 
     // The artifacts dir doesn't necessarily need to exist; if the existing
     // artifacts on the system partition are valid, those can be used.
@@ -395,8 +579,40 @@ int main(int /* argc */, char** /* argv */) {
             SetProperty(kOdsignKeyDoneProp, "1");
         }
 
-        auto verificationResult = verifyArtifacts(trusted_digests, supportsFsVerity);
+        auto verifyStart = std::chrono::steady_clock::now();
+        auto verificationResult =
+            verifyArtifacts(trusted_digests, supportsFsVerity, &verifiedDigestCache);
+        timer.record("artifact_verification", std::chrono::steady_clock::now() - verifyStart);
+        bool removeEverything = false;
         if (!verificationResult.ok()) {
+            removeEverything = true;
+        } else if (!verificationResult->empty()) {
+            // Only some artifacts are stale. Remove just those and let
+            // odrefresh regenerate them with a partial compile, instead of
+            // wiping the directory and paying a full compile + re-sign
+            // cycle. Each retained file verified individually against the
+            // signed digest map, so keeping them is sound.
+            LOG(INFO) << "Removing " << verificationResult->size() << " stale artifacts.";
+            for (const std::string& stalePath : *verificationResult) {
+                std::error_code ec;
+                std::filesystem::remove(stalePath, ec);
+                if (ec) {
+                    LOG(ERROR) << "Failed to remove stale artifact " << stalePath << ": "
+                               << ec.message();
+                    removeEverything = true;
+                }
+            }
+            if (!removeEverything && odrefresh_status == art::odrefresh::ExitCode::kOkay) {
+                // The key may already have been released above, so the
+                // removed artifacts can't be regenerated this boot; the
+                // retained verified ones are still usable, and odrefresh
+                // will notice the missing files and recompile them on the
+                // next boot.
+                LOG(INFO) << "Retaining verified artifacts; stale ones regenerate next boot.";
+            }
+        }
+        if (removeEverything) {
+            verifiedDigestCache.clear();
             int num_removed = removeDirectory(kArtArtifactsDir);
             if (num_removed == 0) {
                 // If we can't remove the bad artifacts, we shouldn't continue, and
@@ -410,7 +626,9 @@ int main(int /* argc */, char** /* argv */) {
 
     // Now that we verified existing artifacts, compile if we need to.
     if (odrefresh_status == art::odrefresh::ExitCode::kCompilationRequired) {
+        auto compileStart = std::chrono::steady_clock::now();
         odrefresh_status = compileArtifacts(kForceCompilation);
+        timer.record("odrefresh_compile", std::chrono::steady_clock::now() - compileStart);
     }
 
     if (odrefresh_status == art::odrefresh::ExitCode::kOkay) {
@@ -422,18 +640,24 @@ int main(int /* argc */, char** /* argv */) {
         LOG(INFO) << "odrefresh compiled " << (compiled_all ? "all" : "partial")
                   << " artifacts, returned " << odrefresh_status;
         Result<std::map<std::string, std::string>> digests;
+        auto signStart = std::chrono::steady_clock::now();
         if (supportsFsVerity) {
             digests = addFilesToVerityRecursive(kArtArtifactsDir, *key);
         } else {
             // If we can't use verity, just compute the root hashes and store
-            // those, so we can reverify them at the next boot.
-            digests = computeDigests(kArtArtifactsDir);
+            // those, so we can reverify them at the next boot. Digests
+            // verified at the start of this run are reused for files a
+            // partial compile left untouched.
+            digests = computeDigests(kArtArtifactsDir, &verifiedDigestCache);
         }
+        timer.record("artifact_signing", std::chrono::steady_clock::now() - signStart);
         if (!digests.ok()) {
             LOG(ERROR) << digests.error().message();
             return -1;
         }
+        auto persistStart = std::chrono::steady_clock::now();
         auto persistStatus = persistDigests(*digests, *key);
+        timer.record("persist_info", std::chrono::steady_clock::now() - persistStart);
         if (!persistStatus.ok()) {
             LOG(ERROR) << persistStatus.error().message();
             return -1;
@@ -447,6 +671,7 @@ int main(int /* argc */, char** /* argv */) {
     }
 
     LOG(INFO) << "On-device signing done.";
+    timer.publish();
 
     scope_guard.Disable();
     // At this point, we're done with the key for sure
@@ -14,7 +14,11 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <aidl/android/hardware/security/keymint/IRemotelyProvisionedComponent.h>
@@ -121,11 +125,29 @@ void writeOutput(const Array& csr) {
         std::cerr << "  " << kBuildPlusCsr << std::endl;
         exit(1);
     }
+    // Records are emitted as they complete; flush so the host consuming the
+    // stream sees each one immediately.
+    std::cout.flush();
 }
 
-// Callback for AServiceManager_forEachDeclaredInstance that writes out a CSR
-// for every IRemotelyProvisionedComponent.
-void getCsrForInstance(const char* name, void* /*context*/) {
+// Outcome of CSR generation for one IRemotelyProvisionedComponent instance.
+// |error| is set if anything went wrong; |fatal| mirrors the previous
+// behavior of exiting for HAL failures but only skipping unfetchable
+// binders.
+struct CsrResult {
+    bool fatal = false;
+    std::string error;
+    std::optional<Array> csr;
+};
+
+// Callback for AServiceManager_forEachDeclaredInstance that collects the
+// declared instance names.
+void collectInstanceName(const char* name, void* context) {
+    static_cast<std::vector<std::string>*>(context)->push_back(name);
+}
+
+CsrResult getCsrForInstance(const std::string& name) {
+    CsrResult result;
     const std::vector<uint8_t> challenge = generateChallenge();
 
     auto fullName = std::string(IRemotelyProvisionedComponent::descriptor) + "/" + name;
@@ -133,8 +155,8 @@ void getCsrForInstance(const char* name, void* /*context*/) {
     ::ndk::SpAIBinder rkp_binder(rkpAiBinder);
     auto rkp_service = IRemotelyProvisionedComponent::fromBinder(rkp_binder);
     if (!rkp_service) {
-        std::cerr << "Unable to get binder object for '" << fullName << "', skipping.";
-        return;
+        result.error = "Unable to get binder object for '" + fullName + "', skipping.";
+        return result;
     }
 
     std::vector<uint8_t> keysToSignMac;
@@ -145,13 +167,14 @@ void getCsrForInstance(const char* name, void* /*context*/) {
         FLAGS_test_mode, emptyKeys, getEekChain(), challenge, &verifiedDeviceInfo, &protectedData,
         &keysToSignMac);
     if (!status.isOk()) {
-        std::cerr << "Bundle extraction failed for '" << fullName
-                  << "'. Error code: " << status.getServiceSpecificError() << "." << std::endl;
-        exit(-1);
+        result.fatal = true;
+        result.error = "Bundle extraction failed for '" + fullName + "'. Error code: " +
+                       std::to_string(status.getServiceSpecificError()) + ".";
+        return result;
     }
-    auto request =
+    result.csr =
         composeCertificateRequest(protectedData, verifiedDeviceInfo, challenge, keysToSignMac);
-    writeOutput(request);
+    return result;
 }
 
 }  // namespace
@@ -159,8 +182,49 @@ void getCsrForInstance(const char* name, void* /*context*/) {
 int main(int argc, char** argv) {
     gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
 
-    AServiceManager_forEachDeclaredInstance(IRemotelyProvisionedComponent::descriptor,
-                                            /*context=*/nullptr, getCsrForInstance);
+    std::vector<std::string> instances;
+    AServiceManager_forEachDeclaredInstance(IRemotelyProvisionedComponent::descriptor, &instances,
+                                            collectInstanceName);
+
+    // Each instance (e.g. default and strongbox) does its CSR work in its own
+    // secure environment, so run them concurrently. This roughly halves
+    // factory-station wall time on devices with two instances.
+    //
+    // Each record is emitted as soon as its instance finishes rather than
+    // buffered until the whole batch is done: the factory host starts
+    // consuming immediately, and peak memory stays bounded by the CSRs in
+    // flight instead of the batch size. The mutex keeps records whole; with
+    // concurrent generation, record order follows completion order.
+    std::atomic<size_t> nextIndex(0);
+    std::atomic<bool> fatal(false);
+    std::mutex outputMutex;
+    auto worker = [&]() {
+        size_t i;
+        while ((i = nextIndex.fetch_add(1)) < instances.size()) {
+            CsrResult result = getCsrForInstance(instances[i]);
+            std::lock_guard<std::mutex> lock(outputMutex);
+            if (!result.error.empty()) {
+                std::cerr << result.error << std::endl;
+                if (result.fatal) {
+                    fatal = true;
+                }
+                continue;
+            }
+            writeOutput(*result.csr);
+        }
+    };
+    size_t numThreads =
+        std::min(instances.size(), size_t(std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::thread> threads;
+    for (size_t n = 1; n < numThreads; n++) {
+        threads.emplace_back(worker);
+    }
+    if (numThreads > 0) {
+        worker();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
 
-    return 0;
+    return fatal ? -1 : 0;
 }